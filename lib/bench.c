@@ -0,0 +1,1757 @@
+/*
+ * bench.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include "dma.h"
+#include "color.h"
+#include "composite.h"
+#include "effects.h"
+#include "encode.h"
+#include "keyframe.h"
+#include "noise.h"
+#include "canvas.h"
+#include "script.h"
+#include "downscale.h"
+#include "slew.h"
+#include "dither.h"
+#include "tasks.h"
+#include "particle.h"
+#include "framerate.h"
+#include "lut3d.h"
+#include "ws2811-pcm.h"
+
+
+/*
+ * Scenario benchmark for the library, running against the emulated output
+ * sink so it needs neither root nor a Raspberry Pi.
+ *
+ *   bench [-o results.json] [-n 64,256,...] [-s full,sparse,...] [-f frames] [-r runs] [-w]
+ *   bench -c base.json new.json [-t percent]
+ *   bench -F
+ *   bench -E [-n 64,256,...] [-f frames]
+ *
+ * The first form runs every scenario for every LED count and writes the
+ * results as JSON.  The second compares two result files and exits with 1 if
+ * a significant regression is found, so library upgrades can be gated on it.
+ * The third injects DMA, PCM, clock and allocation faults into the emulated
+ * hardware and exits with 1 if throughput or recovery time is out of bounds,
+ * or if the stages tiled over a task pool don't match their serial output.
+ * The fourth times the effects library, the compositor, the color conversions,
+ * color correction, keyframe crossfades, noise generators, canvas blits,
+ * effect scripts, image downscaling, slew limiting and dithering per LED,
+ * the effect, compositor, color and script stages on all cores,
+ * particles per particle, and frame rate conversion per LED.
+ */
+
+
+#define ARRAY_SIZE(stuff)                        (sizeof(stuff) / sizeof(stuff[0]))
+
+#define TARGET_FREQ                              WS2811_TARGET_FREQ
+#define WARMUP_FRAMES                            16
+#define MAX_COUNTS                               16
+#define MAX_RESULTS                              256
+
+#define FAULT_LEDS                               256
+#define FAULT_FRAMES                             200
+#define FAULT_FRAME                              50     // Frame the faults hit
+
+#define EFFECT_DT_US                             16667  // 60 frames per second
+
+#define TASKS_CHECK_LEDS                         50021  // Tiles of all sizes, one odd
+#define TASKS_CHECK_THREADS                      4
+#define TASKS_CHECK_FRAMES                       8
+
+
+typedef struct
+{
+    const char *name;
+    void (*frame)(ws2811_led_t *leds, int count, int frame);
+} scenario_t;
+
+typedef struct
+{
+    char scenario[32];
+    int leds;
+    int frames;
+    int runs;
+    double fps_mean;                             // Render calls per second, CPU bound
+    double fps_stddev;
+    double render_p50_us;
+    double render_p99_us;
+    double encode_ns_per_led;
+    double cycles_per_led;                       // 0 if the PMU isn't available
+    double wire_fps;                             // Frame rate the wire allows
+    double latency_p99_us;                       // Render call to last bit out, -w only
+} result_t;
+
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+    rnd_state = rnd_state * 1664525 + 1013904223;
+
+    return rnd_state;
+}
+
+// Every LED changes every frame
+static void frame_full(ws2811_led_t *leds, int count, int frame)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        leds[i] = rnd() & 0xffffff;
+    }
+}
+
+// About one in 64 LEDs changes every frame
+static void frame_sparse(ws2811_led_t *leds, int count, int frame)
+{
+    int i;
+
+    for (i = 0; i < (count + 63) / 64; i++)
+    {
+        leds[rnd() % count] = rnd() & 0xffffff;
+    }
+}
+
+// Nothing changes after the first frame
+static void frame_static(ws2811_led_t *leds, int count, int frame)
+{
+    if (!frame)
+    {
+        frame_full(leds, count, frame);
+    }
+}
+
+// Square matrix with serpentine wiring, scrolling up one row per frame
+static void frame_matrix(ws2811_led_t *leds, int count, int frame)
+{
+    int width = sqrt(count), height = count / width;
+    int x, y;
+
+    for (y = 0; y < height; y++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            int led = (y * width) + ((y & 1) ? (width - 1 - x) : x);
+            int hue = ((x + y + frame) * 8) & 0xff;
+
+            leds[led] = (hue << 16) | ((255 - hue) << 8) | ((hue * 3) & 0xff);
+        }
+    }
+}
+
+// Static first half, sparse third quarter, full last quarter
+static void frame_mixed(ws2811_led_t *leds, int count, int frame)
+{
+    int half = count / 2, quarter = count / 4;
+
+    frame_static(leds, half, frame);
+    frame_sparse(&leds[half], quarter, frame);
+    frame_full(&leds[half + quarter], count - half - quarter, frame);
+}
+
+static const scenario_t scenarios[] =
+{
+    { "full",   frame_full },
+    { "sparse", frame_sparse },
+    { "static", frame_static },
+    { "matrix", frame_matrix },
+    { "mixed",  frame_mixed },
+};
+
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Run one scenario for one LED count.
+ *
+ * @param    scenario   Scenario to run.
+ * @param    count      Number of LEDs.
+ * @param    frames     Frames per run.
+ * @param    runs       Number of runs, each on a fresh instance.
+ * @param    wire_time  Let the emulated DMA take the real wire time.
+ * @param    result     Filled in with the results.
+ *
+ * @returns  0 on success, -1 otherwise.
+ */
+static int run_scenario(const scenario_t *scenario, int count, int frames, int runs,
+                        int wire_time, result_t *result)
+{
+    uint64_t *render_ns = malloc(sizeof(*render_ns) * frames * runs);
+    double fps_sum = 0.0, fps_sq = 0.0;
+    uint64_t encode_ns = 0, encode_cycles = 0, latency_p99 = 0;
+    int pmu = 0, run, frame;
+
+    if (!render_ns)
+    {
+        return -1;
+    }
+
+    memset(result, 0, sizeof(*result));
+    snprintf(result->scenario, sizeof(result->scenario), "%s", scenario->name);
+    result->leds = count;
+    result->frames = frames;
+    result->runs = runs;
+
+    for (run = 0; run < runs; run++)
+    {
+        ws2811_channel_t channel =
+        {
+            .count = count,
+            .brightness = 255,
+            .strip_type = WS2811_STRIP_GRB,
+        };
+        ws2811_t ws2811 =
+        {
+            .freq = TARGET_FREQ,
+            .channel = &channel,
+            .flags = WS2811_FLAG_EMULATE | WS2811_FLAG_PMU | WS2811_FLAG_LATENCY |
+                     (wire_time ? WS2811_FLAG_WIRE_TIME : 0),
+        };
+        ws2811_stats_t stats;
+        uint64_t *ns = &render_ns[run * frames];
+        uint64_t total = 0;
+        int len;
+
+        if (ws2811_init(&ws2811))
+        {
+            free(render_ns);
+            return -1;
+        }
+
+        rnd_state = 1;
+        for (frame = 0; frame < WARMUP_FRAMES; frame++)
+        {
+            scenario->frame(channel.leds, count, frame);
+            ws2811_render(&ws2811);
+        }
+        ws2811_stats(&ws2811, &stats);
+        encode_ns -= stats.total[WS2811_STAGE_ENCODE].ns;
+        encode_cycles -= stats.total[WS2811_STAGE_ENCODE].cycles;
+
+        for (frame = 0; frame < frames; frame++)
+        {
+            uint64_t start;
+
+            scenario->frame(channel.leds, count, WARMUP_FRAMES + frame);
+
+            start = now_ns();
+            if (ws2811_render(&ws2811))
+            {
+                ws2811_fini(&ws2811);
+                free(render_ns);
+                return -1;
+            }
+            ns[frame] = now_ns() - start;
+            total += ns[frame];
+        }
+        ws2811_wait(&ws2811);
+
+        ws2811_stats(&ws2811, &stats);
+        encode_ns += stats.total[WS2811_STAGE_ENCODE].ns;
+        encode_cycles += stats.total[WS2811_STAGE_ENCODE].cycles;
+        pmu = stats.pmu;
+        if (stats.latency[WS2811_LATENCY_TOTAL].p99 > latency_p99)
+        {
+            latency_p99 = stats.latency[WS2811_LATENCY_TOTAL].p99;
+        }
+
+        ws2811_emu_output(&ws2811, &len);
+        result->wire_fps = (3.0 * TARGET_FREQ) / (len * 8.0);
+
+        ws2811_fini(&ws2811);
+
+        fps_sum += (frames * 1000000000.0) / total;
+        fps_sq += ((frames * 1000000000.0) / total) * ((frames * 1000000000.0) / total);
+    }
+
+    qsort(render_ns, frames * runs, sizeof(*render_ns), cmp_u64);
+
+    result->fps_mean = fps_sum / runs;
+    result->fps_stddev = (runs > 1) ? sqrt(fmax(0.0, (fps_sq - (fps_sum * fps_sum) / runs) / (runs - 1))) : 0.0;
+    result->render_p50_us = render_ns[(frames * runs * 50) / 100] / 1000.0;
+    result->render_p99_us = render_ns[(frames * runs * 99) / 100] / 1000.0;
+    result->encode_ns_per_led = (double)encode_ns / ((double)frames * runs * count);
+    result->cycles_per_led = pmu ? (double)encode_cycles / ((double)frames * runs * count) : 0.0;
+    result->latency_p99_us = wire_time ? latency_p99 / 1000.0 : 0.0;
+
+    free(render_ns);
+
+    return 0;
+}
+
+typedef struct
+{
+    const char *name;
+    ws2811_fault_t faults[2];
+    int init_fails;                              // ws2811_init() is expected to fail
+    int failures;                                // Number of renders expected to fail
+    int error;                                   // WS2811_ERROR_xxx expected to be counted once
+    uint64_t max_init_ns;                        // Bound on ws2811_init() time
+    uint64_t max_recovery_ns;                    // Bound on failed render to next good render
+    uint64_t max_extra_ns;                       // Bound on run time on top of a fault free run
+} fault_case_t;
+
+static const fault_case_t fault_cases[] =
+{
+    {
+        .name = "dma_read",
+        .faults = { { FAULT_FRAME, WS2811_FAULT_DMA_ERROR, RPI_DMA_DEBUG_READ_ERROR } },
+        .failures = 1,
+        .error = WS2811_ERROR_DMA_READ,
+        .max_init_ns = 50000000,
+        .max_recovery_ns = 5000000,
+        .max_extra_ns = 5000000,
+    },
+    {
+        .name = "dma_fifo",
+        .faults = { { FAULT_FRAME, WS2811_FAULT_DMA_ERROR, RPI_DMA_DEBUG_FIFO_ERROR } },
+        .failures = 1,
+        .error = WS2811_ERROR_DMA_FIFO,
+        .max_init_ns = 50000000,
+        .max_recovery_ns = 5000000,
+        .max_extra_ns = 5000000,
+    },
+    {
+        .name = "dma_read_last",
+        .faults = { { FAULT_FRAME, WS2811_FAULT_DMA_ERROR, RPI_DMA_DEBUG_READ_LAST_NOT_SET_ERROR } },
+        .failures = 1,
+        .error = WS2811_ERROR_DMA_READ_LAST,
+        .max_init_ns = 50000000,
+        .max_recovery_ns = 5000000,
+        .max_extra_ns = 5000000,
+    },
+    {
+        .name = "underrun",
+        .faults = { { FAULT_FRAME, WS2811_FAULT_UNDERRUN } },
+        .error = WS2811_ERROR_PCM_UNDERRUN,
+        .max_init_ns = 50000000,
+        .max_extra_ns = 5000000,
+    },
+    {
+        .name = "slow",
+        .faults = { { FAULT_FRAME, WS2811_FAULT_SLOW, 20000 } },
+        .max_init_ns = 50000000,
+        .max_extra_ns = 25000000,
+    },
+    {
+        .name = "clk_busy",
+        .faults = { { 0, WS2811_FAULT_CLK_BUSY, 5 } },
+        .max_init_ns = 50000000,
+        .max_extra_ns = 5000000,
+    },
+    {
+        .name = "clk_stuck",
+        .faults = { { 0, WS2811_FAULT_CLK_BUSY, 0 } },
+        .init_fails = 1,
+        .max_init_ns = 100000000,
+    },
+    {
+        .name = "alloc",
+        .faults = { { 0, WS2811_FAULT_ALLOC } },
+        .init_fails = 1,
+        .max_init_ns = 1000000,
+    },
+};
+
+/**
+ * Run one fault case, or a fault free reference run, and check the bounds.
+ *
+ * @param    fault_case  Case to run, NULL for the fault free reference.
+ * @param    clean_ns    Run time of the fault free reference, updated for NULL.
+ *
+ * @returns  0 if all bounds are met, -1 otherwise.
+ */
+static int run_fault_case(const fault_case_t *fault_case, uint64_t *clean_ns)
+{
+    ws2811_channel_t channel =
+    {
+        .count = FAULT_LEDS,
+        .brightness = 255,
+        .strip_type = WS2811_STRIP_GRB,
+    };
+    ws2811_t ws2811 =
+    {
+        .freq = TARGET_FREQ,
+        .channel = &channel,
+        .flags = WS2811_FLAG_EMULATE,
+        .faults = fault_case ? fault_case->faults : NULL,
+    };
+    const char *name = fault_case ? fault_case->name : "clean";
+    uint64_t start, init_ns, run_ns, failed_at = 0, recovery_ns = 0;
+    int failures = 0, init_failed, frame;
+    ws2811_stats_t stats;
+    char why[128] = "";
+
+    start = now_ns();
+    init_failed = ws2811_init(&ws2811) != 0;
+    init_ns = now_ns() - start;
+
+    if (!fault_case && init_failed)
+    {
+        fprintf(stderr, "%-14s FAIL  init failed\n", name);
+        return -1;
+    }
+
+    if (fault_case && (init_failed != fault_case->init_fails))
+    {
+        snprintf(why, sizeof(why), "init %s", init_failed ? "failed" : "succeeded");
+    }
+
+    if (!init_failed)
+    {
+        rnd_state = 1;
+        start = now_ns();
+        for (frame = 0; frame < FAULT_FRAMES; frame++)
+        {
+            frame_full(channel.leds, FAULT_LEDS, frame);
+
+            if (ws2811_render(&ws2811))
+            {
+                failures++;
+                if (!failed_at)
+                {
+                    failed_at = now_ns();
+                }
+            }
+            else if (failed_at && !recovery_ns)
+            {
+                recovery_ns = now_ns() - failed_at;
+            }
+        }
+        ws2811_wait(&ws2811);
+        run_ns = now_ns() - start;
+
+        ws2811_stats(&ws2811, &stats);
+        ws2811_fini(&ws2811);
+
+        if (!fault_case)
+        {
+            *clean_ns = run_ns;
+            fprintf(stderr, "%-14s %8.1f ms\n", name, run_ns / 1000000.0);
+            return 0;
+        }
+
+        if (!why[0] && (failures != fault_case->failures))
+        {
+            snprintf(why, sizeof(why), "%d failed renders, expected %d", failures, fault_case->failures);
+        }
+        if (!why[0] && fault_case->error && (stats.errors[fault_case->error] != 1))
+        {
+            snprintf(why, sizeof(why), "%s counted %llu times", ws2811_error_str(fault_case->error),
+                     (unsigned long long)stats.errors[fault_case->error]);
+        }
+        if (!why[0] && failures && !recovery_ns)
+        {
+            snprintf(why, sizeof(why), "never recovered");
+        }
+        if (!why[0] && fault_case->max_recovery_ns && (recovery_ns > fault_case->max_recovery_ns))
+        {
+            snprintf(why, sizeof(why), "recovery took %.1f ms", recovery_ns / 1000000.0);
+        }
+        if (!why[0] && (run_ns > ((*clean_ns * 3) / 2) + fault_case->max_extra_ns))
+        {
+            snprintf(why, sizeof(why), "run took %.1f ms", run_ns / 1000000.0);
+        }
+    }
+
+    if (!why[0] && (init_ns > fault_case->max_init_ns))
+    {
+        snprintf(why, sizeof(why), "init took %.1f ms", init_ns / 1000000.0);
+    }
+
+    fprintf(stderr, "%-14s %s  init %.1f ms, %d failed renders, recovery %.2f ms %s\n", name,
+            why[0] ? "FAIL" : "PASS", init_ns / 1000000.0, failures, recovery_ns / 1000000.0, why);
+
+    return why[0] ? -1 : 0;
+}
+
+/**
+ * Run all fault cases.
+ *
+ * @returns  Number of failed cases.
+ */
+static int run_faults(void)
+{
+    uint64_t clean_ns = 0;
+    int failed = 0;
+    unsigned i;
+
+    if (run_fault_case(NULL, &clean_ns))
+    {
+        return 1;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(fault_cases); i++)
+    {
+        failed += run_fault_case(&fault_cases[i], &clean_ns) ? 1 : 0;
+    }
+
+    return failed;
+}
+
+static const char *effect_names[] = { "rainbow", "chase", "fire", "twinkle", "plasma", "gradient" };
+
+/**
+ * Time one effect.
+ *
+ * @param    effect  Index into effect_names.
+ * @param    count   Number of LEDs.
+ * @param    frames  Number of steps.
+ *
+ * @returns  Nanoseconds per LED per step, negative if out of memory.
+ */
+static double run_effect(int effect, int count, int frames)
+{
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    effect_rainbow_t rainbow = { .speed = EFFECT_FIXED(0.5), .spread = EFFECT_FIXED(1), .value = 255 };
+    effect_chase_t chase = { .color = 0xff0000, .spacing = 3, .speed = EFFECT_FIXED(10) };
+    effect_fire_t fire = { .cooling = 55, .sparking = 120, .rate = EFFECT_FIXED(60) };
+    effect_twinkle_t twinkle = { .color = 0xffffff, .density = EFFECT_FIXED(0.5), .decay = EFFECT_FIXED(2) };
+    effect_plasma_t plasma = { .width = sqrt(count), .scale = EFFECT_FIXED(0.05), .speed = EFFECT_FIXED(0.2),
+                               .value = 255 };
+    effect_gradient_t gradient = { .from = 0xff0000, .to = 0x0000ff, .speed = EFFECT_FIXED(0.25) };
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame;
+
+    if (leds && !effect_fire_init(&fire, count) && !effect_twinkle_init(&twinkle, count))
+    {
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            switch (effect)
+            {
+                case 0: effect_rainbow(&rainbow, leds, count, EFFECT_DT_US); break;
+                case 1: effect_chase(&chase, leds, count, EFFECT_DT_US); break;
+                case 2: effect_fire(&fire, leds, count, EFFECT_DT_US); break;
+                case 3: effect_twinkle(&twinkle, leds, count, EFFECT_DT_US); break;
+                case 4: effect_plasma(&plasma, leds, count, EFFECT_DT_US); break;
+                case 5: effect_gradient(&gradient, leds, count, EFFECT_DT_US); break;
+            }
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    effect_twinkle_free(&twinkle);
+    effect_fire_free(&fire);
+    free(leds);
+
+    return ns_per_led;
+}
+
+static const char *blend_names[COMPOSITE_MODES] = { "normal", "add", "multiply", "screen", "max" };
+
+/**
+ * Time flattening a full base layer and a half transparent overlay.
+ *
+ * @param    mode    Blend mode of the overlay.
+ * @param    count   Number of LEDs.
+ * @param    frames  Number of flattens.
+ *
+ * @returns  Nanoseconds per LED per flatten, negative if out of memory.
+ */
+static double run_composite(int mode, int count, int frames)
+{
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    composite_t *composite = composite_create(count, 2);
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame, i;
+
+    if (leds && composite)
+    {
+        composite_set(composite, 1, mode, 192);
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            uint32_t *base = composite_pixels(composite, 0);
+            uint32_t *overlay = composite_pixels(composite, 1);
+
+            for (i = 0; i < count; i++)
+            {
+                base[i] = 0xff000000 | ((uint32_t)i * 0x010203u) | frame;
+                overlay[i] = ((uint32_t)(i & 0xff) << 24) | 0x406080;
+            }
+            composite_dirty(composite, 0, 0, count);
+            composite_dirty(composite, 1, 0, count);
+            composite_flatten(composite, leds);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    composite_destroy(composite);
+    free(leds);
+
+    return ns_per_led;
+}
+
+static const char *convert_names[] = { "hsv8", "hsv8-rb", "hsv8-pl", "hsv16", "hsl8" };
+
+/**
+ * Time a color conversion.
+ *
+ * @param    convert  Index into convert_names.
+ * @param    count    Number of LEDs.
+ * @param    frames   Number of conversions.
+ *
+ * @returns  Nanoseconds per LED per conversion, negative if out of memory.
+ */
+static double run_convert(int convert, int count, int frames)
+{
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    color_hsv8_t *hsv8 = calloc(count, sizeof(*hsv8));
+    color_hsv16_t *hsv16 = calloc(count, sizeof(*hsv16));
+    uint8_t *planar = calloc(count, 3);
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame, i;
+
+    if (leds && hsv8 && hsv16 && planar)
+    {
+        for (i = 0; i < count; i++)
+        {
+            hsv8[i] = (color_hsv8_t){ i, 255 - (i & 0x3f), 200 };
+            hsv16[i] = (color_hsv16_t){ i * 64, 0xffff - (i & 0x3fff), 0xc000 };
+        }
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            switch (convert)
+            {
+                case 0: color_hsv8_rgb(hsv8, leds, count, COLOR_SPECTRUM); break;
+                case 1: color_hsv8_rgb(hsv8, leds, count, COLOR_RAINBOW); break;
+                case 2: color_hsv8_planar(hsv8, planar, planar + count, planar + (2 * count), count,
+                                          COLOR_SPECTRUM); break;
+                case 3: color_hsv16_rgb(hsv16, leds, count, COLOR_SPECTRUM); break;
+                case 4: color_hsl8_rgb((color_hsl8_t *)hsv8, leds, count, COLOR_SPECTRUM); break;
+            }
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    free(planar);
+    free(hsv16);
+    free(hsv8);
+    free(leds);
+
+    return ns_per_led;
+}
+
+static const char *correct_names[] = { "encode", "enc-l3d", "enc-cal", "lut3d", "lut3d-fl" };
+
+/**
+ * Time color correction and calibration, alone and fused into the encoder.
+ *
+ * @param    correct  Index into correct_names.
+ * @param    count    Number of LEDs.
+ * @param    frames   Number of passes.
+ *
+ * @returns  Nanoseconds per LED per pass, negative if out of memory.
+ */
+static double run_correct(int correct, int count, int frames)
+{
+    ws2811_channel_t channel = { .count = count, .brightness = 255, .strip_type = WS2811_STRIP_GRB };
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    ws2811_led_t *gains = calloc(count, sizeof(*gains));
+    uint32_t *out = calloc(ENCODE_WORDS(count), sizeof(*out));
+    lut3d_t *lut = lut3d_create(33);
+    double ns_per_led = -1.0;
+    encoder_t encoder;
+    uint64_t start;
+    int frame, i;
+
+    if (leds && gains && out && lut)
+    {
+        for (i = 0; i < count; i++)
+        {
+            leds[i] = (correct == 4) ? 0x204080 : (rnd() & 0xffffff);
+            gains[i] = 0xe0f0ff - (rnd() & 0x0f0f0f);
+        }
+
+        encoder_init(&encoder);
+        channel.leds = leds;
+        channel.lut3d = (correct == 1) ? lut : NULL;
+        channel.calibration = (correct == 2) ? gains : NULL;
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            if (correct < 3)
+            {
+                encode_lut(&encoder, &channel, out);
+            }
+            else
+            {
+                lut3d_apply(lut, leds, leds, count);
+            }
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    lut3d_destroy(lut);
+    free(out);
+    free(gains);
+    free(leds);
+
+    return ns_per_led;
+}
+
+static const char *keyframe_names[] = { "crossfd", "cf-dith" };
+
+/**
+ * Time keyframe crossfades, rendering four times per keyframe.
+ *
+ * @param    dither  Index into keyframe_names.
+ * @param    count   Number of LEDs.
+ * @param    frames  Number of renders.
+ *
+ * @returns  Nanoseconds per LED per render, negative if out of memory.
+ */
+static double run_keyframe(int dither, int count, int frames)
+{
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    keyframe_t *keyframe = keyframe_create(count);
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame, i;
+
+    if (leds && keyframe)
+    {
+        keyframe->dither = dither;
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            if (!(frame & 3))
+            {
+                for (i = 0; i < count; i++)
+                {
+                    leds[i] = (uint32_t)(frame + i) * 0x010203u;
+                }
+                keyframe_push(keyframe, leds, (frame + 8) * 1000);
+            }
+            keyframe_render(keyframe, frame * 1000, leds);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    keyframe_destroy(keyframe);
+    free(leds);
+
+    return ns_per_led;
+}
+
+static const char *noise_names[] = { "value2", "value3", "simplex2", "simplex3", "value3x3" };
+
+/**
+ * Time a noise generator and the palette lookup after it, moving along z.
+ *
+ * @param    generator  Index into noise_names.
+ * @param    count      Number of LEDs.
+ * @param    frames     Number of rows generated.
+ *
+ * @returns  Nanoseconds per LED per row, negative if out of memory.
+ */
+static double run_noise(int generator, int count, int frames)
+{
+    static const ws2811_led_t keys[] = { 0x000000, 0x800000, 0xff8000, 0xffff80 };
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    uint8_t *values = calloc(count, sizeof(*values));
+    noise_t noise = { .step = EFFECT_FIXED(0.05), .seed = 1, .octaves = (generator == 4) ? 3 : 1 };
+    ws2811_led_t palette[256];
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame;
+
+    if (leds && values)
+    {
+        noise_palette_build(palette, keys, ARRAY_SIZE(keys));
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            noise.y = frame * 1000;
+            noise.z = frame * 2000;
+            switch (generator)
+            {
+                case 0: noise_value2(&noise, values, count); break;
+                case 1: noise_value3(&noise, values, count); break;
+                case 2: noise_simplex2(&noise, values, count); break;
+                case 3: noise_simplex3(&noise, values, count); break;
+                case 4: noise_value3(&noise, values, count); break;
+            }
+            noise_palette(values, palette, leds, count);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    free(values);
+    free(leds);
+
+    return ns_per_led;
+}
+
+static const char *canvas_names[] = { "blit", "blit-key", "scaled", "scroll", "show-srp" };
+
+/**
+ * Time a blit of a sprite half the canvas size to eight positions partly off
+ * the canvas, or showing a serpentine canvas on the LEDs.  The canvas is 32
+ * pixels wide, or as wide as count for fewer LEDs.
+ *
+ * @param    operation  Index into canvas_names.
+ * @param    count      Number of LEDs.
+ * @param    frames     Number of frames.
+ *
+ * @returns  Nanoseconds per LED per frame, negative if out of memory.
+ */
+static double run_canvas(int operation, int count, int frames)
+{
+    int width = (count < 32) ? count : 32, height = count / width;
+    canvas_t *canvas = canvas_create(width, height, CANVAS_SERPENTINE);
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    ws2811_led_t *sprite = calloc(count, sizeof(*sprite));
+    canvas_image_t image = { .width = (width + 1) / 2, .height = (height + 1) / 2, .stride = (width + 1) / 2 };
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame, i;
+
+    if (canvas && leds && sprite)
+    {
+        for (i = 0; i < count; i++)
+        {
+            sprite[i] = (i % 3) ? (uint32_t)i * 0x010203 : 0;
+        }
+        image.pixels = sprite;
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            int x = (frame % 8) * width / 4 - width / 4, y = (frame % 5) * height / 4 - height / 4;
+
+            switch (operation)
+            {
+                case 0: canvas_blit(canvas, &image, x, y, CANVAS_OPAQUE); break;
+                case 1: canvas_blit(canvas, &image, x, y, 0); break;
+                case 2: canvas_blit_scaled(canvas, &image, x, y, width, height, CANVAS_OPAQUE); break;
+                case 3: canvas_blit_scroll(canvas, &image, 0, 0, width, height, frame, 0, CANVAS_OPAQUE); break;
+                case 4: canvas_show(canvas, leds, count); break;
+            }
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    canvas_destroy(canvas);
+    free(sprite);
+    free(leds);
+
+    return ns_per_led;
+}
+
+static const char *script_names[] = { "script", "scr-cnv" };
+
+/**
+ * Time a plasma effect script on a strip, or on a serpentine canvas 32
+ * pixels wide.
+ *
+ * @param    canvas  Index into script_names.
+ * @param    count   Number of LEDs.
+ * @param    frames  Number of frames.
+ *
+ * @returns  Nanoseconds per LED per frame, negative if out of memory.
+ */
+static double run_script(int canvas, int count, int frames)
+{
+    static const char source[] =
+        "v = sin(x / w + t * 0.25) + sin(y / 8 - t * 0.5) + cos((x + y) / 16 + t * 0.1)\n"
+        "r = v * 0.33 + 0.5; g = abs(v) * p0; b = 1 - r\n";
+    int width = (count < 32) ? count : 32;
+    canvas_t *matrix = canvas ? canvas_create(width, count / width, CANVAS_SERPENTINE) : NULL;
+    script_t *script = script_compile(source, NULL, 0);
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame;
+
+    if (script && leds && (matrix || !canvas))
+    {
+        script_param(script, 0, 0.5);
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            script_run(script, matrix, leds, count, frame * 10000ULL);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    script_destroy(script);
+    canvas_destroy(matrix);
+    free(leds);
+
+    return ns_per_led;
+}
+
+static const char *downscale_names[] = { "down", "down-gm" };
+
+/**
+ * Time downscaling a 640x360 RGB video frame to a canvas 32 pixels wide.
+ *
+ * @param    gamma   Index into downscale_names.
+ * @param    count   Number of LEDs.
+ * @param    frames  Number of frames.
+ *
+ * @returns  Nanoseconds per LED per frame, negative if out of memory.
+ */
+static double run_downscale(int gamma, int count, int frames)
+{
+    int width = (count < 32) ? count : 32, height = count / width;
+    canvas_t *canvas = canvas_create(width, height, CANVAS_ROWS);
+    downscale_t *ds = downscale_create(640, 360, 3, width, height, gamma ? DOWNSCALE_GAMMA : 0);
+    uint8_t *image = malloc(640 * 360 * 3);
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame, i;
+
+    if (canvas && ds && image)
+    {
+        for (i = 0; i < 640 * 360 * 3; i++)
+        {
+            image[i] = (i * 7) ^ (i >> 9);
+        }
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            downscale_run(ds, image, 640 * 3, canvas);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    downscale_destroy(ds);
+    canvas_destroy(canvas);
+    free(image);
+
+    return ns_per_led;
+}
+
+static const char *slew_names[] = { "slew", "slew-rmp" };
+
+/**
+ * Time the slew limiter on content cutting between two frames every 16
+ * frames, at full level or while ramping the level up and down.
+ *
+ * @param    ramp    Index into slew_names.
+ * @param    count   Number of LEDs.
+ * @param    frames  Number of frames.
+ *
+ * @returns  Nanoseconds per LED per frame, negative if out of memory.
+ */
+static double run_slew(int ramp, int count, int frames)
+{
+    slew_t *slew = slew_create(count);
+    ws2811_led_t *content = calloc(count * 2, sizeof(*content));
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame, i;
+
+    if (slew && content && leds)
+    {
+        for (i = 0; i < count * 2; i++)
+        {
+            content[i] = (uint32_t)i * 0x9e3779b1 >> 8;
+        }
+        slew->max_step = 4096;
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            if (ramp && !(frame % 32))
+            {
+                slew_ramp(slew, (frame % 64) ? 255 : 0, 32);
+            }
+            slew_apply(slew, &content[((frame / 16) & 1) * count], leds);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    slew_destroy(slew);
+    free(content);
+    free(leds);
+
+    return ns_per_led;
+}
+
+static const char *dither_names[] = { "dith-ord", "dith-fs" };
+
+/**
+ * Time dithering a 16 bit gradient on a canvas 32 pixels wide, for a channel
+ * at low brightness.
+ *
+ * @param    mode    Index into dither_names.
+ * @param    count   Number of LEDs.
+ * @param    frames  Number of frames.
+ *
+ * @returns  Nanoseconds per LED per frame, negative if out of memory.
+ */
+static double run_dither(int mode, int count, int frames)
+{
+    int width = (count < 32) ? count : 32, height = count / width;
+    canvas_t *canvas = canvas_create(width, height, CANVAS_ROWS);
+    dither_t *dither = dither_create(width, height, mode ? DITHER_DIFFUSION : DITHER_ORDERED);
+    uint16_t *image = malloc(width * height * 3 * sizeof(*image));
+    ws2811_channel_t channel = { .brightness = 32 };
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame, i;
+
+    if (canvas && dither && image)
+    {
+        for (i = 0; i < width * height * 3; i++)
+        {
+            image[i] = (i * 65535U) / (width * height * 3);
+        }
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            dither_update(dither, &channel);
+            dither_run(dither, image, canvas);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    dither_destroy(dither);
+    canvas_destroy(canvas);
+    free(image);
+
+    return ns_per_led;
+}
+
+static const char *tasks_names[] = { "plas-mt", "comp-mt", "hsv8-mt", "scr-mt" };
+
+// Inputs and state of the stages timed by run_tasks(), on a pool or not
+typedef struct
+{
+    int count;
+    ws2811_led_t *leds;
+    color_hsv8_t *hsv;
+    composite_t *composite;
+    script_t *script;
+    canvas_t *matrix;
+    effect_plasma_t plasma;
+    tasks_t *tasks;
+} tasks_bench_t;
+
+static void tasks_bench_destroy(tasks_bench_t *bench)
+{
+    canvas_destroy(bench->matrix);
+    script_destroy(bench->script);
+    composite_destroy(bench->composite);
+    free(bench->hsv);
+    free(bench->leds);
+}
+
+/**
+ * Set up the effect, compositor, color and script stages.
+ *
+ * @param    bench  Filled in.
+ * @param    count  Number of LEDs.
+ * @param    tasks  Pool to run them on, NULL to run them serially.
+ *
+ * @returns  0 on success, -1 if out of memory.
+ */
+static int tasks_bench_create(tasks_bench_t *bench, int count, tasks_t *tasks)
+{
+    int width = (count < 32) ? count : 32;
+    int i, layer;
+
+    *bench = (tasks_bench_t){ .count = count, .tasks = tasks };
+    bench->leds = calloc(count, sizeof(*bench->leds));
+    bench->hsv = calloc(count, sizeof(*bench->hsv));
+    bench->composite = composite_create(count, 4);
+    bench->script = script_compile("v = sin(x / w + t * 0.25) + sin(y / 8 - t * 0.5)\n"
+                                   "r = v * 0.5 + 0.5; g = abs(v) * p0; b = 1 - r\n", NULL, 0);
+    bench->matrix = canvas_create(width, count / width, CANVAS_ROWS);
+    bench->plasma = (effect_plasma_t){ .width = sqrt(count), .scale = EFFECT_FIXED(0.05),
+                                       .speed = EFFECT_FIXED(0.2), .value = 255, .tasks = tasks };
+
+    if (!bench->leds || !bench->hsv || !bench->composite || !bench->script || !bench->matrix)
+    {
+        tasks_bench_destroy(bench);
+        return -1;
+    }
+
+    bench->composite->tasks = tasks;
+    bench->script->tasks = tasks;
+    for (layer = 1; layer < 4; layer++)
+    {
+        composite_set(bench->composite, layer, layer, 160);
+    }
+    for (i = 0; i < count; i++)
+    {
+        bench->hsv[i] = (color_hsv8_t){ i, 255 - (i & 0x3f), 200 };
+        for (layer = 0; layer < 4; layer++)
+        {
+            composite_pixels(bench->composite, layer)[i] = 0xff000000 | ((uint32_t)i * (0x010203u << layer));
+        }
+    }
+
+    return 0;
+}
+
+// Run one frame of a stage into bench->leds
+static void tasks_bench_frame(tasks_bench_t *bench, int stage, int frame)
+{
+    switch (stage)
+    {
+        case 0: effect_plasma(&bench->plasma, bench->leds, bench->count, EFFECT_DT_US); break;
+        case 1:
+            composite_dirty(bench->composite, 0, 0, bench->count);
+            composite_flatten(bench->composite, bench->leds);
+            break;
+        case 2: color_hsv8_rgb_tasks(bench->tasks, bench->hsv, bench->leds, bench->count, COLOR_RAINBOW); break;
+        case 3: script_run(bench->script, bench->matrix, bench->leds, bench->count, frame * 10000ULL); break;
+    }
+}
+
+/**
+ * Time the effect, compositor, color and script stages on a pool with a
+ * thread per CPU.
+ *
+ * @param    stage   Index into tasks_names.
+ * @param    count   Number of LEDs.
+ * @param    frames  Number of frames.
+ *
+ * @returns  Nanoseconds per LED per frame, negative if out of memory.
+ */
+static double run_tasks(int stage, int count, int frames)
+{
+    tasks_t *tasks = tasks_create(0);
+    double ns_per_led = -1.0;
+    tasks_bench_t bench;
+    uint64_t start;
+    int frame;
+
+    if (tasks && !tasks_bench_create(&bench, count, tasks))
+    {
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            tasks_bench_frame(&bench, stage, frame);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+
+        tasks_bench_destroy(&bench);
+    }
+
+    tasks_destroy(tasks);
+
+    return ns_per_led;
+}
+
+/**
+ * Check that the stages of run_tasks() give the same colors tiled over a
+ * pool as they do serially, every frame and bit for bit.
+ *
+ * @returns  Number of stages that differ or couldn't run.
+ */
+static int run_tasks_check(void)
+{
+    tasks_t *tasks = tasks_create(TASKS_CHECK_THREADS);
+    tasks_bench_t serial, tiled;
+    int failed = 0, stage, frame;
+
+    for (stage = 0; stage < (int)ARRAY_SIZE(tasks_names); stage++)
+    {
+        char why[64] = "";
+
+        if (!tasks || tasks_bench_create(&serial, TASKS_CHECK_LEDS, NULL))
+        {
+            fprintf(stderr, "%-14s FAIL  out of memory\n", tasks_names[stage]);
+            failed++;
+            continue;
+        }
+        if (tasks_bench_create(&tiled, TASKS_CHECK_LEDS, tasks))
+        {
+            fprintf(stderr, "%-14s FAIL  out of memory\n", tasks_names[stage]);
+            tasks_bench_destroy(&serial);
+            failed++;
+            continue;
+        }
+
+        for (frame = 0; (frame < TASKS_CHECK_FRAMES) && !why[0]; frame++)
+        {
+            tasks_bench_frame(&serial, stage, frame);
+            tasks_bench_frame(&tiled, stage, frame);
+
+            if (memcmp(serial.leds, tiled.leds, TASKS_CHECK_LEDS * sizeof(*serial.leds)))
+            {
+                snprintf(why, sizeof(why), "differs from serial in frame %d", frame);
+            }
+        }
+
+        fprintf(stderr, "%-14s %s  %d LEDs, %d threads, %d frames %s\n", tasks_names[stage],
+                why[0] ? "FAIL" : "PASS", TASKS_CHECK_LEDS, tasks_threads(tasks), TASKS_CHECK_FRAMES, why);
+        failed += why[0] ? 1 : 0;
+
+        tasks_bench_destroy(&tiled);
+        tasks_bench_destroy(&serial);
+    }
+
+    tasks_destroy(tasks);
+
+    return failed;
+}
+
+static const char *particle_names[] = { "part-fw", "part-rn" };
+
+/**
+ * Time stepping and rendering fireworks falling under gravity, or rain, on
+ * a 64x32 canvas.  The pool is topped up to count particles every frame.
+ *
+ * @param    rain    Index into particle_names.
+ * @param    count   Number of particles.
+ * @param    frames  Number of frames.
+ *
+ * @returns  Nanoseconds per particle per frame, negative if out of memory.
+ */
+static double run_particle(int rain, int count, int frames)
+{
+    particle_system_t *ps = particle_create(count, 64, 32);
+    canvas_t *canvas = canvas_create(64, 32, CANVAS_SERPENTINE);
+    particle_emitter_t emitter = { .x = PARTICLE_FIXED(32), .y = PARTICLE_FIXED(12), .speed = PARTICLE_FIXED(20),
+                                   .life = PARTICLE_FIXED(1), .life_spread = PARTICLE_FIXED(1),
+                                   .color = 0x402010, .seed = 1 };
+    double ns_per_led = -1.0;
+    uint64_t start;
+    int frame;
+
+    if (ps && canvas)
+    {
+        ps->ay = PARTICLE_FIXED(9.8);
+        ps->drag = PARTICLE_FIXED(0.5);
+        if (rain)
+        {
+            emitter = (particle_emitter_t){ .x = PARTICLE_FIXED(32), .width = PARTICLE_FIXED(64),
+                                            .vy = PARTICLE_FIXED(20), .speed = PARTICLE_FIXED(2),
+                                            .life = PARTICLE_FIXED(4), .color = 0x000030, .seed = 1 };
+        }
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            particle_emit(ps, &emitter, count - ps->count);
+            particle_step(ps, EFFECT_DT_US);
+            memset(canvas->pixels, 0, 64 * 32 * sizeof(*canvas->pixels));
+            particle_render(ps, canvas);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    canvas_destroy(canvas);
+    particle_destroy(ps);
+
+    return ns_per_led;
+}
+
+static const char *framerate_names[] = { "frc-hold", "frc-near", "frc-blnd" };
+
+/**
+ * Time converting a 25 fps producer to 60 renders per second, a frame
+ * ahead so blending has the next frame.
+ *
+ * @param    policy  Index into framerate_names, FRAMERATE_xxx.
+ * @param    count   Number of LEDs.
+ * @param    frames  Number of renders.
+ *
+ * @returns  Nanoseconds per LED per render, negative if out of memory.
+ */
+static double run_framerate(int policy, int count, int frames)
+{
+    ws2811_led_t *leds = calloc(count, sizeof(*leds));
+    framerate_t *framerate = framerate_create(count, policy);
+    double ns_per_led = -1.0;
+    uint64_t start, pushed = 0;
+    int frame, i;
+
+    if (leds && framerate)
+    {
+        framerate->delay_us = 40000;
+
+        start = now_ns();
+        for (frame = 0; frame < frames; frame++)
+        {
+            while (pushed <= ((uint64_t)frame * EFFECT_DT_US))
+            {
+                for (i = 0; i < count; i++)
+                {
+                    leds[i] = (pushed / 40000 + i) * 0x010203;
+                }
+                framerate_push(framerate, leds, pushed);
+                pushed += 40000;
+            }
+            framerate_render(framerate, (uint64_t)frame * EFFECT_DT_US, leds);
+        }
+        ns_per_led = (double)(now_ns() - start) / ((double)frames * count);
+    }
+
+    framerate_destroy(framerate);
+    free(leds);
+
+    return ns_per_led;
+}
+
+// One row per group of stages timed by run_effects(), run() takes an index into names
+typedef struct
+{
+    const char *const *names;
+    int count;
+    double (*run)(int index, int count, int frames);
+} effect_stage_t;
+
+static const effect_stage_t effect_stages[] =
+{
+    { effect_names, ARRAY_SIZE(effect_names), run_effect },
+    { blend_names, ARRAY_SIZE(blend_names), run_composite },
+    { convert_names, ARRAY_SIZE(convert_names), run_convert },
+    { correct_names, ARRAY_SIZE(correct_names), run_correct },
+    { keyframe_names, ARRAY_SIZE(keyframe_names), run_keyframe },
+    { noise_names, ARRAY_SIZE(noise_names), run_noise },
+    { canvas_names, ARRAY_SIZE(canvas_names), run_canvas },
+    { script_names, ARRAY_SIZE(script_names), run_script },
+    { downscale_names, ARRAY_SIZE(downscale_names), run_downscale },
+    { slew_names, ARRAY_SIZE(slew_names), run_slew },
+    { dither_names, ARRAY_SIZE(dither_names), run_dither },
+    { tasks_names, ARRAY_SIZE(tasks_names), run_tasks },
+    { particle_names, ARRAY_SIZE(particle_names), run_particle },
+    { framerate_names, ARRAY_SIZE(framerate_names), run_framerate },
+};
+
+/**
+ * Time all effects, blend modes, color conversions, color correction,
+ * keyframe crossfades, noise generators, canvas blits, effect scripts, image
+ * downscaling, slew limiting, dithering, the stages on a task pool,
+ * particles and frame rate conversion for all LED counts.
+ *
+ * @param    counts   LED counts.
+ * @param    ncounts  Number of LED counts.
+ * @param    frames   Steps per effect and count.
+ *
+ * @returns  0 on success, -1 if out of memory.
+ */
+static int run_effects(const int *counts, int ncounts, int frames)
+{
+    unsigned s;
+    int i, j;
+
+    for (s = 0; s < ARRAY_SIZE(effect_stages); s++)
+    {
+        const effect_stage_t *stage = &effect_stages[s];
+
+        for (i = 0; i < stage->count; i++)
+        {
+            for (j = 0; j < ncounts; j++)
+            {
+                double ns_per_led = (counts[j] > 0) ? stage->run(i, counts[j], frames) : -1.0;
+
+                if (ns_per_led < 0)
+                {
+                    fprintf(stderr, "%s/%d failed\n", stage->names[i], counts[j]);
+                    return -1;
+                }
+
+                fprintf(stderr, "%-8s %6d LEDs: %6.2f ns/LED, %10.1f fps\n", stage->names[i], counts[j],
+                        ns_per_led, 1000000000.0 / (ns_per_led * counts[j]));
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void result_write(FILE *out, const result_t *r, int last)
+{
+    fprintf(out, "    {\"scenario\": \"%s\", \"leds\": %d, \"frames\": %d, \"runs\": %d, "
+                 "\"fps_mean\": %.3f, \"fps_stddev\": %.3f, \"render_p50_us\": %.3f, "
+                 "\"render_p99_us\": %.3f, \"encode_ns_per_led\": %.3f, \"cycles_per_led\": %.3f, "
+                 "\"wire_fps\": %.3f, \"latency_p99_us\": %.3f}%s\n",
+            r->scenario, r->leds, r->frames, r->runs, r->fps_mean, r->fps_stddev,
+            r->render_p50_us, r->render_p99_us, r->encode_ns_per_led, r->cycles_per_led,
+            r->wire_fps, r->latency_p99_us, last ? "" : ",");
+}
+
+static double json_number(const char *line, const char *key)
+{
+    char pattern[64];
+    const char *p;
+
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    p = strstr(line, pattern);
+
+    return p ? atof(p + strlen(pattern)) : 0.0;
+}
+
+/**
+ * Read a result file written by this program, one result object per line.
+ *
+ * @param    path       File name.
+ * @param    results    Array of MAX_RESULTS entries.
+ * @param    freq       Set to the output frequency of the run, -1 if missing.
+ * @param    wire_time  Set to 1 for a -w run, 0 if not, -1 if missing.
+ *
+ * @returns  Number of results read, -1 on error.
+ */
+static int results_read(const char *path, result_t *results, int *freq, int *wire_time)
+{
+    FILE *in = fopen(path, "r");
+    char line[1024];
+    int n = 0;
+
+    if (!in)
+    {
+        perror(path);
+        return -1;
+    }
+
+    *freq = *wire_time = -1;
+    while (fgets(line, sizeof(line), in) && (n < MAX_RESULTS))
+    {
+        result_t *r = &results[n];
+        const char *p = strstr(line, "\"scenario\": \"");
+
+        if (!p)
+        {
+            if (strstr(line, "\"freq\":"))
+            {
+                *freq = json_number(line, "freq");
+            }
+            if (strstr(line, "\"wire_time\":"))
+            {
+                *wire_time = json_number(line, "wire_time");
+            }
+            continue;
+        }
+
+        memset(r, 0, sizeof(*r));
+        sscanf(p + 13, "%31[^\"]", r->scenario);
+        r->leds = json_number(line, "leds");
+        r->runs = json_number(line, "runs");
+        r->fps_mean = json_number(line, "fps_mean");
+        r->fps_stddev = json_number(line, "fps_stddev");
+        r->render_p99_us = json_number(line, "render_p99_us");
+        r->latency_p99_us = json_number(line, "latency_p99_us");
+        n++;
+    }
+
+    fclose(in);
+
+    return n;
+}
+
+/**
+ * Compare two result files.  A throughput change counts when it exceeds the
+ * threshold and twice the standard error of the difference (Welch, about 95%
+ * confidence).  Tail render times, and the render to last bit out latency
+ * when both files have it, have no spread measure and only use the
+ * threshold.  Files from runs at different frequencies, or with and without
+ * -w, aren't comparable and are refused.
+ *
+ * @param    base_path  Baseline results.
+ * @param    new_path   New results.
+ * @param    threshold  Relative change in percent to ignore.
+ *
+ * @returns  1 if a significant regression was found, 0 if not, -1 on error.
+ */
+static int results_compare(const char *base_path, const char *new_path, double threshold)
+{
+    static result_t base[MAX_RESULTS], cur[MAX_RESULTS];
+    int base_freq, base_wire_time, cur_freq, cur_wire_time;
+    int nbase = results_read(base_path, base, &base_freq, &base_wire_time);
+    int ncur = results_read(new_path, cur, &cur_freq, &cur_wire_time);
+    int regressions = 0, i, j;
+
+    if ((nbase < 0) || (ncur < 0))
+    {
+        return -1;
+    }
+
+    if ((base_freq != cur_freq) || (base_wire_time != cur_wire_time))
+    {
+        fprintf(stderr, "%s (freq %d, wire_time %d) and %s (freq %d, wire_time %d) aren't comparable\n",
+                base_path, base_freq, base_wire_time, new_path, cur_freq, cur_wire_time);
+        return -1;
+    }
+
+    printf("%-8s %6s %12s %12s %8s %10s %10s %8s %10s %10s %8s\n", "scenario", "leds", "base fps",
+           "new fps", "delta", "base p99", "new p99", "delta", "base lat", "new lat", "delta");
+
+    for (i = 0; i < ncur; i++)
+    {
+        result_t *n = &cur[i], *b = NULL;
+        double dfps, se, dp99 = 0.0, dlat = 0.0;
+        const char *verdict = "";
+
+        for (j = 0; j < nbase; j++)
+        {
+            if (!strcmp(base[j].scenario, n->scenario) && (base[j].leds == n->leds))
+            {
+                b = &base[j];
+            }
+        }
+
+        if (!b || (b->fps_mean <= 0.0))
+        {
+            printf("%-8s %6d %12s %12.1f   (no baseline)\n", n->scenario, n->leds, "-", n->fps_mean);
+            continue;
+        }
+
+        dfps = ((n->fps_mean - b->fps_mean) * 100.0) / b->fps_mean;
+        se = sqrt(((b->fps_stddev * b->fps_stddev) / (b->runs ? b->runs : 1)) +
+                  ((n->fps_stddev * n->fps_stddev) / (n->runs ? n->runs : 1)));
+        if (b->render_p99_us > 0.0)
+        {
+            dp99 = ((n->render_p99_us - b->render_p99_us) * 100.0) / b->render_p99_us;
+        }
+        if ((b->latency_p99_us > 0.0) && (n->latency_p99_us > 0.0))
+        {
+            dlat = ((n->latency_p99_us - b->latency_p99_us) * 100.0) / b->latency_p99_us;
+        }
+
+        if (((dfps < -threshold) && (fabs(n->fps_mean - b->fps_mean) > 2.0 * se)) ||
+            (dp99 > threshold) || (dlat > threshold))
+        {
+            verdict = "REGRESSION";
+            regressions++;
+        }
+        else if ((dfps > threshold) && (fabs(n->fps_mean - b->fps_mean) > 2.0 * se))
+        {
+            verdict = "improved";
+        }
+
+        printf("%-8s %6d %12.1f %12.1f %+7.1f%% %10.1f %10.1f %+7.1f%% %10.1f %10.1f %+7.1f%% %s\n",
+               n->scenario, n->leds, b->fps_mean, n->fps_mean, dfps, b->render_p99_us, n->render_p99_us,
+               dp99, b->latency_p99_us, n->latency_p99_us, dlat, verdict);
+    }
+
+    return regressions ? 1 : 0;
+}
+
+static const scenario_t *scenario_find(const char *name)
+{
+    unsigned i;
+
+    for (i = 0; i < ARRAY_SIZE(scenarios); i++)
+    {
+        if (!strcmp(scenarios[i].name, name))
+        {
+            return &scenarios[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-o file] [-n count,...] [-s scenario,...] [-f frames] [-r runs] [-w]\n"
+                    "       %s -c base.json new.json [-t percent]\n"
+                    "       %s -F\n"
+                    "       %s -E [-n count,...] [-f frames]\n"
+                    "scenarios: full sparse static matrix mixed\n", prog, prog, prog, prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static result_t results[MAX_RESULTS];
+    const scenario_t *selected[ARRAY_SIZE(scenarios)];
+    int counts[MAX_COUNTS] = { 64, 256, 1024, 4096 };
+    int ncounts = 4, nselected = 0, nresults = 0;
+    int frames = 500, runs = 5, wire_time = 0, compare = 0, effects = 0;
+    double threshold = 5.0;
+    const char *output = NULL;
+    FILE *out = stdout;
+    char *tok;
+    int opt, i, j;
+
+    while ((opt = getopt(argc, argv, "o:n:s:f:r:wct:FE")) != -1)
+    {
+        switch (opt)
+        {
+            case 'o':
+                output = optarg;
+                break;
+            case 'n':
+                ncounts = 0;
+                for (tok = strtok(optarg, ","); tok && (ncounts < MAX_COUNTS); tok = strtok(NULL, ","))
+                {
+                    counts[ncounts++] = atoi(tok);
+                }
+                break;
+            case 's':
+                for (tok = strtok(optarg, ","); tok; tok = strtok(NULL, ","))
+                {
+                    const scenario_t *scenario = scenario_find(tok);
+
+                    if (!scenario || (nselected == ARRAY_SIZE(selected)))
+                    {
+                        usage(argv[0]);
+                        return 2;
+                    }
+                    selected[nselected++] = scenario;
+                }
+                break;
+            case 'f':
+                frames = atoi(optarg);
+                break;
+            case 'r':
+                runs = atoi(optarg);
+                break;
+            case 'w':
+                wire_time = 1;
+                break;
+            case 'c':
+                compare = 1;
+                break;
+            case 't':
+                threshold = atof(optarg);
+                break;
+            case 'F':
+                return (run_faults() + run_tasks_check()) ? 1 : 0;
+            case 'E':
+                effects = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (compare)
+    {
+        if (argc - optind != 2)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+
+        return results_compare(argv[optind], argv[optind + 1], threshold) ? 1 : 0;
+    }
+
+    if ((frames <= 0) || (runs <= 0))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (effects)
+    {
+        return run_effects(counts, ncounts, frames) ? 1 : 0;
+    }
+
+    if (!nselected)
+    {
+        for (i = 0; i < ARRAY_SIZE(scenarios); i++)
+        {
+            selected[nselected++] = &scenarios[i];
+        }
+    }
+
+    for (i = 0; i < nselected; i++)
+    {
+        for (j = 0; (j < ncounts) && (nresults < MAX_RESULTS); j++)
+        {
+            result_t *r = &results[nresults];
+
+            if ((counts[j] <= 0) ||
+                run_scenario(selected[i], counts[j], frames, runs, wire_time, r))
+            {
+                fprintf(stderr, "%s/%d failed\n", selected[i]->name, counts[j]);
+                return 1;
+            }
+
+            fprintf(stderr, "%-8s %6d LEDs: %10.1f fps (+-%.1f), render p99 %8.1f us, %6.2f ns/LED\n",
+                    r->scenario, r->leds, r->fps_mean, r->fps_stddev, r->render_p99_us,
+                    r->encode_ns_per_led);
+            nresults++;
+        }
+    }
+
+    if (output)
+    {
+        out = fopen(output, "w");
+        if (!out)
+        {
+            perror(output);
+            return 1;
+        }
+    }
+
+    fprintf(out, "{\n  \"freq\": %d,\n  \"wire_time\": %d,\n  \"results\": [\n", TARGET_FREQ, wire_time);
+    for (i = 0; i < nresults; i++)
+    {
+        result_write(out, &results[i], i == nresults - 1);
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    return 0;
+}
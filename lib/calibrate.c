@@ -0,0 +1,132 @@
+/*
+ * calibrate.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+
+#include "calibrate.h"
+
+
+/*
+ * One multiply per color per LED.  The loops work on whole 0x00RRGGBB words
+ * with shifts and masks, so the compiler can vectorize them without having
+ * to deinterleave bytes.
+ */
+
+
+// Scale one color of a packed value by the gain in the same position
+static inline uint32_t scale(uint32_t color, uint32_t gain, int shift)
+{
+    return ((((color >> shift) & 0xff) * (((gain >> shift) & 0xff) + 1)) >> 8) << shift;
+}
+
+/**
+ * Apply calibration gains to an array of colors.
+ *
+ * @param    in     Colors, 0x00RRGGBB.
+ * @param    gains  Gain of each color, 0x00RRGGBB.
+ * @param    out    Calibrated colors, may be the same as in.
+ * @param    count  Number of colors.
+ *
+ * @returns  None
+ */
+void calibrate_apply(const ws2811_led_t *in, const ws2811_led_t *gains, ws2811_led_t *out, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t color = in[i], gain = gains[i];
+
+        out[i] = scale(color, gain, 16) | scale(color, gain, 8) | scale(color, gain, 0);
+    }
+}
+
+/**
+ * Apply calibration gains to one color.
+ *
+ * @param    color  Color, 0x00RRGGBB.
+ * @param    gain   Gain of each color, 0x00RRGGBB.
+ *
+ * @returns  Calibrated color, 0x00RRGGBB.
+ */
+ws2811_led_t calibrate_color(ws2811_led_t color, ws2811_led_t gain)
+{
+    return scale(color, gain, 16) | scale(color, gain, 8) | scale(color, gain, 0);
+}
+
+/**
+ * Compute gains from measured intensities, so every LED matches the dimmest
+ * one of each color.  Measure each LED at full red, green and blue, in any
+ * unit as long as it is the same for all LEDs.
+ *
+ * @param    measured  Red, green and blue intensity of each LED.
+ * @param    gains     Filled with the gain of each LED.
+ * @param    count     Number of LEDs.
+ *
+ * @returns  None
+ */
+void calibrate_normalise(const float (*measured)[3], ws2811_led_t *gains, int count)
+{
+    float dimmest[3];
+    int i, k;
+
+    for (k = 0; k < 3; k++)
+    {
+        dimmest[k] = 0.0f;
+        for (i = 0; i < count; i++)
+        {
+            if ((measured[i][k] > 0.0f) && ((dimmest[k] == 0.0f) || (measured[i][k] < dimmest[k])))
+            {
+                dimmest[k] = measured[i][k];
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        ws2811_led_t gain = 0;
+
+        for (k = 0; k < 3; k++)
+        {
+            int g = 255;
+
+            // LEDs that didn't light up are left alone rather than dimming the rest to nothing
+            if ((measured[i][k] > 0.0f) && (dimmest[k] > 0.0f))
+            {
+                g = (int)(((256.0f * dimmest[k]) / measured[i][k]) - 0.5f);
+                g = (g < 0) ? 0 : ((g > 255) ? 255 : g);
+            }
+
+            gain = (gain << 8) | g;
+        }
+
+        gains[i] = gain;
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ * calibrate.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __CALIBRATE_H__
+#define __CALIBRATE_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+
+
+/*
+ * Per LED calibration for white balance and brightness uniformity.  Each LED
+ * has a gain per color, packed 0x00RRGGBB like the colors themselves, and
+ * each color value is scaled by (gain + 1) / 256, so 255 leaves it unchanged.
+ */
+
+#define CALIBRATE_UNITY                          0xffffff
+
+
+void calibrate_apply(const ws2811_led_t *in, const ws2811_led_t *gains, ws2811_led_t *out, int count);
+ws2811_led_t calibrate_color(ws2811_led_t color, ws2811_led_t gain);
+void calibrate_normalise(const float (*measured)[3], ws2811_led_t *gains, int count);
+
+
+#endif /* __CALIBRATE_H__ */
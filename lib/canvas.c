@@ -0,0 +1,494 @@
+/*
+ * canvas.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "canvas.h"
+
+
+/*
+ * Every blit first clips its destination rectangle to the canvas once, so the
+ * inner loops work on whole rows with no bounds checks.  Opaque rows are a
+ * memcpy, keyed rows a select per pixel which the compiler vectorizes, and
+ * scaling steps through the source with an exact integer quotient and
+ * remainder from the first visible column and row, so clipping never shifts
+ * which source pixel a destination pixel samples.
+ */
+
+typedef struct
+{
+    int x, y;                                    //< First visible canvas pixel
+    int skip_x, skip_y;                          //< Destination pixels clipped off the top left
+    int width, height;                           //< Visible size, zero or less if nothing shows
+} clip_t;
+
+typedef struct
+{
+    int index;                                   //< Source pixel
+    int rem;                                     //< Remainder of the source position, below den
+    int quot, frac, den;                         //< Step per destination pixel is quot + frac / den
+} step_t;
+
+
+static clip_t clip(const canvas_t *canvas, int x, int y, int width, int height)
+{
+    clip_t c;
+
+    c.skip_x = (x < 0) ? -x : 0;
+    c.skip_y = (y < 0) ? -y : 0;
+    c.x = x + c.skip_x;
+    c.y = y + c.skip_y;
+    c.width = width - c.skip_x;
+    c.height = height - c.skip_y;
+
+    if (c.x + c.width > canvas->width)
+    {
+        c.width = canvas->width - c.x;
+    }
+    if (c.y + c.height > canvas->height)
+    {
+        c.height = canvas->height - c.y;
+    }
+
+    return c;
+}
+
+// Source pixel of destination pixel skip out of dst and its successors, sampling
+// at pixel centres: index = ((2 * pixel + 1) * src) / (2 * dst)
+static step_t step_init(int src, int dst, int skip)
+{
+    step_t step;
+    int64_t pos = ((2 * (int64_t)skip) + 1) * src;
+
+    step.den = 2 * dst;
+    step.index = pos / step.den;
+    step.rem = pos % step.den;
+    step.quot = (2 * src) / step.den;
+    step.frac = (2 * src) % step.den;
+
+    return step;
+}
+
+static inline void step_next(step_t *step)
+{
+    step->index += step->quot;
+    step->rem += step->frac;
+    if (step->rem >= step->den)
+    {
+        step->rem -= step->den;
+        step->index++;
+    }
+}
+
+// Copy a row, leaving out the pixels equal to key
+static inline void row_copy(ws2811_led_t *dst, const ws2811_led_t *src, int count, uint32_t key)
+{
+    int i;
+
+    if (key == CANVAS_OPAQUE)
+    {
+        memcpy(dst, src, count * sizeof(*dst));
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        dst[i] = (src[i] == key) ? dst[i] : src[i];
+    }
+}
+
+static void layout_map(canvas_t *canvas, int layout)
+{
+    int x, y;
+
+    for (y = 0; y < canvas->height; y++)
+    {
+        for (x = 0; x < canvas->width; x++)
+        {
+            int *led = &canvas->map[(y * canvas->width) + x];
+
+            switch (layout)
+            {
+                case CANVAS_SERPENTINE:
+                    *led = (y * canvas->width) + ((y & 1) ? (canvas->width - 1 - x) : x);
+                    break;
+
+                case CANVAS_COLUMNS:
+                    *led = (x * canvas->height) + y;
+                    break;
+
+                case CANVAS_COLUMNS_SERPENTINE:
+                    *led = (x * canvas->height) + ((x & 1) ? (canvas->height - 1 - y) : y);
+                    break;
+
+                default:
+                    *led = (y * canvas->width) + x;
+                    break;
+            }
+        }
+    }
+}
+
+// Whether pixel i is LED i throughout, so showing is a single copy
+static int map_identity(const canvas_t *canvas)
+{
+    int i;
+
+    for (i = 0; i < canvas->width * canvas->height; i++)
+    {
+        if (canvas->map[i] != i)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * Allocate a canvas with a pixel map for one of the standard matrix wirings.
+ *
+ * @param    width   Pixels per row.
+ * @param    height  Rows.
+ * @param    layout  CANVAS_ROWS, CANVAS_SERPENTINE, CANVAS_COLUMNS or
+ *                   CANVAS_COLUMNS_SERPENTINE.
+ *
+ * @returns  Cleared canvas, or NULL on bad arguments or allocation failure.
+ */
+canvas_t *canvas_create(int width, int height, int layout)
+{
+    canvas_t *canvas;
+
+    if ((width <= 0) || (height <= 0) || (layout < CANVAS_ROWS) || (layout > CANVAS_COLUMNS_SERPENTINE))
+    {
+        return NULL;
+    }
+
+    canvas = calloc(1, sizeof(*canvas));
+    if (!canvas)
+    {
+        return NULL;
+    }
+
+    canvas->width = width;
+    canvas->height = height;
+    canvas->pixels = calloc(width * height, sizeof(*canvas->pixels));
+    canvas->map = malloc(width * height * sizeof(*canvas->map));
+    if (!canvas->pixels || !canvas->map)
+    {
+        canvas_destroy(canvas);
+        return NULL;
+    }
+
+    layout_map(canvas, layout);
+    canvas->identity = map_identity(canvas);
+
+    return canvas;
+}
+
+/**
+ * Free a canvas.
+ *
+ * @param    canvas  Canvas from canvas_create(), may be NULL.
+ *
+ * @returns  None
+ */
+void canvas_destroy(canvas_t *canvas)
+{
+    if (!canvas)
+    {
+        return;
+    }
+
+    free(canvas->pixels);
+    free(canvas->map);
+    free(canvas);
+}
+
+/**
+ * Replace the pixel map, for matrices that aren't wired in one of the
+ * standard layouts or that have gaps.
+ *
+ * @param    canvas  Canvas.
+ * @param    map     LED index of each pixel in row major order, negative
+ *                   for pixels without an LED.
+ *
+ * @returns  0 on success, -1 on bad arguments.
+ */
+int canvas_map(canvas_t *canvas, const int *map)
+{
+    int i, count = canvas->width * canvas->height;
+
+    if (!map)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        canvas->map[i] = (map[i] < 0) ? CANVAS_NO_LED : map[i];
+    }
+    canvas->identity = map_identity(canvas);
+
+    return 0;
+}
+
+/**
+ * Copy the canvas to the LEDs through the pixel map.  Pixels mapped past
+ * the end of the LED buffer are dropped, and LEDs no pixel maps to are left
+ * as they are.
+ *
+ * @param    canvas  Canvas.
+ * @param    leds    LED buffer, usually a channel's leds.
+ * @param    count   LEDs in the buffer.
+ *
+ * @returns  None
+ */
+void canvas_show(const canvas_t *canvas, ws2811_led_t *leds, int count)
+{
+    int i, pixels = canvas->width * canvas->height;
+
+    if (canvas->identity)
+    {
+        memcpy(leds, canvas->pixels, ((pixels < count) ? pixels : count) * sizeof(*leds));
+        return;
+    }
+
+    for (i = 0; i < pixels; i++)
+    {
+        int led = canvas->map[i];
+
+        if ((led >= 0) && (led < count))
+        {
+            leds[led] = canvas->pixels[i];
+        }
+    }
+}
+
+/**
+ * Set one pixel, ignoring coordinates off the canvas.
+ *
+ * @param    canvas  Canvas.
+ * @param    x       Column.
+ * @param    y       Row.
+ * @param    color   Color.
+ *
+ * @returns  None
+ */
+void canvas_set(canvas_t *canvas, int x, int y, ws2811_led_t color)
+{
+    if ((x >= 0) && (x < canvas->width) && (y >= 0) && (y < canvas->height))
+    {
+        canvas->pixels[(y * canvas->width) + x] = color;
+    }
+}
+
+/**
+ * Read one pixel.
+ *
+ * @param    canvas  Canvas.
+ * @param    x       Column.
+ * @param    y       Row.
+ *
+ * @returns  Color, or 0 for coordinates off the canvas.
+ */
+ws2811_led_t canvas_get(const canvas_t *canvas, int x, int y)
+{
+    if ((x >= 0) && (x < canvas->width) && (y >= 0) && (y < canvas->height))
+    {
+        return canvas->pixels[(y * canvas->width) + x];
+    }
+
+    return 0;
+}
+
+/**
+ * Fill a rectangle with one color, clipped to the canvas.
+ *
+ * @param    canvas  Canvas.
+ * @param    x       Left column.
+ * @param    y       Top row.
+ * @param    width   Columns.
+ * @param    height  Rows.
+ * @param    color   Color.
+ *
+ * @returns  None
+ */
+void canvas_fill(canvas_t *canvas, int x, int y, int width, int height, ws2811_led_t color)
+{
+    clip_t c = clip(canvas, x, y, width, height);
+    int row, i;
+
+    if ((c.width <= 0) || (c.height <= 0))
+    {
+        return;
+    }
+
+    for (row = 0; row < c.height; row++)
+    {
+        ws2811_led_t *dst = &canvas->pixels[((c.y + row) * canvas->width) + c.x];
+
+        for (i = 0; i < c.width; i++)
+        {
+            dst[i] = color;
+        }
+    }
+}
+
+/**
+ * Copy an image onto the canvas at its own size.
+ *
+ * @param    canvas  Canvas.
+ * @param    image   Image.
+ * @param    x       Canvas column of the image's left edge, may be negative.
+ * @param    y       Canvas row of the image's top edge, may be negative.
+ * @param    key     Transparent color, or CANVAS_OPAQUE.
+ *
+ * @returns  None
+ */
+void canvas_blit(canvas_t *canvas, const canvas_image_t *image, int x, int y, uint32_t key)
+{
+    clip_t c = clip(canvas, x, y, image->width, image->height);
+    int row;
+
+    if ((c.width <= 0) || (c.height <= 0))
+    {
+        return;
+    }
+
+    for (row = 0; row < c.height; row++)
+    {
+        row_copy(&canvas->pixels[((c.y + row) * canvas->width) + c.x],
+                 &image->pixels[((c.skip_y + row) * image->stride) + c.skip_x], c.width, key);
+    }
+}
+
+/**
+ * Copy an image onto the canvas stretched or shrunk to a given size, using
+ * the nearest source pixel.
+ *
+ * @param    canvas  Canvas.
+ * @param    image   Image.
+ * @param    x       Canvas column of the left edge, may be negative.
+ * @param    y       Canvas row of the top edge, may be negative.
+ * @param    width   Columns the image covers on the canvas.
+ * @param    height  Rows the image covers on the canvas.
+ * @param    key     Transparent color, or CANVAS_OPAQUE.
+ *
+ * @returns  None
+ */
+void canvas_blit_scaled(canvas_t *canvas, const canvas_image_t *image, int x, int y, int width, int height,
+                        uint32_t key)
+{
+    clip_t c = clip(canvas, x, y, width, height);
+    step_t row_step, col_start;
+    int row, i;
+
+    if ((c.width <= 0) || (c.height <= 0) || (image->width <= 0) || (image->height <= 0))
+    {
+        return;
+    }
+
+    col_start = step_init(image->width, width, c.skip_x);
+    row_step = step_init(image->height, height, c.skip_y);
+
+    for (row = 0; row < c.height; row++, step_next(&row_step))
+    {
+        const ws2811_led_t *src = &image->pixels[row_step.index * image->stride];
+        ws2811_led_t *dst = &canvas->pixels[((c.y + row) * canvas->width) + c.x];
+        step_t col = col_start;
+
+        for (i = 0; i < c.width; i++, step_next(&col))
+        {
+            ws2811_led_t color = src[col.index];
+
+            dst[i] = (color == key) ? dst[i] : color;
+        }
+    }
+}
+
+/**
+ * Fill a rectangle of the canvas with an image repeated in both directions,
+ * starting at an offset into the image.  Moving the offset by one each frame
+ * scrolls the image through the rectangle, a text ticker for instance.
+ *
+ * @param    canvas    Canvas.
+ * @param    image     Image.
+ * @param    x         Canvas column of the left edge, may be negative.
+ * @param    y         Canvas row of the top edge, may be negative.
+ * @param    width     Columns of the rectangle.
+ * @param    height    Rows of the rectangle.
+ * @param    offset_x  Image column at the left edge, any value.
+ * @param    offset_y  Image row at the top edge, any value.
+ * @param    key       Transparent color, or CANVAS_OPAQUE.
+ *
+ * @returns  None
+ */
+void canvas_blit_scroll(canvas_t *canvas, const canvas_image_t *image, int x, int y, int width, int height,
+                        int offset_x, int offset_y, uint32_t key)
+{
+    clip_t c = clip(canvas, x, y, width, height);
+    int row, start_x, start_y;
+
+    if ((c.width <= 0) || (c.height <= 0) || (image->width <= 0) || (image->height <= 0))
+    {
+        return;
+    }
+
+    start_x = (int)(((int64_t)offset_x + c.skip_x) % image->width);
+    start_x += (start_x < 0) ? image->width : 0;
+    start_y = (int)(((int64_t)offset_y + c.skip_y) % image->height);
+    start_y += (start_y < 0) ? image->height : 0;
+
+    for (row = 0; row < c.height; row++)
+    {
+        const ws2811_led_t *src = &image->pixels[((start_y + row) % image->height) * image->stride];
+        ws2811_led_t *dst = &canvas->pixels[((c.y + row) * canvas->width) + c.x];
+        int sx = start_x, done = 0;
+
+        // At most one run to the image's right edge, then whole image rows
+        while (done < c.width)
+        {
+            int run = image->width - sx;
+
+            if (run > c.width - done)
+            {
+                run = c.width - done;
+            }
+
+            row_copy(&dst[done], &src[sx], run, key);
+            done += run;
+            sx = 0;
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * canvas.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __CANVAS_H__
+#define __CANVAS_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+
+
+/*
+ * A 2D canvas for LED matrices.  Drawing goes to a row major buffer of
+ * width * height pixels, and canvas_show() copies it to the LED buffer
+ * through the pixel map, which gives the LED index of every pixel.  Matrices
+ * wired row by row only need one copy, other layouts are scattered.
+ *
+ * Blits copy a rectangular image onto the canvas, clipped to the canvas.
+ * Pixels of the image equal to the key color are left out, CANVAS_OPAQUE
+ * copies all pixels.
+ */
+
+#define CANVAS_ROWS                              0           // Row after row, each left to right
+#define CANVAS_SERPENTINE                        1           // Row after row, every other one right to left
+#define CANVAS_COLUMNS                           2           // Column after column, each top to bottom
+#define CANVAS_COLUMNS_SERPENTINE                3           // Column after column, every other one bottom to top
+
+#define CANVAS_NO_LED                            -1          // Map entry of a pixel without an LED
+#define CANVAS_OPAQUE                            0xffffffff  // Key that never matches a 0x00RRGGBB color
+
+typedef struct
+{
+    int width;
+    int height;
+    ws2811_led_t *pixels;                        //< Row major, width * height
+    int *map;                                    //< LED index of each pixel, CANVAS_NO_LED for none
+    int identity;                                //< Pixel i is LED i for all pixels
+} canvas_t;
+
+typedef struct
+{
+    int width;
+    int height;
+    int stride;                                  //< Pixels from one row to the next
+    const ws2811_led_t *pixels;
+} canvas_image_t;
+
+
+canvas_t *canvas_create(int width, int height, int layout);
+void canvas_destroy(canvas_t *canvas);
+int canvas_map(canvas_t *canvas, const int *map);
+void canvas_show(const canvas_t *canvas, ws2811_led_t *leds, int count);
+void canvas_set(canvas_t *canvas, int x, int y, ws2811_led_t color);
+ws2811_led_t canvas_get(const canvas_t *canvas, int x, int y);
+void canvas_fill(canvas_t *canvas, int x, int y, int width, int height, ws2811_led_t color);
+void canvas_blit(canvas_t *canvas, const canvas_image_t *image, int x, int y, uint32_t key);
+void canvas_blit_scaled(canvas_t *canvas, const canvas_image_t *image, int x, int y, int width, int height,
+                        uint32_t key);
+void canvas_blit_scroll(canvas_t *canvas, const canvas_image_t *image, int x, int y, int width, int height,
+                        int offset_x, int offset_y, uint32_t key);
+
+
+#endif /* __CANVAS_H__ */
@@ -0,0 +1,390 @@
+/*
+ * color.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+
+#include "color.h"
+
+
+/*
+ * Hues are converted to channel levels in 0..HUE_ONE first, then saturation
+ * and value or lightness are applied.  The loops are specialised per hue
+ * mapping at compile time and only use integer math, so the compiler can
+ * vectorize them.
+ */
+
+#define HUE_ONE                                  4096
+
+// A conversion split into tiles
+typedef struct
+{
+    const void *colors;
+    ws2811_led_t *leds;
+    int hues;
+} convert_t;
+
+// Rainbow key colors every eighth of the wheel, from red back to red
+static const int32_t rainbow_r[9] = { 255, 171, 171,   0,   0,   0,  85, 171, 255 };
+static const int32_t rainbow_g[9] = {   0,  85, 170, 255, 171,   0,   0,   0,   0 };
+static const int32_t rainbow_b[9] = {   0,   0,   0,   0,  85, 255, 171,  85,   0 };
+
+
+// Key color level of a rainbow sector, as selects rather than a lookup so it vectorizes without gathers
+static inline int32_t rainbow_key(uint32_t sector, const int32_t *keys)
+{
+    int32_t level = keys[0];
+    uint32_t k;
+
+    for (k = 1; k < 9; k++)
+    {
+        level = (sector == k) ? keys[k] : level;
+    }
+
+    return level;
+}
+
+static inline int32_t clamp_hue(int32_t x)
+{
+    return (x < 0) ? 0 : ((x > HUE_ONE) ? HUE_ONE : x);
+}
+
+static inline int32_t abs32(int32_t x)
+{
+    return (x < 0) ? -x : x;
+}
+
+/**
+ * Channel levels of a fully saturated hue.
+ *
+ * @param    h     Hue, 16 bit turn fraction.
+ * @param    hues  COLOR_SPECTRUM or COLOR_RAINBOW, a constant so callers get specialised.
+ * @param    r     Red level, 0..HUE_ONE.
+ * @param    g     Green level.
+ * @param    b     Blue level.
+ *
+ * @returns  None
+ */
+static inline void hue(uint32_t h, const int hues, int32_t *r, int32_t *g, int32_t *b)
+{
+    if (hues == COLOR_RAINBOW)
+    {
+        uint32_t sector = (h >> 13) & 7, f = h & 0x1fff;
+        int32_t r0 = rainbow_key(sector, rainbow_r), r1 = rainbow_key(sector + 1, rainbow_r);
+        int32_t g0 = rainbow_key(sector, rainbow_g), g1 = rainbow_key(sector + 1, rainbow_g);
+        int32_t b0 = rainbow_key(sector, rainbow_b), b1 = rainbow_key(sector + 1, rainbow_b);
+        int32_t lr = (r0 << 13) + ((r1 - r0) * (int32_t)f);
+        int32_t lg = (g0 << 13) + ((g1 - g0) * (int32_t)f);
+        int32_t lb = (b0 << 13) + ((b1 - b0) * (int32_t)f);
+
+        // 0..255 << 13 to 0..HUE_ONE
+        *r = (lr >> 9) + (lr >> 17);
+        *g = (lg >> 9) + (lg >> 17);
+        *b = (lb >> 9) + (lb >> 17);
+    }
+    else
+    {
+        int32_t h6 = ((h & 0xffff) * 6) >> 4;
+
+        *r = clamp_hue(abs32(h6 - (3 * HUE_ONE)) - HUE_ONE);
+        *g = clamp_hue((2 * HUE_ONE) - abs32(h6 - (2 * HUE_ONE)));
+        *b = clamp_hue((2 * HUE_ONE) - abs32(h6 - (4 * HUE_ONE)));
+    }
+}
+
+// Apply 8 bit saturation and value to a hue level, giving 0..255
+static inline uint32_t sv8(uint32_t level, uint32_t s, uint32_t v)
+{
+    uint32_t x = (255 * HUE_ONE) - (s * (HUE_ONE - level));
+    uint32_t y = ((v * x) >> 12) + 128;
+
+    // y / 255, rounded, without a division
+    return (y + (y >> 8)) >> 8;
+}
+
+// Apply 16 bit saturation and value to a hue level, giving 0..255
+static inline uint32_t sv16(uint32_t level, uint32_t s, uint32_t v)
+{
+    uint32_t x = 0xffff - ((s * (HUE_ONE - level)) >> 12);
+
+    return (v * x) >> 24;
+}
+
+// Apply 8 bit saturation and lightness to a hue level, giving 0..255
+static inline uint32_t sl8(int32_t level, int32_t s, int32_t l)
+{
+    int32_t chroma = (((255 - abs32((2 * l) - 255)) * s) + 127) / 255;
+    int32_t x = l + ((chroma * ((2 * level) - HUE_ONE)) >> 13);
+
+    return (x < 0) ? 0 : ((x > 255) ? 255 : x);
+}
+
+static inline void hsv8_rgb(const color_hsv8_t *hsv, ws2811_led_t *leds, int count, const int hues)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t s = hsv[i].s, v = hsv[i].v;
+        int32_t r, g, b;
+
+        hue(hsv[i].h << 8, hues, &r, &g, &b);
+        leds[i] = (sv8(r, s, v) << 16) | (sv8(g, s, v) << 8) | sv8(b, s, v);
+    }
+}
+
+static inline void hsv8_planar(const color_hsv8_t *hsv, uint8_t *pr, uint8_t *pg, uint8_t *pb,
+                               int count, const int hues)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t s = hsv[i].s, v = hsv[i].v;
+        int32_t r, g, b;
+
+        hue(hsv[i].h << 8, hues, &r, &g, &b);
+        pr[i] = sv8(r, s, v);
+        pg[i] = sv8(g, s, v);
+        pb[i] = sv8(b, s, v);
+    }
+}
+
+static inline void hsv16_rgb(const color_hsv16_t *hsv, ws2811_led_t *leds, int count, const int hues)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t s = hsv[i].s, v = hsv[i].v;
+        int32_t r, g, b;
+
+        hue(hsv[i].h, hues, &r, &g, &b);
+        leds[i] = (sv16(r, s, v) << 16) | (sv16(g, s, v) << 8) | sv16(b, s, v);
+    }
+}
+
+static inline void hsl8_rgb(const color_hsl8_t *hsl, ws2811_led_t *leds, int count, const int hues)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        int32_t s = hsl[i].s, l = hsl[i].l;
+        int32_t r, g, b;
+
+        hue(hsl[i].h << 8, hues, &r, &g, &b);
+        leds[i] = (sl8(r, s, l) << 16) | (sl8(g, s, l) << 8) | sl8(b, s, l);
+    }
+}
+
+/**
+ * Convert one 8 bit HSV color.
+ *
+ * @param    h     Hue.
+ * @param    s     Saturation.
+ * @param    v     Value.
+ * @param    hues  COLOR_SPECTRUM or COLOR_RAINBOW.
+ *
+ * @returns  Color.
+ */
+ws2811_led_t color_hsv8(uint8_t h, uint8_t s, uint8_t v, int hues)
+{
+    color_hsv8_t hsv = { h, s, v };
+    ws2811_led_t led;
+
+    color_hsv8_rgb(&hsv, &led, 1, hues);
+
+    return led;
+}
+
+/**
+ * Convert 8 bit HSV colors into LEDs.
+ *
+ * @param    hsv    Colors.
+ * @param    leds   LEDs.
+ * @param    count  Number of colors.
+ * @param    hues   COLOR_SPECTRUM or COLOR_RAINBOW.
+ *
+ * @returns  None
+ */
+void color_hsv8_rgb(const color_hsv8_t *hsv, ws2811_led_t *leds, int count, int hues)
+{
+    if (hues == COLOR_RAINBOW)
+    {
+        hsv8_rgb(hsv, leds, count, COLOR_RAINBOW);
+    }
+    else
+    {
+        hsv8_rgb(hsv, leds, count, COLOR_SPECTRUM);
+    }
+}
+
+/**
+ * Convert 8 bit HSV colors into separate red, green and blue buffers.
+ *
+ * @param    hsv    Colors.
+ * @param    r      Red levels.
+ * @param    g      Green levels.
+ * @param    b      Blue levels.
+ * @param    count  Number of colors.
+ * @param    hues   COLOR_SPECTRUM or COLOR_RAINBOW.
+ *
+ * @returns  None
+ */
+void color_hsv8_planar(const color_hsv8_t *hsv, uint8_t *r, uint8_t *g, uint8_t *b, int count, int hues)
+{
+    if (hues == COLOR_RAINBOW)
+    {
+        hsv8_planar(hsv, r, g, b, count, COLOR_RAINBOW);
+    }
+    else
+    {
+        hsv8_planar(hsv, r, g, b, count, COLOR_SPECTRUM);
+    }
+}
+
+/**
+ * Convert 16 bit HSV colors into LEDs.
+ *
+ * @param    hsv    Colors.
+ * @param    leds   LEDs.
+ * @param    count  Number of colors.
+ * @param    hues   COLOR_SPECTRUM or COLOR_RAINBOW.
+ *
+ * @returns  None
+ */
+void color_hsv16_rgb(const color_hsv16_t *hsv, ws2811_led_t *leds, int count, int hues)
+{
+    if (hues == COLOR_RAINBOW)
+    {
+        hsv16_rgb(hsv, leds, count, COLOR_RAINBOW);
+    }
+    else
+    {
+        hsv16_rgb(hsv, leds, count, COLOR_SPECTRUM);
+    }
+}
+
+/**
+ * Convert 8 bit HSL colors into LEDs.
+ *
+ * @param    hsl    Colors.
+ * @param    leds   LEDs.
+ * @param    count  Number of colors.
+ * @param    hues   COLOR_SPECTRUM or COLOR_RAINBOW.
+ *
+ * @returns  None
+ */
+void color_hsl8_rgb(const color_hsl8_t *hsl, ws2811_led_t *leds, int count, int hues)
+{
+    if (hues == COLOR_RAINBOW)
+    {
+        hsl8_rgb(hsl, leds, count, COLOR_RAINBOW);
+    }
+    else
+    {
+        hsl8_rgb(hsl, leds, count, COLOR_SPECTRUM);
+    }
+}
+
+static void hsv8_tile(void *arg, int first, int n, int worker)
+{
+    const convert_t *convert = arg;
+
+    color_hsv8_rgb((const color_hsv8_t *)convert->colors + first, &convert->leds[first], n, convert->hues);
+}
+
+static void hsv16_tile(void *arg, int first, int n, int worker)
+{
+    const convert_t *convert = arg;
+
+    color_hsv16_rgb((const color_hsv16_t *)convert->colors + first, &convert->leds[first], n, convert->hues);
+}
+
+static void hsl8_tile(void *arg, int first, int n, int worker)
+{
+    const convert_t *convert = arg;
+
+    color_hsl8_rgb((const color_hsl8_t *)convert->colors + first, &convert->leds[first], n, convert->hues);
+}
+
+/**
+ * Convert 8 bit HSV colors into LEDs on the cores of a pool.
+ *
+ * @param    tasks  Pool, NULL for the calling thread.
+ * @param    hsv    Colors.
+ * @param    leds   LEDs.
+ * @param    count  Number of colors.
+ * @param    hues   COLOR_SPECTRUM or COLOR_RAINBOW.
+ *
+ * @returns  None
+ */
+void color_hsv8_rgb_tasks(tasks_t *tasks, const color_hsv8_t *hsv, ws2811_led_t *leds, int count, int hues)
+{
+    convert_t convert = { .colors = hsv, .leds = leds, .hues = hues };
+
+    tasks_run(tasks, hsv8_tile, &convert, count, tasks_grain(sizeof(*hsv) + sizeof(*leds), 64));
+}
+
+/**
+ * Convert 16 bit HSV colors into LEDs on the cores of a pool.
+ *
+ * @param    tasks  Pool, NULL for the calling thread.
+ * @param    hsv    Colors.
+ * @param    leds   LEDs.
+ * @param    count  Number of colors.
+ * @param    hues   COLOR_SPECTRUM or COLOR_RAINBOW.
+ *
+ * @returns  None
+ */
+void color_hsv16_rgb_tasks(tasks_t *tasks, const color_hsv16_t *hsv, ws2811_led_t *leds, int count, int hues)
+{
+    convert_t convert = { .colors = hsv, .leds = leds, .hues = hues };
+
+    tasks_run(tasks, hsv16_tile, &convert, count, tasks_grain(sizeof(*hsv) + sizeof(*leds), 64));
+}
+
+/**
+ * Convert 8 bit HSL colors into LEDs on the cores of a pool.
+ *
+ * @param    tasks  Pool, NULL for the calling thread.
+ * @param    hsl    Colors.
+ * @param    leds   LEDs.
+ * @param    count  Number of colors.
+ * @param    hues   COLOR_SPECTRUM or COLOR_RAINBOW.
+ *
+ * @returns  None
+ */
+void color_hsl8_rgb_tasks(tasks_t *tasks, const color_hsl8_t *hsl, ws2811_led_t *leds, int count, int hues)
+{
+    convert_t convert = { .colors = hsl, .leds = leds, .hues = hues };
+
+    tasks_run(tasks, hsl8_tile, &convert, count, tasks_grain(sizeof(*hsl) + sizeof(*leds), 64));
+}
@@ -0,0 +1,86 @@
+/*
+ * color.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __COLOR_H__
+#define __COLOR_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+#include "tasks.h"
+
+
+/*
+ * Batch HSV and HSL to RGB conversion into LED buffers or planar buffers.
+ *
+ * Hues go once around the color wheel over the full range of the hue value.
+ * COLOR_SPECTRUM has six equal sectors between red, yellow, green, cyan, blue
+ * and magenta.  COLOR_RAINBOW gives more room to orange and yellow and less
+ * to cyan, which looks more even on LEDs.
+ *
+ * The _tasks versions convert in tiles on the cores of a pool.
+ */
+
+#define COLOR_SPECTRUM                           0
+#define COLOR_RAINBOW                            1
+
+typedef struct
+{
+    uint8_t h;
+    uint8_t s;
+    uint8_t v;
+} color_hsv8_t;
+
+typedef struct
+{
+    uint16_t h;
+    uint16_t s;
+    uint16_t v;
+} color_hsv16_t;
+
+typedef struct
+{
+    uint8_t h;
+    uint8_t s;
+    uint8_t l;
+} color_hsl8_t;
+
+
+ws2811_led_t color_hsv8(uint8_t h, uint8_t s, uint8_t v, int hues);
+void color_hsv8_rgb(const color_hsv8_t *hsv, ws2811_led_t *leds, int count, int hues);
+void color_hsv8_planar(const color_hsv8_t *hsv, uint8_t *r, uint8_t *g, uint8_t *b, int count, int hues);
+void color_hsv16_rgb(const color_hsv16_t *hsv, ws2811_led_t *leds, int count, int hues);
+void color_hsl8_rgb(const color_hsl8_t *hsl, ws2811_led_t *leds, int count, int hues);
+void color_hsv8_rgb_tasks(tasks_t *tasks, const color_hsv8_t *hsv, ws2811_led_t *leds, int count, int hues);
+void color_hsv16_rgb_tasks(tasks_t *tasks, const color_hsv16_t *hsv, ws2811_led_t *leds, int count, int hues);
+void color_hsl8_rgb_tasks(tasks_t *tasks, const color_hsl8_t *hsl, ws2811_led_t *leds, int count, int hues);
+
+
+#endif /* __COLOR_H__ */
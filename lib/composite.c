@@ -0,0 +1,467 @@
+/*
+ * composite.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "composite.h"
+
+
+/*
+ * The blend loops are specialised per mode at compile time and only use
+ * branch free integer math, so the compiler can vectorize them.
+ */
+
+// x / 255, rounded, exact for x <= 255 * 255
+static inline uint32_t div255(uint32_t x)
+{
+    x += 128;
+
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t blend_channel(uint32_t below, uint32_t above, const int mode)
+{
+    uint32_t sum;
+
+    switch (mode)
+    {
+        case COMPOSITE_ADD:
+            sum = below + above;
+            return (sum > 255) ? 255 : sum;
+        case COMPOSITE_MULTIPLY:
+            return div255(below * above);
+        case COMPOSITE_SCREEN:
+            return 255 - div255((255 - below) * (255 - above));
+        case COMPOSITE_MAX:
+            return (below > above) ? below : above;
+        default:
+            return above;
+    }
+}
+
+/**
+ * Blend a range of a layer onto the LEDs.
+ *
+ * @param    leds     LEDs, holding the layers below.
+ * @param    pixels   Layer pixels.
+ * @param    count    Number of pixels.
+ * @param    opacity  Layer opacity, 0-255.
+ * @param    mode     COMPOSITE_xxx, a constant so the loop gets specialised.
+ *
+ * @returns  None
+ */
+static inline void blend(ws2811_led_t *leds, const uint32_t *pixels, int count, uint32_t opacity,
+                         const int mode)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t above = pixels[i], below = leds[i];
+        uint32_t alpha = div255((above >> 24) * opacity);
+        uint32_t r = (below >> 16) & 0xff, g = (below >> 8) & 0xff, b = below & 0xff;
+
+        r = div255((r * (255 - alpha)) + (blend_channel(r, (above >> 16) & 0xff, mode) * alpha));
+        g = div255((g * (255 - alpha)) + (blend_channel(g, (above >> 8) & 0xff, mode) * alpha));
+        b = div255((b * (255 - alpha)) + (blend_channel(b, above & 0xff, mode) * alpha));
+
+        leds[i] = (r << 16) | (g << 8) | b;
+    }
+}
+
+static void blend_normal(ws2811_led_t *leds, const uint32_t *pixels, int count, uint32_t opacity)
+{
+    blend(leds, pixels, count, opacity, COMPOSITE_NORMAL);
+}
+
+static void blend_add(ws2811_led_t *leds, const uint32_t *pixels, int count, uint32_t opacity)
+{
+    blend(leds, pixels, count, opacity, COMPOSITE_ADD);
+}
+
+static void blend_multiply(ws2811_led_t *leds, const uint32_t *pixels, int count, uint32_t opacity)
+{
+    blend(leds, pixels, count, opacity, COMPOSITE_MULTIPLY);
+}
+
+static void blend_screen(ws2811_led_t *leds, const uint32_t *pixels, int count, uint32_t opacity)
+{
+    blend(leds, pixels, count, opacity, COMPOSITE_SCREEN);
+}
+
+static void blend_max(ws2811_led_t *leds, const uint32_t *pixels, int count, uint32_t opacity)
+{
+    blend(leds, pixels, count, opacity, COMPOSITE_MAX);
+}
+
+static void (* const blend_modes[COMPOSITE_MODES])(ws2811_led_t *leds, const uint32_t *pixels,
+                                                    int count, uint32_t opacity) =
+{
+    [COMPOSITE_NORMAL] = blend_normal,
+    [COMPOSITE_ADD] = blend_add,
+    [COMPOSITE_MULTIPLY] = blend_multiply,
+    [COMPOSITE_SCREEN] = blend_screen,
+    [COMPOSITE_MAX] = blend_max,
+};
+
+// The range composite_flatten() blends, for the tile function
+typedef struct
+{
+    const composite_t *composite;
+    ws2811_led_t *leds;                          // LED buffer from start
+    int start;
+} flatten_t;
+
+/**
+ * Create a compositor.  All layers start fully transparent in normal mode at
+ * full opacity.
+ *
+ * @param    count   Pixels per layer, usually the channel LED count.
+ * @param    layers  Number of layers.
+ *
+ * @returns  Compositor, NULL if out of memory.
+ */
+composite_t *composite_create(int count, int layers)
+{
+    composite_t *composite;
+    int i;
+
+    if ((count < 0) || (layers <= 0))
+    {
+        return NULL;
+    }
+
+    composite = calloc(1, sizeof(*composite));
+    if (!composite)
+    {
+        return NULL;
+    }
+
+    composite->count = count;
+    composite->layers = layers;
+    composite->layer = calloc(layers, sizeof(*composite->layer));
+    if (!composite->layer)
+    {
+        free(composite);
+        return NULL;
+    }
+
+    for (i = 0; i < layers; i++)
+    {
+        composite_layer_t *layer = &composite->layer[i];
+
+        layer->pixels = calloc(count ? count : 1, sizeof(*layer->pixels));
+        if (!layer->pixels)
+        {
+            composite_destroy(composite);
+            return NULL;
+        }
+
+        layer->mode = COMPOSITE_NORMAL;
+        layer->opacity = 255;
+        layer->transparent = 1;
+    }
+
+    // The first flatten clears the LEDs
+    composite->dirty_end = count;
+
+    return composite;
+}
+
+void composite_destroy(composite_t *composite)
+{
+    int i;
+
+    if (!composite)
+    {
+        return;
+    }
+
+    for (i = 0; i < composite->layers; i++)
+    {
+        free(composite->layer[i].pixels);
+    }
+    free(composite->layer);
+    free(composite);
+}
+
+/**
+ * Pixels of a layer, to be written directly.  Call composite_dirty() after
+ * writing them.
+ *
+ * @param    composite  Compositor.
+ * @param    layer      Layer index, 0 at the bottom.
+ *
+ * @returns  Pixel buffer, NULL for a bad layer index.
+ */
+uint32_t *composite_pixels(composite_t *composite, int layer)
+{
+    if ((layer < 0) || (layer >= composite->layers))
+    {
+        return NULL;
+    }
+
+    return composite->layer[layer].pixels;
+}
+
+/**
+ * Mark a range of a layer as changed.
+ *
+ * @param    composite  Compositor.
+ * @param    layer      Layer index.
+ * @param    start      First pixel changed.
+ * @param    count      Number of pixels changed.
+ *
+ * @returns  None
+ */
+void composite_dirty(composite_t *composite, int layer, int start, int count)
+{
+    composite_layer_t *l;
+    int end = start + count;
+
+    if ((layer < 0) || (layer >= composite->layers))
+    {
+        return;
+    }
+    l = &composite->layer[layer];
+
+    start = (start < 0) ? 0 : start;
+    end = (end > composite->count) ? composite->count : end;
+    if (start >= end)
+    {
+        return;
+    }
+
+    if (l->dirty_start >= l->dirty_end)
+    {
+        l->dirty_start = start;
+        l->dirty_end = end;
+    }
+    else
+    {
+        l->dirty_start = (start < l->dirty_start) ? start : l->dirty_start;
+        l->dirty_end = (end > l->dirty_end) ? end : l->dirty_end;
+    }
+}
+
+/**
+ * Set the blend mode and opacity of a layer.
+ *
+ * @param    composite  Compositor.
+ * @param    layer      Layer index.
+ * @param    mode       COMPOSITE_xxx.
+ * @param    opacity    0-255, 0 hides the layer.
+ *
+ * @returns  0 on success, -1 for a bad layer or mode.
+ */
+int composite_set(composite_t *composite, int layer, int mode, int opacity)
+{
+    composite_layer_t *l;
+
+    if ((layer < 0) || (layer >= composite->layers) || (mode < 0) || (mode >= COMPOSITE_MODES))
+    {
+        return -1;
+    }
+    l = &composite->layer[layer];
+
+    opacity = (opacity < 0) ? 0 : ((opacity > 255) ? 255 : opacity);
+    if ((l->mode != mode) || (l->opacity != opacity))
+    {
+        l->mode = mode;
+        l->opacity = opacity;
+        if (!l->transparent)
+        {
+            composite->dirty_start = 0;
+            composite->dirty_end = composite->count;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Fill a range of a layer with one color.
+ *
+ * @param    composite  Compositor.
+ * @param    layer      Layer index.
+ * @param    start      First pixel.
+ * @param    count      Number of pixels.
+ * @param    argb       0xAARRGGBB, alpha 0 clears the range.
+ *
+ * @returns  None
+ */
+void composite_fill(composite_t *composite, int layer, int start, int count, uint32_t argb)
+{
+    uint32_t *pixels = composite_pixels(composite, layer);
+    int end = start + count;
+    int i;
+
+    if (!pixels)
+    {
+        return;
+    }
+
+    start = (start < 0) ? 0 : start;
+    end = (end > composite->count) ? composite->count : end;
+    for (i = start; i < end; i++)
+    {
+        pixels[i] = argb;
+    }
+
+    composite_dirty(composite, layer, start, end - start);
+}
+
+/**
+ * Check whether a layer is still fully transparent after a change.  The
+ * layer keeps the range from its first to its last pixel with alpha, so
+ * only the changed range is scanned, plus any pixels at the ends of the
+ * range that a change made transparent.
+ *
+ * @param    l  Changed layer.
+ *
+ * @returns  None
+ */
+static void layer_transparency(composite_layer_t *l)
+{
+    const uint32_t *pixels = l->pixels;
+    int start = l->alpha_start, end = l->alpha_end;
+    int i;
+
+    for (i = l->dirty_start; i < l->dirty_end; i++)
+    {
+        if (pixels[i] >> 24)
+        {
+            start = ((start < end) && (start < i)) ? start : i;
+            break;
+        }
+    }
+    for (i = l->dirty_end - 1; i >= l->dirty_start; i--)
+    {
+        if (pixels[i] >> 24)
+        {
+            end = ((start < end) && (end > i + 1)) ? end : i + 1;
+            break;
+        }
+    }
+
+    // The ends may have been cleared
+    while ((start < end) && !(pixels[start] >> 24))
+    {
+        start++;
+    }
+    while ((start < end) && !(pixels[end - 1] >> 24))
+    {
+        end--;
+    }
+
+    l->alpha_start = start;
+    l->alpha_end = end;
+    l->transparent = (start >= end);
+}
+
+// Blend LEDs first to first + n - 1 of the flattened range through all layers
+static void flatten_tile(void *arg, int first, int n, int worker)
+{
+    const flatten_t *flatten = arg;
+    const composite_t *composite = flatten->composite;
+    ws2811_led_t *leds = &flatten->leds[first];
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        leds[i] = 0;
+    }
+
+    for (i = 0; i < composite->layers; i++)
+    {
+        const composite_layer_t *l = &composite->layer[i];
+
+        if (l->opacity && !l->transparent)
+        {
+            blend_modes[l->mode](leds, &l->pixels[flatten->start + first], n, l->opacity);
+        }
+    }
+}
+
+/**
+ * Flatten the layers into the LEDs.  Only the range changed since the
+ * previous call is blended, transparent and zero opacity layers are skipped.
+ *
+ * @param    composite  Compositor.
+ * @param    leds       LEDs, composite->count of them.
+ *
+ * @returns  1 if the LEDs changed, 0 if nothing changed.
+ */
+int composite_flatten(composite_t *composite, ws2811_led_t *leds)
+{
+    int start = composite->dirty_start, end = composite->dirty_end;
+    int i;
+
+    if (start >= end)
+    {
+        start = composite->count;
+        end = 0;
+    }
+    composite->dirty_start = composite->dirty_end = 0;
+
+    for (i = 0; i < composite->layers; i++)
+    {
+        composite_layer_t *l = &composite->layer[i];
+
+        if (l->dirty_start < l->dirty_end)
+        {
+            int was_transparent = l->transparent;
+
+            layer_transparency(l);
+
+            // Changes to hidden layers, or leaving a layer transparent, don't show
+            if (l->opacity && !(was_transparent && l->transparent))
+            {
+                start = (l->dirty_start < start) ? l->dirty_start : start;
+                end = (l->dirty_end > end) ? l->dirty_end : end;
+            }
+
+            l->dirty_start = l->dirty_end = 0;
+        }
+    }
+
+    if (start >= end)
+    {
+        return 0;
+    }
+
+    flatten_t flatten = { .composite = composite, .leds = &leds[start], .start = start };
+
+    tasks_run(composite->tasks, flatten_tile, &flatten, end - start,
+              tasks_grain(sizeof(uint32_t) * (composite->layers + 1), 64));
+
+    return 1;
+}
@@ -0,0 +1,93 @@
+/*
+ * composite.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __COMPOSITE_H__
+#define __COMPOSITE_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+#include "tasks.h"
+
+
+/*
+ * Layer compositor.  Layers are 0xAARRGGBB buffers, stacked from layer 0 at
+ * the bottom on a black background, and flattened into an LED buffer.
+ *
+ * Layers are tracked for changes: after writing a layer's pixels directly,
+ * call composite_dirty() for the range written.  composite_flatten() only
+ * blends the range changed since the previous call, and leaves the LED
+ * buffer alone if nothing changed, so the LED buffer must not be written by
+ * anything else in between.
+ *
+ * With a pool in tasks the changed range is blended in tiles on all cores,
+ * each tile through all layers while it's in cache.
+ */
+
+#define COMPOSITE_NORMAL                         0          // Alpha blend
+#define COMPOSITE_ADD                            1          // Sum, saturating
+#define COMPOSITE_MULTIPLY                       2          // Darkens
+#define COMPOSITE_SCREEN                         3          // Lightens
+#define COMPOSITE_MAX                            4          // Brightest of both
+#define COMPOSITE_MODES                          5
+
+typedef struct
+{
+    uint32_t *pixels;                            //< 0xAARRGGBB
+    int mode;                                    //< COMPOSITE_xxx
+    int opacity;                                 //< 0-255, applied on top of the pixel alpha
+    int transparent;                             //< All pixels have alpha 0
+    int alpha_start;                             //< First and one past the last pixel with alpha,
+    int alpha_end;                               //< empty if transparent
+    int dirty_start;                             //< Changed range, empty if start >= end
+    int dirty_end;
+} composite_layer_t;
+
+typedef struct
+{
+    int count;                                   //< Pixels per layer
+    int layers;
+    composite_layer_t *layer;
+    int dirty_start;                             //< Range to redraw for mode and opacity changes
+    int dirty_end;
+    tasks_t *tasks;                              //< Pool to blend on, NULL for the calling thread
+} composite_t;
+
+
+composite_t *composite_create(int count, int layers);
+void composite_destroy(composite_t *composite);
+uint32_t *composite_pixels(composite_t *composite, int layer);
+int composite_set(composite_t *composite, int layer, int mode, int opacity);
+void composite_dirty(composite_t *composite, int layer, int start, int count);
+void composite_fill(composite_t *composite, int layer, int start, int count, uint32_t argb);
+int composite_flatten(composite_t *composite, ws2811_led_t *leds);
+
+
+#endif /* __COMPOSITE_H__ */
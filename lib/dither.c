@@ -0,0 +1,358 @@
+/*
+ * dither.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dither.h"
+
+
+/*
+ * The encoder shows color value v at wire level gamma[(v * scale) >> 8],
+ * scale being the brightness plus one.  A 16 bit color sits between two
+ * color values, so its wire level in 8.8 fixed point is interpolated from
+ * the levels of those, taken between gamma entries so the brightness
+ * scaling doesn't round it away.  Only some wire levels can be shown, the
+ * dither picks the shown level below or above and the color value giving
+ * it.  All of it is table lookups and small integer multiplies.
+ */
+
+static const uint8_t bayer[8][8] =
+{
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+static const ws2811_gamma_t gamma_linear =
+{
+    .curve = WS2811_GAMMA_POWER,
+    .exponent = { 1.0f, 1.0f, 1.0f },
+};
+
+
+static void levels_build(dither_levels_t *levels, const uint8_t gamma[256], int brightness)
+{
+    int scale = brightness + 1;
+    uint8_t shown[256] = { 0 };
+    int value, level, last;
+
+    for (value = 255; value >= 0; value--)
+    {
+        level = gamma[(value * scale) >> 8];
+        shown[level] = 1;
+        levels->input[level] = value;                  // Lowest value giving the level
+    }
+
+    for (level = 0; !shown[level]; level++)
+        ;
+    levels->lowest = level;
+    for (level = 255; !shown[level]; level--)
+        ;
+    levels->highest = level;
+
+    last = levels->lowest;
+    for (level = 0; level < 256; level++)
+    {
+        if (shown[level])
+        {
+            last = level;
+        }
+        levels->down[level] = last;
+    }
+
+    last = levels->highest;
+    for (level = 255; level >= 0; level--)
+    {
+        levels->next[level] = last;
+        if (shown[level])
+        {
+            last = level;
+        }
+    }
+
+    for (value = 0; value < 256; value++)
+    {
+        int pos = value * scale, index = pos >> 8, frac = pos & 0xff;
+        int below = gamma[index], above = gamma[(index < 255) ? (index + 1) : 255];
+
+        levels->target[value] = ((below * (256 - frac)) + (above * frac));
+    }
+    levels->target[256] = levels->target[255];
+}
+
+// Wire level of a 16 bit color in 8.8, clamped to the levels shown
+static inline uint32_t wire_level(const dither_levels_t *levels, uint32_t color)
+{
+    uint32_t pos = ((color * 65281) + 32768) >> 16;   // 8.8 color value, 65535 is 255.0
+    uint32_t index = pos >> 8, frac = pos & 0xff;
+    uint32_t level = ((levels->target[index] * (256 - frac)) + (levels->target[index + 1] * frac)) >> 8;
+
+    if (level < (levels->lowest << 8u))
+    {
+        return levels->lowest << 8;
+    }
+    if (level > (levels->highest << 8u))
+    {
+        return levels->highest << 8;
+    }
+    return level;
+}
+
+// Color value for the level below or above, by a threshold between 0 and 255
+static inline uint8_t ordered(const dither_levels_t *levels, uint32_t level, uint32_t threshold)
+{
+    uint32_t lo = levels->down[level >> 8], hi = levels->next[lo];
+
+    return levels->input[((level - (lo << 8)) > (threshold * (hi - lo))) ? hi : lo];
+}
+
+// Color value for the nearest level, with the error left over in *error
+static inline uint8_t nearest(const dither_levels_t *levels, int32_t level, int32_t *error)
+{
+    int32_t lo, hi, shown;
+
+    if (level < (levels->lowest << 8))
+    {
+        level = levels->lowest << 8;
+    }
+    else if (level > (levels->highest << 8))
+    {
+        level = levels->highest << 8;
+    }
+
+    lo = levels->down[level >> 8];
+    hi = levels->next[lo];
+    shown = (((level - (lo << 8)) * 2) >= ((hi - lo) << 8)) ? hi : lo;
+    *error = level - (shown << 8);
+
+    return levels->input[shown];
+}
+
+static void run_ordered(dither_t *dither, const uint16_t *src, ws2811_led_t *out)
+{
+    const dither_levels_t *levels = dither->levels;
+    int x, y;
+
+    for (y = 0; y < dither->height; y++)
+    {
+        const uint8_t *row = bayer[y & 7];
+
+        for (x = 0; x < dither->width; x++)
+        {
+            uint32_t threshold = (row[x & 7] * 4) + 2;
+
+            *out++ = (ordered(&levels[0], wire_level(&levels[0], src[0]), threshold) << 16) |
+                     (ordered(&levels[1], wire_level(&levels[1], src[1]), threshold) << 8) |
+                     ordered(&levels[2], wire_level(&levels[2], src[2]), threshold);
+            src += 3;
+        }
+    }
+}
+
+/*
+ * Error rows have a spare pixel at each end so the neighbours of the edge
+ * pixels need no checks.  Even rows run left to right, odd rows right to
+ * left.
+ */
+static void run_diffusion(dither_t *dither, const uint16_t *src, ws2811_led_t *out)
+{
+    const dither_levels_t *levels = dither->levels;
+    int width = dither->width, row_size = (width + 2) * 3;
+    int32_t *cur = dither->error, *next = &dither->error[row_size];
+    int x, y, n, c;
+
+    memset(cur, 0, row_size * sizeof(*cur));
+
+    for (y = 0; y < dither->height; y++)
+    {
+        int step = (y & 1) ? -1 : 1;
+        int32_t *swap;
+
+        memset(next, 0, row_size * sizeof(*next));
+
+        for (n = 0; n < width; n++)
+        {
+            x = (y & 1) ? (width - 1 - n) : n;
+
+            const uint16_t *in = &src[((y * width) + x) * 3];
+            int32_t *here = &cur[(x + 1) * 3], *below = &next[(x + 1) * 3];
+            uint8_t color[3];
+
+            for (c = 0; c < 3; c++)
+            {
+                int32_t error;
+
+                color[c] = nearest(&levels[c], (int32_t)wire_level(&levels[c], in[c]) + here[c], &error);
+
+                int32_t e7 = (error * 7) / 16, e3 = (error * 3) / 16, e5 = (error * 5) / 16;
+
+                here[(step * 3) + c] += e7;
+                below[(-step * 3) + c] += e3;
+                below[c] += e5;
+                below[(step * 3) + c] += error - e7 - e3 - e5;
+            }
+
+            out[(y * width) + x] = (color[0] << 16) | (color[1] << 8) | color[2];
+        }
+
+        swap = cur;
+        cur = next;
+        next = swap;
+    }
+}
+
+
+/**
+ * Allocate a dither for a canvas size.  It starts out mapping 16 bit colors
+ * straight to 8 bits, call dither_update() to follow a channel's gamma and
+ * brightness.
+ *
+ * @param    width   Canvas width.
+ * @param    height  Canvas height.
+ * @param    mode    DITHER_ORDERED or DITHER_DIFFUSION.
+ *
+ * @returns  Dither, or NULL on bad arguments or allocation failure.
+ */
+dither_t *dither_create(int width, int height, int mode)
+{
+    dither_t *dither;
+
+    if ((width <= 0) || (height <= 0) || ((mode != DITHER_ORDERED) && (mode != DITHER_DIFFUSION)))
+    {
+        return NULL;
+    }
+
+    dither = calloc(1, sizeof(*dither));
+    if (!dither)
+    {
+        return NULL;
+    }
+
+    dither->width = width;
+    dither->height = height;
+    dither->mode = mode;
+    dither->brightness = -1;
+
+    dither->error = malloc((width + 2) * 3 * 2 * sizeof(*dither->error));
+    if (!dither->error)
+    {
+        dither_destroy(dither);
+        return NULL;
+    }
+
+    dither_update(dither, NULL);
+
+    return dither;
+}
+
+/**
+ * Free a dither.
+ *
+ * @param    dither  Dither from dither_create(), may be NULL.
+ *
+ * @returns  None
+ */
+void dither_destroy(dither_t *dither)
+{
+    if (!dither)
+    {
+        return;
+    }
+
+    free(dither->error);
+    free(dither);
+}
+
+/**
+ * Follow the gamma and brightness of the channel the canvas is shown on.
+ * The levels are only rebuilt when those changed, so it can be called every
+ * frame.  Zone brightness and power limiting aren't followed, they dim the
+ * channel after the dither.
+ *
+ * @param    dither   Dither.
+ * @param    channel  Channel, or NULL for a plain 16 to 8 bit dither.
+ *
+ * @returns  1 if the levels were rebuilt, 0 if not.
+ */
+int dither_update(dither_t *dither, const ws2811_channel_t *channel)
+{
+    int brightness = channel ? (channel->brightness & 0xff) : 255;
+    int changed = gamma_update(&dither->gamma, channel ? &channel->gamma : &gamma_linear);
+    int c;
+
+    if (!changed && (brightness == dither->brightness))
+    {
+        return 0;
+    }
+
+    for (c = 0; c < 3; c++)
+    {
+        levels_build(&dither->levels[c], dither->gamma.table[c], brightness);
+    }
+    dither->brightness = brightness;
+
+    return 1;
+}
+
+/**
+ * Dither one frame of 16 bit colors into the canvas pixels.
+ *
+ * @param    dither  Dither.
+ * @param    src     Width times height R, G, B values, rows top to bottom,
+ *                   65535 being full.
+ * @param    canvas  Canvas of the size given to dither_create().
+ *
+ * @returns  0 on success, -1 if the canvas size doesn't match.
+ */
+int dither_run(dither_t *dither, const uint16_t *src, canvas_t *canvas)
+{
+    if ((canvas->width != dither->width) || (canvas->height != dither->height))
+    {
+        return -1;
+    }
+
+    if (dither->mode == DITHER_DIFFUSION)
+    {
+        run_diffusion(dither, src, canvas->pixels);
+    }
+    else
+    {
+        run_ordered(dither, src, canvas->pixels);
+    }
+
+    return 0;
+}
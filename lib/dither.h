@@ -0,0 +1,87 @@
+/*
+ * dither.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __DITHER_H__
+#define __DITHER_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+#include "gamma.h"
+#include "canvas.h"
+
+
+/*
+ * Spatial dithering of 16 bit colors down to the 8 bit canvas pixels.  At
+ * low brightness the gamma curve and the brightness scaling leave only a
+ * few output levels, and smooth gradients turn into wide bands.  The dither
+ * works out the light each 16 bit color should give on the wire and spreads
+ * the difference to the nearest levels the LEDs can actually show over
+ * neighbouring pixels, so the bands turn into fine grain.
+ *
+ * DITHER_ORDERED thresholds against an 8x8 Bayer matrix.  Each pixel is
+ * independent, the pattern is fixed and doesn't crawl on moving content.
+ * DITHER_DIFFUSION spreads each pixel's error to its neighbours,
+ * Floyd-Steinberg in serpentine order, which gives finer grain and smoother
+ * gradients for a little more time per pixel.
+ */
+
+#define DITHER_ORDERED                           0
+#define DITHER_DIFFUSION                         1
+
+typedef struct
+{
+    uint16_t target[257];                        //< Wire level in 8.8 of each color value, last one repeated
+    uint8_t down[256];                           //< Highest level shown at or below each wire level
+    uint8_t next[256];                           //< Lowest level shown above each level, itself at the top
+    uint8_t input[256];                          //< Color value giving each level shown
+    uint8_t lowest;                              //< Lowest level shown
+    uint8_t highest;                             //< Highest level shown
+} dither_levels_t;
+
+typedef struct
+{
+    int width;
+    int height;
+    int mode;                                    //< DITHER_ORDERED or DITHER_DIFFUSION
+    int brightness;                              //< Brightness the levels are built for
+    gamma_lut_t gamma;
+    dither_levels_t levels[3];                   //< Red, green and blue
+    int32_t *error;                              //< Two rows of diffused error
+} dither_t;
+
+
+dither_t *dither_create(int width, int height, int mode);
+void dither_destroy(dither_t *dither);
+int dither_update(dither_t *dither, const ws2811_channel_t *channel);
+int dither_run(dither_t *dither, const uint16_t *src, canvas_t *canvas);
+
+
+#endif /* __DITHER_H__ */
@@ -95,6 +95,14 @@ typedef struct
 #define RPI_DMA_STRIDE_S_STRIDE(val)             ((val & 0xffff) << 0)
     uint32_t nextconbk;
     uint32_t debug;
+#define RPI_DMA_DEBUG_LITE                       (1 << 28)
+#define RPI_DMA_DEBUG_VERSION(val)               ((val >> 25) & 0x7)
+#define RPI_DMA_DEBUG_DMA_STATE(val)             ((val >> 16) & 0x1ff)
+#define RPI_DMA_DEBUG_DMA_ID(val)                ((val >> 8) & 0xff)
+#define RPI_DMA_DEBUG_OUTSTANDING_WRITES(val)    ((val >> 4) & 0xf)
+#define RPI_DMA_DEBUG_READ_ERROR                 (1 << 2)
+#define RPI_DMA_DEBUG_FIFO_ERROR                 (1 << 1)
+#define RPI_DMA_DEBUG_READ_LAST_NOT_SET_ERROR    (1 << 0)
 } __attribute__((packed)) dma_t;
 
 
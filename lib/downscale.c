@@ -0,0 +1,338 @@
+/*
+ * downscale.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "downscale.h"
+
+
+/*
+ * The average is separable.  For each canvas row, the source rows it covers
+ * are turned into 16 bit values and added up with their weights, one long
+ * multiply accumulate over the whole row that the compiler vectorizes.
+ * Each canvas pixel then adds up the source columns it covers in that sum.
+ * Weights are 16 bit fractions summing to exactly one, so a 16 bit value
+ * times the total weight just fits 32 bits.
+ *
+ * Linear light is the square of the color value, as for keyframes.
+ */
+
+#define WEIGHT_ONE                               (1 << 16)
+
+
+static uint32_t isqrt32(uint32_t x)
+{
+    uint32_t root = 0, bit = 1U << 30;
+
+    while (bit > x)
+    {
+        bit >>= 2;
+    }
+    while (bit)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+// 8 bit color of a 16 bit linear value, rounded to nearest
+static inline uint8_t from_linear(uint32_t linear)
+{
+    uint32_t x = (uint32_t)((((uint64_t)linear * 65025) + 32767) / 65535);
+    uint32_t root = isqrt32(x);
+
+    return root + (x > (root * root) + root);
+}
+
+/*
+ * Destination pixel d covers source positions d * src to (d + 1) * src in
+ * units of 1 / dst source pixels, source pixel j covers j * dst to
+ * (j + 1) * dst.  The weight of j is the overlap over the total src, rounded
+ * to 16 bits, with the rounding error added to the largest weight.
+ */
+static void spans_build(downscale_span_t *spans, uint32_t *weights, int src, int dst)
+{
+    int d, j, taps = 0;
+
+    for (d = 0; d < dst; d++)
+    {
+        int64_t lo = (int64_t)d * src, hi = lo + src;
+        int first = lo / dst, last = (hi - 1) / dst, largest = 0;
+        int64_t total = 0;
+
+        spans[d].first = first;
+        spans[d].count = last - first + 1;
+        spans[d].offset = taps;
+
+        for (j = first; j <= last; j++)
+        {
+            int64_t a = ((int64_t)j * dst > lo) ? ((int64_t)j * dst) : lo;
+            int64_t b = ((int64_t)(j + 1) * dst < hi) ? ((int64_t)(j + 1) * dst) : hi;
+            uint32_t *w = &weights[taps + j - first];
+
+            *w = (((b - a) * WEIGHT_ONE) + (src / 2)) / src;
+            total += *w;
+            if (*w > weights[taps + largest])
+            {
+                largest = j - first;
+            }
+        }
+        weights[taps + largest] += WEIGHT_ONE - total;
+
+        taps += spans[d].count;
+    }
+}
+
+// Source row as 16 bit RGB in ds->line, unless it's there already
+static void line_load(downscale_t *ds, const uint8_t *src, int stride, int row)
+{
+    const uint8_t *in = &src[(size_t)row * stride];
+    uint16_t *out = ds->line;
+    int j, count = ds->src_width * 3;
+
+    if (ds->line_row == row)
+    {
+        return;
+    }
+    ds->line_row = row;
+
+    if (ds->flags & DOWNSCALE_GAMMA)
+    {
+        for (j = 0; j < ds->src_width; j++)
+        {
+            out[(j * 3) + 0] = ds->to_linear[in[(j * ds->pixel_bytes) + 0]];
+            out[(j * 3) + 1] = ds->to_linear[in[(j * ds->pixel_bytes) + 1]];
+            out[(j * 3) + 2] = ds->to_linear[in[(j * ds->pixel_bytes) + 2]];
+        }
+    }
+    else if (ds->pixel_bytes == 3)
+    {
+        for (j = 0; j < count; j++)
+        {
+            out[j] = in[j] * 257;
+        }
+    }
+    else
+    {
+        for (j = 0; j < ds->src_width; j++)
+        {
+            out[(j * 3) + 0] = in[(j * 4) + 0] * 257;
+            out[(j * 3) + 1] = in[(j * 4) + 1] * 257;
+            out[(j * 3) + 2] = in[(j * 4) + 2] * 257;
+        }
+    }
+}
+
+
+/**
+ * Allocate a downscaler and compute its weights.
+ *
+ * @param    src_width    Source image width.
+ * @param    src_height   Source image height.
+ * @param    pixel_bytes  3 for RGB source pixels, 4 for RGBX or RGBA.
+ * @param    width        Canvas width.
+ * @param    height       Canvas height.
+ * @param    flags        0 or DOWNSCALE_GAMMA.
+ *
+ * @returns  Downscaler, or NULL on bad arguments or allocation failure.
+ */
+downscale_t *downscale_create(int src_width, int src_height, int pixel_bytes, int width, int height, int flags)
+{
+    downscale_t *ds;
+    int i;
+
+    if ((src_width <= 0) || (src_height <= 0) || (width <= 0) || (height <= 0) ||
+        ((pixel_bytes != 3) && (pixel_bytes != 4)))
+    {
+        return NULL;
+    }
+
+    ds = calloc(1, sizeof(*ds));
+    if (!ds)
+    {
+        return NULL;
+    }
+
+    ds->src_width = src_width;
+    ds->src_height = src_height;
+    ds->pixel_bytes = pixel_bytes;
+    ds->width = width;
+    ds->height = height;
+    ds->flags = flags;
+    ds->line_row = -1;
+
+    ds->cols = malloc(width * sizeof(*ds->cols));
+    ds->rows = malloc(height * sizeof(*ds->rows));
+    ds->col_weights = malloc((src_width + width) * sizeof(*ds->col_weights));
+    ds->row_weights = malloc((src_height + height) * sizeof(*ds->row_weights));
+    ds->line = malloc(src_width * 3 * sizeof(*ds->line));
+    ds->acc = malloc(src_width * 3 * sizeof(*ds->acc));
+    ds->column = malloc(src_width * 3 * sizeof(*ds->column));
+    if (!ds->cols || !ds->rows || !ds->col_weights || !ds->row_weights || !ds->line || !ds->acc || !ds->column)
+    {
+        downscale_destroy(ds);
+        return NULL;
+    }
+
+    spans_build(ds->cols, ds->col_weights, src_width, width);
+    spans_build(ds->rows, ds->row_weights, src_height, height);
+
+    for (i = 0; i < 256; i++)
+    {
+        ds->to_linear[i] = (((uint32_t)i * i * 65535) + (65025 / 2)) / 65025;
+    }
+
+    return ds;
+}
+
+/**
+ * Free a downscaler.
+ *
+ * @param    ds  Downscaler from downscale_create(), may be NULL.
+ *
+ * @returns  None
+ */
+void downscale_destroy(downscale_t *ds)
+{
+    if (!ds)
+    {
+        return;
+    }
+
+    free(ds->cols);
+    free(ds->rows);
+    free(ds->col_weights);
+    free(ds->row_weights);
+    free(ds->line);
+    free(ds->acc);
+    free(ds->column);
+    free(ds);
+}
+
+/**
+ * Downscale one image into the canvas pixels.
+ *
+ * @param    ds      Downscaler.
+ * @param    src     Source pixels, rows top to bottom, R, G, B (, X) bytes.
+ * @param    stride  Bytes from one source row to the next.
+ * @param    canvas  Canvas of the size given to downscale_create().
+ *
+ * @returns  0 on success, -1 if the canvas size doesn't match.
+ */
+int downscale_run(downscale_t *ds, const uint8_t *src, int stride, canvas_t *canvas)
+{
+    int count = ds->src_width * 3;
+    int x, y, t, k;
+
+    if ((canvas->width != ds->width) || (canvas->height != ds->height))
+    {
+        return -1;
+    }
+
+    ds->line_row = -1;
+
+    for (y = 0; y < ds->height; y++)
+    {
+        const downscale_span_t *rows = &ds->rows[y];
+        uint32_t *restrict acc = ds->acc;
+        uint16_t *restrict column = ds->column;
+        ws2811_led_t *out = &canvas->pixels[y * ds->width];
+
+        for (t = 0; t < rows->count; t++)
+        {
+            const uint16_t *restrict line;
+            uint32_t w = ds->row_weights[rows->offset + t];
+
+            line_load(ds, src, stride, rows->first + t);
+            line = ds->line;
+
+            if (!t)
+            {
+                for (k = 0; k < count; k++)
+                {
+                    acc[k] = w * line[k];
+                }
+            }
+            else
+            {
+                for (k = 0; k < count; k++)
+                {
+                    acc[k] += w * line[k];
+                }
+            }
+        }
+
+        for (k = 0; k < count; k++)
+        {
+            column[k] = (acc[k] + (WEIGHT_ONE / 2)) >> 16;
+        }
+
+        for (x = 0; x < ds->width; x++)
+        {
+            const downscale_span_t *cols = &ds->cols[x];
+            const uint16_t *in = &column[cols->first * 3];
+            const uint32_t *w = &ds->col_weights[cols->offset];
+            uint32_t r = WEIGHT_ONE / 2, g = WEIGHT_ONE / 2, b = WEIGHT_ONE / 2;
+
+            for (t = 0; t < cols->count; t++)
+            {
+                r += w[t] * in[(t * 3) + 0];
+                g += w[t] * in[(t * 3) + 1];
+                b += w[t] * in[(t * 3) + 2];
+            }
+            r >>= 16;
+            g >>= 16;
+            b >>= 16;
+
+            if (ds->flags & DOWNSCALE_GAMMA)
+            {
+                out[x] = (from_linear(r) << 16) | (from_linear(g) << 8) | from_linear(b);
+            }
+            else
+            {
+                out[x] = (((r + 128) / 257) << 16) | (((g + 128) / 257) << 8) | ((b + 128) / 257);
+            }
+        }
+    }
+
+    return 0;
+}
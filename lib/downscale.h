@@ -0,0 +1,84 @@
+/*
+ * downscale.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __DOWNSCALE_H__
+#define __DOWNSCALE_H__
+
+#include <stdint.h>
+
+#include "canvas.h"
+
+
+/*
+ * Area averaging from large RGB images, camera or video frames, down to a
+ * canvas.  Each canvas pixel is the average of the source area it covers,
+ * with partly covered source pixels weighted by how much of them it covers.
+ * The weights depend only on the sizes, so downscale_create() computes them
+ * once for a fixed source and canvas size.
+ *
+ * With DOWNSCALE_GAMMA the average is taken in linear light, so fine
+ * bright detail keeps its brightness instead of turning into dark grey.
+ */
+
+#define DOWNSCALE_GAMMA                          (1 << 0)    // Average in linear light
+
+typedef struct
+{
+    int first;                                   //< First source row or column
+    int count;                                   //< Source rows or columns covered
+    int offset;                                  //< Index of the first weight
+} downscale_span_t;
+
+typedef struct
+{
+    int src_width;
+    int src_height;
+    int pixel_bytes;                             //< 3 for RGB, 4 for RGBX or RGBA
+    int width;
+    int height;
+    int flags;
+    downscale_span_t *cols;
+    downscale_span_t *rows;
+    uint32_t *col_weights;                       //< Sum to 65536 per canvas column
+    uint32_t *row_weights;                       //< Sum to 65536 per canvas row
+    uint16_t *line;                              //< Source row in 16 bit RGB
+    int line_row;                                //< Source row in line, -1 for none
+    uint32_t *acc;                               //< Weighted sum of source rows
+    uint16_t *column;                            //< Average of source rows, per source column
+    uint16_t to_linear[256];                     //< 8 bit to 16 bit values
+} downscale_t;
+
+
+downscale_t *downscale_create(int src_width, int src_height, int pixel_bytes, int width, int height, int flags);
+void downscale_destroy(downscale_t *ds);
+int downscale_run(downscale_t *ds, const uint8_t *src, int stride, canvas_t *canvas);
+
+
+#endif /* __DOWNSCALE_H__ */
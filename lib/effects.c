@@ -0,0 +1,499 @@
+/*
+ * effects.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "effects.h"
+
+
+/*
+ * The per LED loops only use integer arithmetic without branches or table
+ * lookups where possible, so the compiler can vectorize them.
+ */
+
+#define ONE                                      EFFECT_FIXED_ONE
+#define FIRE_MAX_STEPS                           64    // Steps taken at most per call, after a stall
+#define FIRE_SPARK_LEDS                          7     // Sparks start among the first LEDs
+
+// What the tile functions of an effect draw
+typedef struct
+{
+    const void *fx;
+    ws2811_led_t *leds;
+    int count;                                   // Whole buffer, for positions
+} effect_draw_t;
+
+
+static inline int32_t clamp_one(int32_t x)
+{
+    return (x < 0) ? 0 : ((x > ONE) ? ONE : x);
+}
+
+/**
+ * Fully saturated color of a hue.
+ *
+ * @param    hue    Position on the color wheel, 16 bit turn fraction.
+ * @param    value  Brightness.
+ *
+ * @returns  Color.
+ */
+static inline ws2811_led_t wheel(uint32_t hue, uint32_t value)
+{
+    int32_t h = (hue & 0xffff) * 6;
+    uint32_t r = clamp_one(abs(h - (3 * ONE)) - ONE);
+    uint32_t g = clamp_one((2 * ONE) - abs(h - (2 * ONE)));
+    uint32_t b = clamp_one((2 * ONE) - abs(h - (4 * ONE)));
+
+    return (((r * value) >> 16) << 16) | (((g * value) >> 16) << 8) | ((b * value) >> 16);
+}
+
+/**
+ * Scale a color.
+ *
+ * @param    color  Color.
+ * @param    scale  0-256, 256 keeps the color.
+ *
+ * @returns  Scaled color.
+ */
+static inline ws2811_led_t color_scale(ws2811_led_t color, uint32_t scale)
+{
+    uint32_t rb = ((color & 0xff00ff) * scale) >> 8;
+    uint32_t g = ((color & 0x00ff00) * scale) >> 8;
+
+    return (rb & 0xff00ff) | (g & 0x00ff00);
+}
+
+// Parabolic sine approximation, x in 16 bit turn fractions, returns -256..256
+static inline int32_t sine(uint32_t x)
+{
+    int32_t y = x & 0x7fff;
+    int32_t p = (y * (0x8000 - y)) >> 20;
+
+    return (x & 0x8000) ? -p : p;
+}
+
+static inline uint32_t xorshift(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+/**
+ * Advance a phase by a rate per second.
+ *
+ * @param    phase  16.16 phase.
+ * @param    rate   16.16 change per second.
+ * @param    dt_us  Time step.
+ *
+ * @returns  New phase.
+ */
+static uint32_t advance(uint32_t phase, int32_t rate, uint32_t dt_us)
+{
+    return phase + (uint32_t)(((int64_t)rate * dt_us) / 1000000);
+}
+
+// Rainbow LEDs first to first + n - 1
+static void rainbow_tile(void *arg, int first, int n, int worker)
+{
+    const effect_draw_t *draw = arg;
+    const effect_rainbow_t *fx = draw->fx;
+    ws2811_led_t *leds = draw->leds;
+    uint32_t value = fx->value;
+    uint32_t start, step;
+    int i;
+
+    // Hues in 32 bit turn fractions, so the step keeps its precision on long strips
+    start = fx->phase << 16;
+    step = ((int64_t)fx->spread << 16) / draw->count;
+
+    for (i = first; i < first + n; i++)
+    {
+        leds[i] = wheel((start + (i * step)) >> 16, value);
+    }
+}
+
+/**
+ * Rainbow spread over the buffer, rotating through the color wheel.
+ *
+ * @param    fx     Effect parameters and state.
+ * @param    leds   LED buffer.
+ * @param    count  Number of LEDs.
+ * @param    dt_us  Time since the previous step.
+ *
+ * @returns  None
+ */
+void effect_rainbow(effect_rainbow_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us)
+{
+    effect_draw_t draw = { .fx = fx, .leds = leds, .count = count };
+
+    fx->phase = advance(fx->phase, fx->speed, dt_us);
+    if (count <= 0)
+    {
+        return;
+    }
+
+    tasks_run(fx->tasks, rainbow_tile, &draw, count, tasks_grain(sizeof(*leds), 64));
+}
+
+/**
+ * Theater chase, every spacing-th LED lit, moving along the buffer.
+ *
+ * @param    fx     Effect parameters and state.
+ * @param    leds   LED buffer.
+ * @param    count  Number of LEDs.
+ * @param    dt_us  Time since the previous step.
+ *
+ * @returns  None
+ */
+void effect_chase(effect_chase_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us)
+{
+    int spacing = (fx->spacing > 0) ? fx->spacing : 1;
+    int64_t span = (int64_t)spacing << 16;
+    int64_t phase = ((int64_t)fx->phase + (((int64_t)fx->speed * dt_us) / 1000000)) % span;
+    int i;
+
+    // Keep the phase within one spacing so it wraps cleanly in both directions
+    if (phase < 0)
+    {
+        phase += span;
+    }
+    fx->phase = phase;
+
+    for (i = 0; i < count; i++)
+    {
+        leds[i] = fx->background;
+    }
+
+    for (i = phase >> 16; i < count; i += spacing)
+    {
+        leds[i] = fx->color;
+    }
+}
+
+/**
+ * Allocate the state of the fire effect.
+ *
+ * @param    fx     Effect parameters and state.
+ * @param    count  Maximum number of LEDs.
+ *
+ * @returns  0 on success, -1 if out of memory.
+ */
+int effect_fire_init(effect_fire_t *fx, int count)
+{
+    fx->heat = calloc(count ? count : 1, sizeof(*fx->heat));
+    if (!fx->heat)
+    {
+        return -1;
+    }
+
+    fx->count = count;
+    fx->phase = 0;
+    if (!fx->seed)
+    {
+        fx->seed = 1;
+    }
+
+    return 0;
+}
+
+void effect_fire_free(effect_fire_t *fx)
+{
+    free(fx->heat);
+    fx->heat = NULL;
+    fx->count = 0;
+}
+
+static void fire_step(effect_fire_t *fx, int count)
+{
+    uint8_t *heat = fx->heat;
+    uint32_t cool = ((fx->cooling * 10) / count) + 2;
+    int i;
+
+    // Every cell cools down a little
+    for (i = 0; i < count; i++)
+    {
+        uint32_t loss = xorshift(&fx->seed) % cool;
+
+        heat[i] = (heat[i] > loss) ? (heat[i] - loss) : 0;
+    }
+
+    // Heat drifts up and diffuses
+    for (i = count - 1; i >= 2; i--)
+    {
+        heat[i] = (heat[i - 1] + (2 * heat[i - 2])) / 3;
+    }
+
+    // Randomly ignite new sparks near the bottom
+    if ((xorshift(&fx->seed) & 0xff) < fx->sparking)
+    {
+        int spark = xorshift(&fx->seed) % ((count < FIRE_SPARK_LEDS) ? count : FIRE_SPARK_LEDS);
+        uint32_t hotter = heat[spark] + 160 + (xorshift(&fx->seed) % 96);
+
+        heat[spark] = (hotter > 255) ? 255 : hotter;
+    }
+}
+
+// Black body like ramp, black - red - yellow - white
+static inline ws2811_led_t heat_color(uint32_t heat)
+{
+    uint32_t t = (heat * 191) >> 8;
+    uint32_t ramp = (t & 0x3f) << 2;
+
+    if (t & 0x80)
+    {
+        return 0xffff00 | ramp;
+    }
+    if (t & 0x40)
+    {
+        return 0xff0000 | (ramp << 8);
+    }
+
+    return ramp << 16;
+}
+
+/**
+ * Fire rising from the first LED.
+ *
+ * @param    fx     Effect parameters and state, see effect_fire_init().
+ * @param    leds   LED buffer.
+ * @param    count  Number of LEDs.
+ * @param    dt_us  Time since the previous step.
+ *
+ * @returns  None
+ */
+void effect_fire(effect_fire_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us)
+{
+    uint32_t steps;
+    int i;
+
+    if (count > fx->count)
+    {
+        count = fx->count;
+    }
+    if (count <= 0)
+    {
+        return;
+    }
+
+    fx->phase = advance(fx->phase, fx->rate, dt_us);
+    steps = fx->phase >> 16;
+    fx->phase &= 0xffff;
+
+    if (steps > FIRE_MAX_STEPS)
+    {
+        steps = FIRE_MAX_STEPS;
+    }
+    while (steps--)
+    {
+        fire_step(fx, count);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        leds[i] = heat_color(fx->heat[i]);
+    }
+}
+
+/**
+ * Allocate the state of the twinkle effect.
+ *
+ * @param    fx     Effect parameters and state.
+ * @param    count  Maximum number of LEDs.
+ *
+ * @returns  0 on success, -1 if out of memory.
+ */
+int effect_twinkle_init(effect_twinkle_t *fx, int count)
+{
+    fx->level = calloc(count ? count : 1, sizeof(*fx->level));
+    if (!fx->level)
+    {
+        return -1;
+    }
+
+    fx->count = count;
+    if (!fx->seed)
+    {
+        fx->seed = 1;
+    }
+
+    return 0;
+}
+
+void effect_twinkle_free(effect_twinkle_t *fx)
+{
+    free(fx->level);
+    fx->level = NULL;
+    fx->count = 0;
+}
+
+/**
+ * LEDs randomly lighting up and fading out.
+ *
+ * @param    fx     Effect parameters and state, see effect_twinkle_init().
+ * @param    leds   LED buffer.
+ * @param    count  Number of LEDs.
+ * @param    dt_us  Time since the previous step.
+ *
+ * @returns  None
+ */
+void effect_twinkle(effect_twinkle_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us)
+{
+    uint16_t *level = fx->level;
+    int64_t fade = ((int64_t)fx->decay * dt_us) / 1000000;
+    int64_t chance = ((int64_t)fx->density * dt_us) / 1000000;
+    uint32_t seed = fx->seed;
+    int i;
+
+    if (count > fx->count)
+    {
+        count = fx->count;
+    }
+
+    // Chances are compared against 16 bit random numbers
+    fade = (fade > 0xffff) ? 0xffff : fade;
+    chance = (chance > 0x10000) ? 0x10000 : chance;
+
+    for (i = 0; i < count; i++)
+    {
+        int32_t l = level[i] - (int32_t)fade;
+
+        if ((xorshift(&seed) & 0xffff) < chance)
+        {
+            l = 0xffff;
+        }
+        level[i] = (l < 0) ? 0 : l;
+        leds[i] = color_scale(fx->color, (level[i] >> 8) + 1);
+    }
+
+    fx->seed = seed;
+}
+
+// Plasma LEDs first to first + n - 1, a row at a time
+static void plasma_tile(void *arg, int first, int n, int worker)
+{
+    const effect_draw_t *draw = arg;
+    const effect_plasma_t *fx = draw->fx;
+    ws2811_led_t *leds = draw->leds;
+    int width = (fx->width > 0) ? fx->width : draw->count;
+    uint32_t scale = fx->scale;
+    uint32_t value = fx->value;
+    uint32_t t = fx->phase;
+    int i = first, end = first + n;
+
+    while (i < end)
+    {
+        int y = i / width, x0 = i - (y * width), x;
+        int32_t row = sine((y * scale) - t);
+        int m = ((end - i) < (width - x0)) ? (end - i) : (width - x0);
+
+        for (x = x0; x < x0 + m; x++)
+        {
+            int32_t v = sine((x * scale) + t) + row + sine((((x + y) * scale) >> 1) + (t >> 1));
+
+            // -768..768 to a hue, slowly rotating
+            leds[i + x - x0] = wheel(((v + 768) * 42) + (t >> 2), value);
+        }
+        i += m;
+    }
+}
+
+/**
+ * Plasma, overlapping sine waves mapped to the color wheel.
+ *
+ * @param    fx     Effect parameters and state.
+ * @param    leds   LED buffer.
+ * @param    count  Number of LEDs.
+ * @param    dt_us  Time since the previous step.
+ *
+ * @returns  None
+ */
+void effect_plasma(effect_plasma_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us)
+{
+    effect_draw_t draw = { .fx = fx, .leds = leds, .count = count };
+
+    fx->phase = advance(fx->phase, fx->speed, dt_us);
+
+    tasks_run(fx->tasks, plasma_tile, &draw, count, tasks_grain(sizeof(*leds), 64));
+}
+
+// Gradient LEDs first to first + n - 1
+static void gradient_tile(void *arg, int first, int n, int worker)
+{
+    const effect_draw_t *draw = arg;
+    const effect_gradient_t *fx = draw->fx;
+    ws2811_led_t *leds = draw->leds;
+    int32_t r0 = (fx->from >> 16) & 0xff, g0 = (fx->from >> 8) & 0xff, b0 = fx->from & 0xff;
+    int32_t dr = ((fx->to >> 16) & 0xff) - r0;
+    int32_t dg = ((fx->to >> 8) & 0xff) - g0;
+    int32_t db = (fx->to & 0xff) - b0;
+    uint32_t span = (draw->count > 1) ? (draw->count - 1) : 1;
+    uint32_t start, step;
+    int i;
+
+    // Positions in 24 bit fractions of the buffer length
+    start = fx->phase << 8;
+    step = (1 << 24) / span;
+
+    for (i = first; i < first + n; i++)
+    {
+        uint32_t pos = (start + (i * step)) & 0x1ffffff;
+        uint32_t tri = (pos & 0x1000000) ? (0x2000000 - pos) : pos;
+        int32_t f = (tri + 0x8000) >> 16;
+
+        leds[i] = ((r0 + ((dr * f) >> 8)) << 16) | ((g0 + ((dg * f) >> 8)) << 8) | (b0 + ((db * f) >> 8));
+    }
+}
+
+/**
+ * Gradient between two colors, optionally moving back and forth.
+ *
+ * @param    fx     Effect parameters and state.
+ * @param    leds   LED buffer.
+ * @param    count  Number of LEDs.
+ * @param    dt_us  Time since the previous step.
+ *
+ * @returns  None
+ */
+void effect_gradient(effect_gradient_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us)
+{
+    effect_draw_t draw = { .fx = fx, .leds = leds, .count = count };
+
+    // Positions repeat every two buffer lengths, from - to - from
+    fx->phase = advance(fx->phase, fx->speed, dt_us) & 0x1ffff;
+
+    tasks_run(fx->tasks, gradient_tile, &draw, count, tasks_grain(sizeof(*leds), 64));
+}
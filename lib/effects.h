@@ -0,0 +1,128 @@
+/*
+ * effects.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __EFFECTS_H__
+#define __EFFECTS_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+#include "tasks.h"
+
+
+/*
+ * Effects rendering straight into an LED buffer, usually channel->leds.
+ *
+ * Each effect has a parameter struct, which also holds the running state
+ * (phase, random seed, per LED buffers), and a step function advancing the
+ * effect by dt_us microseconds and drawing it.  Speeds and rates are 16.16
+ * fixed point per second, EFFECT_FIXED(1.5) gives 1.5.  Hues are 16.16 turns
+ * of the color wheel.
+ *
+ * Rainbow, plasma and gradient draw every LED independently.  Give them a
+ * pool in tasks to draw big buffers on all cores, the state still advances
+ * once per call.
+ */
+
+#define EFFECT_FIXED_ONE                         (1 << 16)
+#define EFFECT_FIXED(x)                          ((int32_t)((x) * EFFECT_FIXED_ONE))
+
+typedef struct
+{
+    int32_t speed;                               //< Wheel turns per second
+    int32_t spread;                              //< Wheel turns over the whole buffer
+    uint8_t value;                               //< Brightness
+    uint32_t phase;                              //< Hue of the first LED, advanced by the effect
+    tasks_t *tasks;                              //< Pool to draw on, NULL for the calling thread
+} effect_rainbow_t;
+
+typedef struct
+{
+    ws2811_led_t color;
+    ws2811_led_t background;
+    int spacing;                                 //< Lit LEDs are spacing LEDs apart
+    int32_t speed;                               //< LEDs per second
+    uint32_t phase;                              //< Offset of the lit LEDs, advanced by the effect
+} effect_chase_t;
+
+typedef struct
+{
+    uint8_t cooling;                             //< Heat lost per step, higher gives shorter flames
+    uint8_t sparking;                            //< Chance of a new spark per step, out of 255
+    int32_t rate;                                //< Simulation steps per second
+    uint32_t phase;                              //< Part of a step not taken yet
+    uint32_t seed;                               //< Random state, any non-zero value
+    int count;
+    uint8_t *heat;                               //< Heat per LED, from effect_fire_init()
+} effect_fire_t;
+
+typedef struct
+{
+    ws2811_led_t color;
+    int32_t density;                             //< New twinkles per LED per second
+    int32_t decay;                               //< Full brightness fades out in 1 / decay seconds
+    uint32_t seed;                               //< Random state, any non-zero value
+    int count;
+    uint16_t *level;                             //< Brightness per LED, from effect_twinkle_init()
+} effect_twinkle_t;
+
+typedef struct
+{
+    int width;                                   //< LEDs per row of a matrix, 0 for a strip
+    int32_t scale;                               //< Wave turns per LED
+    int32_t speed;                               //< Wave turns per second
+    uint8_t value;                               //< Brightness
+    uint32_t phase;                              //< Advanced by the effect
+    tasks_t *tasks;                              //< Pool to draw on, NULL for the calling thread
+} effect_plasma_t;
+
+typedef struct
+{
+    ws2811_led_t from;                           //< Color of the first LED
+    ws2811_led_t to;                             //< Color of the last LED
+    int32_t speed;                               //< Buffer lengths the gradient moves per second
+    uint32_t phase;                              //< Advanced by the effect
+    tasks_t *tasks;                              //< Pool to draw on, NULL for the calling thread
+} effect_gradient_t;
+
+
+void effect_rainbow(effect_rainbow_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us);
+void effect_chase(effect_chase_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us);
+int effect_fire_init(effect_fire_t *fx, int count);
+void effect_fire_free(effect_fire_t *fx);
+void effect_fire(effect_fire_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us);
+int effect_twinkle_init(effect_twinkle_t *fx, int count);
+void effect_twinkle_free(effect_twinkle_t *fx);
+void effect_twinkle(effect_twinkle_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us);
+void effect_plasma(effect_plasma_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us);
+void effect_gradient(effect_gradient_t *fx, ws2811_led_t *leds, int count, uint32_t dt_us);
+
+
+#endif /* __EFFECTS_H__ */
@@ -0,0 +1,346 @@
+/*
+ * emu.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "emu.h"
+
+
+#define EMU_BUS_ADDR                             0xde000000   // Arbitrary, within the uncached alias
+#define EMU_UNDERRUN_NS                          100000       // Transfer time with an underrun
+
+
+const rpi_hw_t emu_rpi_hw =
+{
+    .hwver = 0,
+    .type = RPI_HWVER_TYPE_PI2,
+    .periph_base = 0x3f000000,
+    .videocore_base = 0xc0000000,
+    .desc = "Emulated",
+};
+
+
+static uint64_t emu_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/**
+ * Translate a bus address into a pointer into the emulated VideoCore memory.
+ *
+ * @param    emu       Emulator instance.
+ * @param    bus_addr  Bus address.
+ * @param    len       Number of bytes that must be accessible.
+ *
+ * @returns  Pointer, NULL if the range is outside the emulated memory.
+ */
+static uint8_t *emu_bus_to_virt(emu_t *emu, uint32_t bus_addr, uint32_t len)
+{
+    uint32_t offset = bus_addr - emu->bus_addr;
+
+    if ((bus_addr < emu->bus_addr) || (offset > emu->mem_size) || (len > emu->mem_size - offset))
+    {
+        return NULL;
+    }
+
+    return emu->mem + offset;
+}
+
+/**
+ * Apply the faults scripted for a frame.
+ *
+ * @param    emu    Emulator instance.
+ * @param    frame  Frame number, -1 for faults hitting before the first frame.
+ * @param    now    Current time.
+ *
+ * @returns  None
+ */
+static void emu_faults(emu_t *emu, int frame, uint64_t now)
+{
+    const ws2811_fault_t *fault;
+
+    for (fault = emu->faults; fault && fault->fault != WS2811_FAULT_NONE; fault++)
+    {
+        if ((frame >= 0) && (fault->frame != frame))
+        {
+            continue;
+        }
+
+        switch (fault->fault)
+        {
+            case WS2811_FAULT_DMA_ERROR:
+                if (frame >= 0)
+                {
+                    emu->debug_errors |= fault->arg ? fault->arg : RPI_DMA_DEBUG_READ_ERROR;
+                }
+                break;
+
+            case WS2811_FAULT_CLK_BUSY:
+                // Frame 0 hits the clock setup, later frames whatever touches it next
+                if ((frame < 0) ? (fault->frame == 0) : (fault->frame != 0))
+                {
+                    emu->clk_busy_until = fault->arg ? now + (fault->arg * 1000000ULL) : ~0ULL;
+                }
+                break;
+
+            case WS2811_FAULT_UNDERRUN:
+                if (frame >= 0)
+                {
+                    emu->underrun = 1;
+                }
+                break;
+
+            case WS2811_FAULT_SLOW:
+                if ((frame >= 0) && emu->active)
+                {
+                    emu->end_ns += fault->arg * 1000ULL;
+                }
+                break;
+        }
+    }
+}
+
+/**
+ * Start the transfer described by the control block the DMA registers point at.
+ * The whole source buffer is copied to the sink right away.
+ *
+ * @param    emu  Emulator instance.
+ * @param    now  Current time.
+ *
+ * @returns  None
+ */
+static void emu_dma_start(emu_t *emu, uint64_t now)
+{
+    dma_cb_t *cb = (dma_cb_t *)emu_bus_to_virt(emu, emu->dma.conblk_ad, sizeof(dma_cb_t));
+    uint8_t *src;
+
+    if (!cb || cb->nextconbk)
+    {
+        emu->debug_errors |= RPI_DMA_DEBUG_READ_LAST_NOT_SET_ERROR;
+        return;
+    }
+
+    src = emu_bus_to_virt(emu, cb->source_ad, cb->txfr_len);
+    if (!src)
+    {
+        emu->debug_errors |= RPI_DMA_DEBUG_READ_ERROR;
+        return;
+    }
+
+    if (cb->txfr_len > emu->sink_len)
+    {
+        uint8_t *sink = realloc(emu->sink, cb->txfr_len);
+
+        if (!sink)
+        {
+            emu->debug_errors |= RPI_DMA_DEBUG_FIFO_ERROR;
+            return;
+        }
+        emu->sink = sink;
+    }
+    memcpy(emu->sink, src, cb->txfr_len);
+    emu->sink_len = cb->txfr_len;
+
+    emu->active = 1;
+    emu->end_ns = now;
+    if (emu->wire_time)
+    {
+        emu->end_ns += (cb->txfr_len * 8ULL * 1000000000ULL) / (emu->freq * 3);
+    }
+
+    emu_faults(emu, emu->started++, now);
+
+    // Keep the transfer going long enough for the underrun to be seen
+    if (emu->underrun && (emu->end_ns < now + EMU_UNDERRUN_NS))
+    {
+        emu->end_ns = now + EMU_UNDERRUN_NS;
+    }
+}
+
+/**
+ * Advance the emulated hardware to the current time and reflect register
+ * writes done since the previous call.
+ *
+ * @param    emu  Emulator instance.
+ *
+ * @returns  None
+ */
+void emu_update(emu_t *emu)
+{
+    uint64_t now = emu_now();
+
+    // The clock manager is busy as long as it is enabled
+    if (now < emu->clk_busy_until)
+    {
+        emu->cm_pcm.ctl |= CM_PCM_CTL_BUSY;
+    }
+    else if ((emu->cm_pcm.ctl & CM_PCM_CTL_ENAB) && !(emu->cm_pcm.ctl & CM_PCM_CTL_KILL))
+    {
+        emu->cm_pcm.ctl |= CM_PCM_CTL_BUSY;
+    }
+    else
+    {
+        emu->cm_pcm.ctl &= ~CM_PCM_CTL_BUSY;
+    }
+
+    // Debug error bits are write 1 to clear
+    if (emu->dma.debug != emu->dma_debug)
+    {
+        emu->debug_errors &= ~emu->dma.debug;
+    }
+
+    if (emu->dma.cs & RPI_DMA_CS_RESET)
+    {
+        emu->dma.cs = 0;
+        emu->active = 0;
+        emu->debug_errors = 0;
+    }
+
+    if ((emu->dma.cs & RPI_DMA_CS_ACTIVE) && !emu->active && !emu->debug_errors)
+    {
+        emu->dma.cs &= ~RPI_DMA_CS_END;
+        emu_dma_start(emu, now);
+
+        // A DMA error stops the transfer
+        if (emu->debug_errors)
+        {
+            emu->active = 0;
+        }
+    }
+
+    if (emu->active && (now >= emu->end_ns))
+    {
+        emu->active = 0;
+        emu->underrun = 0;
+        emu->frames++;
+        emu->dma.cs = (emu->dma.cs & ~RPI_DMA_CS_ACTIVE) | RPI_DMA_CS_END;
+    }
+
+    if (emu->debug_errors)
+    {
+        emu->dma.cs |= RPI_DMA_CS_ERROR;
+    }
+    else
+    {
+        emu->dma.cs &= ~RPI_DMA_CS_ERROR;
+    }
+    emu->dma.debug = emu->debug_errors;
+
+    // The TX FIFO is only filled while the DMA runs, and drains right after.  A
+    // scripted underrun shows up once while the DMA is still active.
+    emu->pcm.cs &= ~(RPI_PCM_CS_TXE | RPI_PCM_CS_TXERR);
+    if (emu->active && emu->underrun)
+    {
+        emu->pcm.cs |= RPI_PCM_CS_TXERR;
+        emu->underrun = 0;
+    }
+    else if (!emu->active)
+    {
+        emu->pcm.cs |= RPI_PCM_CS_TXE;
+
+        if (emu->pcm.cs & RPI_PCM_CS_TXON)
+        {
+            emu->pcm.cs |= RPI_PCM_CS_TXERR;
+        }
+    }
+
+    emu->dma_debug = emu->dma.debug;
+}
+
+/**
+ * Create an emulator instance.
+ *
+ * @param    mem_size   Size of the emulated VideoCore memory, a page size multiple.
+ * @param    freq       Output frequency.
+ * @param    wire_time  Non-zero to let transfers take the time they'd take on the wire.
+ * @param    faults     Fault script, NULL for none.
+ *
+ * @returns  Emulator instance, NULL if out of memory or by script.
+ */
+emu_t *emu_create(uint32_t mem_size, uint32_t freq, int wire_time,
+                  const ws2811_fault_t *faults)
+{
+    const ws2811_fault_t *fault;
+    emu_t *emu;
+
+    for (fault = faults; fault && fault->fault != WS2811_FAULT_NONE; fault++)
+    {
+        if (fault->fault == WS2811_FAULT_ALLOC)
+        {
+            return NULL;
+        }
+    }
+
+    emu = calloc(1, sizeof(*emu));
+    if (!emu)
+    {
+        return NULL;
+    }
+
+    if (posix_memalign((void **)&emu->mem, PAGE_SIZE, mem_size))
+    {
+        free(emu);
+        return NULL;
+    }
+    memset(emu->mem, 0, mem_size);
+
+    emu->mem_size = mem_size;
+    emu->bus_addr = EMU_BUS_ADDR;
+    emu->freq = freq;
+    emu->wire_time = wire_time;
+    emu->faults = faults;
+
+    // Faults scripted for frame 0 that hit during setup
+    emu_faults(emu, -1, emu_now());
+    emu_update(emu);
+
+    return emu;
+}
+
+/**
+ * Release an emulator instance.
+ *
+ * @param    emu  Emulator instance.
+ *
+ * @returns  None
+ */
+void emu_destroy(emu_t *emu)
+{
+    free(emu->sink);
+    free(emu->mem);
+    free(emu);
+}
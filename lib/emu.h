@@ -0,0 +1,89 @@
+/*
+ * emu.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __EMU_H__
+#define __EMU_H__
+
+#include "clk.h"
+#include "gpio.h"
+#include "dma.h"
+#include "pcm.h"
+#include "rpihw.h"
+#include "ws2811-pcm.h"
+
+
+/*
+ * Emulated PCM, DMA and clock manager, used instead of the real peripherals
+ * when no hardware is available, for instance to benchmark the library.
+ *
+ * The register blocks are plain memory.  emu_update() brings them in line with
+ * what the hardware would have done since the previous call, so it must be
+ * called from every loop polling a register.  The PCM output goes to a sink
+ * holding a copy of the last PCM buffer sent.
+ */
+typedef struct
+{
+    dma_t dma;
+    pcm_t pcm;
+    cm_pcm_t cm_pcm;
+    gpio_t gpio;
+
+    uint8_t *mem;                                //< Emulated VideoCore memory
+    uint32_t mem_size;
+    uint32_t bus_addr;                           //< Bus address of mem
+    uint32_t freq;                               //< Output frequency
+    int wire_time;                               //< Transfers take the real wire time
+
+    uint32_t dma_debug;                          //< Debug register value last exposed
+    uint32_t debug_errors;                       //< DMA debug error bits, write 1 to clear
+
+    int active;                                  //< DMA transfer in progress
+    uint64_t end_ns;                             //< Completion time of the transfer
+
+    uint8_t *sink;                               //< Last PCM buffer sent
+    uint32_t sink_len;
+    uint64_t started;                            //< Number of transfers started
+    uint64_t frames;                             //< Number of PCM buffers sent
+
+    const ws2811_fault_t *faults;                //< Fault script, NULL if none
+    uint64_t clk_busy_until;                     //< Clock stuck busy until, ~0 for ever
+    int underrun;                                //< Underrun to report during the transfer
+} emu_t;
+
+
+extern const rpi_hw_t emu_rpi_hw;
+
+emu_t *emu_create(uint32_t mem_size, uint32_t freq, int wire_time,
+                  const ws2811_fault_t *faults);
+void emu_destroy(emu_t *emu);
+void emu_update(emu_t *emu);
+
+
+#endif /* __EMU_H__ */
@@ -0,0 +1,433 @@
+/*
+ * encode.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "calibrate.h"
+#include "encode.h"
+#include "lut3d.h"
+
+
+#define ARRAY_SIZE(stuff)                        (sizeof(stuff) / sizeof(stuff[0]))
+
+#define ENCODE_BLOCK                             64          // LEDs corrected ahead of the table kernel
+
+
+/*
+ * All kernels, the reference first.  Every kernel must produce the same
+ * output as the reference for any input, which the fuzz harness checks.
+ */
+const encode_kernel_t encode_kernels[] =
+{
+    { "ref", encode_ref },
+    { "lut", encode_lut },
+};
+
+const int encode_kernel_count = ARRAY_SIZE(encode_kernels);
+
+/**
+ * Reset the encoder state so the kernels rebuild their tables on first use.
+ *
+ * @param    encoder  Encoder state.
+ *
+ * @returns  None
+ */
+void encoder_init(encoder_t *encoder)
+{
+    encoder->histogram = 0;
+    encoder->zones = 0;
+    encoder->zone = NULL;
+    encoder->gamma.serial = 0;
+    encode_zone_init(&encoder->whole, 0);
+}
+
+/**
+ * Reset a zone so the kernels rebuild its table on first use.
+ *
+ * @param    zone  Zone.
+ * @param    end   One past the last LED of the zone.
+ *
+ * @returns  None
+ */
+void encode_zone_init(encode_zone_t *zone, int end)
+{
+    zone->end = end;
+    zone->brightness = 255;
+    zone->built = -1;
+    zone->invert = 0;
+    zone->strip_type = 0;
+    zone->gamma = 0;
+}
+
+// Color of the wire position with this shift: 0 red, 1 green, 2 blue
+static inline int shift_color(int shift)
+{
+    return (16 - shift) / 8;
+}
+
+/**
+ * Zones to encode the channel with.  Also brings the gamma tables up to
+ * date, so every kernel calls this first.
+ *
+ * @param    encoder  Encoder state.
+ * @param    channel  Channel to encode.
+ * @param    zones    Set to the number of zones.
+ *
+ * @returns  Zones, the last one ending at or after the last LED.
+ */
+static encode_zone_t *encode_zones(encoder_t *encoder, const ws2811_channel_t *channel, int *zones)
+{
+    gamma_update(&encoder->gamma, &channel->gamma);
+
+    if (!encoder->zones)
+    {
+        encoder->whole.end = channel->count;
+        encoder->whole.brightness = channel->brightness & 0xff;
+        *zones = 1;
+        return &encoder->whole;
+    }
+
+    *zones = encoder->zones;
+    return encoder->zone;
+}
+
+/**
+ * Reference kernel, one symbol bit at a time.  This defines the output all
+ * other kernels are checked against, so keep it simple rather than fast.
+ *
+ * @param    encoder  Encoder state, only used for zones and histograms.
+ * @param    channel  Channel to encode.
+ * @param    out      PCM buffer.
+ *
+ * @returns  None
+ */
+void encode_ref(encoder_t *encoder, const ws2811_channel_t *channel, uint32_t *out)
+{
+    int bitpos = 31;
+    int wordpos = 0;
+    int rshift  = (channel->strip_type >> 16) & 0xff;
+    int gshift  = (channel->strip_type >> 8)  & 0xff;
+    int bshift  = (channel->strip_type >> 0)  & 0xff;
+    const uint8_t (*gamma)[256];
+    encode_zone_t *zone;
+    int zones, z = 0;
+    int i, k, l;
+    unsigned j;
+
+    zone = encode_zones(encoder, channel, &zones);
+    gamma = encoder->gamma.table;
+
+    for (i = 0; i < channel->count; i++)                // Led
+    {
+        while ((z < zones - 1) && (i >= zone[z].end))
+        {
+            z++;
+        }
+
+        ws2811_led_t led = channel->leds[i];
+
+        if (channel->lut3d)
+        {
+            led = lut3d_color(channel->lut3d, led);
+        }
+        if (channel->calibration)
+        {
+            led = (((((led >> 16) & 0xff) * (((channel->calibration[i] >> 16) & 0xff) + 1)) >> 8) << 16) |
+                  (((((led >> 8) & 0xff) * (((channel->calibration[i] >> 8) & 0xff) + 1)) >> 8) << 8) |
+                  ((((led >> 0) & 0xff) * (((channel->calibration[i] >> 0) & 0xff) + 1)) >> 8);
+        }
+
+        int scale = (zone[z].brightness & 0xff) + 1;
+        uint8_t color[] = {
+            gamma[shift_color(rshift)][(((led >> rshift) & 0xff) * scale) >> 8], // first on the wire
+            gamma[shift_color(gshift)][(((led >> gshift) & 0xff) * scale) >> 8], // second
+            gamma[shift_color(bshift)][(((led >> bshift) & 0xff) * scale) >> 8], // third
+        };
+
+        if (encoder->histogram)
+        {
+            zone[z].hist[0][(led >> 16) & 0xff]++;
+            zone[z].hist[1][(led >> 8) & 0xff]++;
+            zone[z].hist[2][led & 0xff]++;
+        }
+
+        for (j = 0; j < ARRAY_SIZE(color); j++)        // Color
+        {
+            for (k = 7; k >= 0; k--)                   // Bit
+            {
+                uint8_t symbol = (channel->invert ? SYMBOL_HIGH : SYMBOL_LOW);
+
+                if (color[j] & (1 << k)) {
+                    symbol = (channel->invert ? SYMBOL_LOW : SYMBOL_HIGH);
+                }
+
+                for (l = 2; l >= 0; l--)               // Symbol
+                {
+                    uint32_t *wordptr = &out[wordpos];
+
+                    *wordptr &= ~(1U << bitpos);
+                    if (symbol & (1 << l))
+                    {
+                        *wordptr |= (1U << bitpos);
+                    }
+
+                    bitpos--;
+                    if (bitpos < 0) {
+                        wordpos ++;
+                        bitpos = 31;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Build the tables mapping a color value straight to its 24 symbol bits, with
+ * the zone brightness and each color's gamma applied, in wire order.
+ *
+ * @param    zone        Zone.
+ * @param    invert      Non-zero for an inverted output.
+ * @param    strip_type  Strip color layout, one of WS2811_STRIP_xxx.
+ * @param    gamma       Gamma tables.
+ *
+ * @returns  None
+ */
+static void zone_build(encode_zone_t *zone, int invert, int strip_type, const gamma_lut_t *gamma)
+{
+    uint32_t one = invert ? SYMBOL_LOW : SYMBOL_HIGH;
+    uint32_t zero = invert ? SYMBOL_HIGH : SYMBOL_LOW;
+    int brightness = zone->brightness & 0xff;
+    int scale = brightness + 1;
+    int slot, value, k;
+
+    for (slot = 0; slot < 3; slot++)
+    {
+        const uint8_t *table = gamma->table[shift_color((strip_type >> (16 - (slot * 8))) & 0xff)];
+
+        for (value = 0; value < 256; value++)
+        {
+            uint8_t color = table[(value * scale) >> 8];
+            uint32_t symbols = 0;
+
+            for (k = 7; k >= 0; k--)
+            {
+                symbols = (symbols << 3) | ((color & (1 << k)) ? one : zero);
+            }
+
+            zone->symbols[slot][value] = symbols;
+        }
+    }
+
+    zone->built = brightness;
+    zone->invert = invert;
+    zone->strip_type = strip_type;
+    zone->gamma = gamma->serial;
+}
+
+/**
+ * Table kernel.  Every color byte is one lookup of its 24 symbol bits, which
+ * are shifted into a 64-bit accumulator and stored a whole word at a time, so
+ * the uncached PCM buffer is written once per word instead of once per bit.
+ * Each zone has its own table.  Color correction and calibration are applied
+ * a block of LEDs at a time into a buffer that stays in the L1 cache, rather
+ * than as a pass over the whole channel.
+ *
+ * @param    encoder  Encoder state holding the symbol tables.
+ * @param    channel  Channel to encode.
+ * @param    out      PCM buffer.
+ *
+ * @returns  None
+ */
+void encode_lut(encoder_t *encoder, const ws2811_channel_t *channel, uint32_t *out)
+{
+    const ws2811_led_t *leds = channel->leds;
+    int invert = !!channel->invert;
+    int rshift  = (channel->strip_type >> 16) & 0xff;
+    int gshift  = (channel->strip_type >> 8)  & 0xff;
+    int bshift  = (channel->strip_type >> 0)  & 0xff;
+    uint64_t acc = 0;
+    int bits = 0;                                       // Valid bits in acc
+    ws2811_led_t block[ENCODE_BLOCK];
+    encode_zone_t *zone;
+    int zones, z, i = 0;
+
+    zone = encode_zones(encoder, channel, &zones);
+
+    for (z = 0; (z < zones) && (i < channel->count); z++)
+    {
+        const uint32_t *first = zone[z].symbols[0], *second = zone[z].symbols[1], *third = zone[z].symbols[2];
+        uint32_t (*hist)[256] = encoder->histogram ? zone[z].hist : NULL;
+        int end = ((z == zones - 1) || (zone[z].end > channel->count)) ? channel->count : zone[z].end;
+
+        if ((zone[z].built != (zone[z].brightness & 0xff)) || (zone[z].invert != invert) ||
+            (zone[z].strip_type != channel->strip_type) || (zone[z].gamma != encoder->gamma.serial))
+        {
+            zone_build(&zone[z], invert, channel->strip_type, &encoder->gamma);
+        }
+
+        while (i < end)
+        {
+            const ws2811_led_t *src = &leds[i];
+            int n = ((end - i) < ENCODE_BLOCK) ? (end - i) : ENCODE_BLOCK;
+            int j;
+
+            if (channel->lut3d)
+            {
+                lut3d_apply(channel->lut3d, src, block, n);
+                src = block;
+            }
+            if (channel->calibration)
+            {
+                calibrate_apply(src, &channel->calibration[i], block, n);
+                src = block;
+            }
+
+            for (j = 0; j < n; j++)
+            {
+                ws2811_led_t led = src[j];
+
+                if (hist)
+                {
+                    hist[0][(led >> 16) & 0xff]++;
+                    hist[1][(led >> 8) & 0xff]++;
+                    hist[2][led & 0xff]++;
+                }
+
+                acc = (acc << 24) | first[(led >> rshift) & 0xff];
+                bits += 24;
+                if (bits >= 32)
+                {
+                    bits -= 32;
+                    *out++ = acc >> bits;
+                }
+
+                acc = (acc << 24) | second[(led >> gshift) & 0xff];
+                bits += 24;
+                if (bits >= 32)
+                {
+                    bits -= 32;
+                    *out++ = acc >> bits;
+                }
+
+                acc = (acc << 24) | third[(led >> bshift) & 0xff];
+                bits += 24;
+                if (bits >= 32)
+                {
+                    bits -= 32;
+                    *out++ = acc >> bits;
+                }
+            }
+
+            i += n;
+        }
+    }
+
+    // Merge the last partial word, keeping the bits past the end
+    if (bits)
+    {
+        *out = (*out & (0xffffffffU >> bits)) | (uint32_t)(acc << (32 - bits));
+    }
+}
+
+/**
+ * Estimate the current drawn by the LEDs counted in a histogram, after
+ * brightness and gamma.
+ *
+ * @param    hist        Red, green and blue value counts of the last frame.
+ * @param    brightness  Brightness, 0-255.
+ * @param    current_ua  Current of red, green and blue at full scale.
+ * @param    gamma       Red, green and blue gamma tables.
+ *
+ * @returns  Current in uA, without the idle current.
+ */
+uint64_t encode_current_ua(const uint32_t hist[3][256], int brightness, const uint32_t current_ua[3],
+                           const uint8_t gamma[3][256])
+{
+    int scale = (brightness & 0xff) + 1;
+    uint64_t total = 0;
+    int color, value;
+
+    for (color = 0; color < 3; color++)
+    {
+        uint64_t sum = 0;
+
+        for (value = 0; value < 256; value++)
+        {
+            sum += hist[color][value] * gamma[color][(value * scale) >> 8];
+        }
+
+        total += (sum * current_ua[color]) / 255;
+    }
+
+    return total;
+}
+
+/**
+ * Find the highest brightness keeping the LEDs counted in a histogram
+ * within a current budget.  The current only grows with the brightness, so
+ * this is a binary search.
+ *
+ * @param    hist        Red, green and blue value counts of the last frame.
+ * @param    brightness  Highest brightness allowed.
+ * @param    current_ua  Current of red, green and blue at full scale.
+ * @param    gamma       Red, green and blue gamma tables.
+ * @param    budget_ua   Current available to the LEDs.
+ *
+ * @returns  Brightness, 0 if even that exceeds the budget.
+ */
+int encode_power_fit(const uint32_t hist[3][256], int brightness, const uint32_t current_ua[3],
+                     const uint8_t gamma[3][256], uint64_t budget_ua)
+{
+    int low = 0, high = brightness & 0xff;
+
+    if (encode_current_ua(hist, high, current_ua, gamma) <= budget_ua)
+    {
+        return high;
+    }
+
+    // Invariant: low fits or is 0, high doesn't fit
+    while (high - low > 1)
+    {
+        int mid = (low + high) / 2;
+
+        if (encode_current_ua(hist, mid, current_ua, gamma) <= budget_ua)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
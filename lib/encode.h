@@ -0,0 +1,107 @@
+/*
+ * encode.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __ENCODE_H__
+#define __ENCODE_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+#include "gamma.h"
+
+
+#define SYMBOL_HIGH                              0x6  // 1 1 0
+#define SYMBOL_LOW                               0x4  // 1 0 0
+
+#define ENCODE_BITS_PER_LED                      (3 * 8 * 3)  // 3 colors, 8 bits, 3 symbols
+#define ENCODE_WORDS(leds)                       ((((leds) * ENCODE_BITS_PER_LED) + 31) / 32)
+
+/*
+ * A run of LEDs encoded at one brightness.  Kernels cache the symbol tables
+ * for the brightness here and must rebuild them when the settings change.
+ * There is a table for each color position on the wire, as each color may
+ * have its own gamma curve.
+ */
+typedef struct
+{
+    int end;                                     //< One past the last LED of the zone
+    int brightness;                              //< Brightness to encode the zone with
+    int built;                                   //< Brightness the symbols are built for, -1 for none
+    int invert;                                  //< Invert setting the symbols are built for
+    int strip_type;                              //< Strip type the symbols are built for
+    unsigned gamma;                              //< Gamma serial the symbols are built for
+    uint32_t symbols[3][256];                    //< Color value to 24 PCM symbol bits, in wire order
+    uint32_t hist[3][256];                       //< Red, green and blue value counts, cleared by the caller
+} encode_zone_t;
+
+/*
+ * Per channel encoder state.  Without zones, all LEDs are encoded at the
+ * channel brightness using the whole zone.  Otherwise the zones are
+ * encoded at their own brightness, the last one must end at or after the
+ * last LED.
+ */
+typedef struct
+{
+    int histogram;                               //< Count color values per zone while encoding
+    int zones;                                   //< Number of zones, 0 for none
+    encode_zone_t *zone;                         //< Zones, in LED order
+    encode_zone_t whole;                         //< All LEDs when there are no zones
+    gamma_lut_t gamma;                           //< Gamma tables of the channel
+} encoder_t;
+
+/*
+ * Encode all LEDs of the channel into PCM symbols, starting at the most
+ * significant bit of out[0].  Bits past the last LED are left untouched.
+ * With encoder->histogram set, the input values are also counted per color
+ * in the zone histograms, for the power estimate.
+ */
+typedef void (*encode_fn_t)(encoder_t *encoder, const ws2811_channel_t *channel, uint32_t *out);
+
+typedef struct
+{
+    const char *name;
+    encode_fn_t encode;
+} encode_kernel_t;
+
+extern const encode_kernel_t encode_kernels[];
+extern const int encode_kernel_count;
+
+
+void encoder_init(encoder_t *encoder);
+void encode_zone_init(encode_zone_t *zone, int end);
+void encode_ref(encoder_t *encoder, const ws2811_channel_t *channel, uint32_t *out);
+void encode_lut(encoder_t *encoder, const ws2811_channel_t *channel, uint32_t *out);
+uint64_t encode_current_ua(const uint32_t hist[3][256], int brightness, const uint32_t current_ua[3],
+                           const uint8_t gamma[3][256]);
+int encode_power_fit(const uint32_t hist[3][256], int brightness, const uint32_t current_ua[3],
+                     const uint8_t gamma[3][256], uint64_t budget_ua);
+
+
+#endif /* __ENCODE_H__ */
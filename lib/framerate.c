@@ -0,0 +1,285 @@
+/*
+ * framerate.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "framerate.h"
+
+
+/*
+ * The queue follows the rules of the keyframe queue, and when blending
+ * every frame is pushed to a keyframe queue as well, which then drops the
+ * same frames at the same times.  Frames are kept as pushed so held frames
+ * go out exactly, the keyframe queue only renders crossfades.
+ *
+ * Each render remembers which frames it showed and how far between them.
+ * If the next would show the same, the LEDs already have it.
+ */
+
+#define BLEND_SHIFT                              15          // Same weights as keyframe_render()
+
+
+// Forget the oldest frame, counting it if it was never seen
+static void drop_first(framerate_t *framerate)
+{
+    if (!framerate->shown[framerate->first])
+    {
+        framerate->stats.dropped++;
+    }
+
+    framerate->first = (framerate->first + 1) % FRAMERATE_DEPTH;
+    framerate->frames--;
+}
+
+// Note a frame as seen
+static void mark_shown(framerate_t *framerate, int slot)
+{
+    if (!framerate->shown[slot])
+    {
+        framerate->shown[slot] = 1;
+        framerate->stats.shown++;
+    }
+}
+
+/**
+ * Create a frame rate converter.
+ *
+ * @param    count   Number of LEDs.
+ * @param    policy  FRAMERATE_xxx.
+ *
+ * @returns  Converter, NULL on bad arguments or if out of memory.
+ */
+framerate_t *framerate_create(int count, int policy)
+{
+    framerate_t *framerate;
+    int i;
+
+    if ((count < 0) || (policy < FRAMERATE_HOLD) || (policy > FRAMERATE_BLEND))
+    {
+        return NULL;
+    }
+
+    framerate = calloc(1, sizeof(*framerate));
+    if (!framerate)
+    {
+        return NULL;
+    }
+
+    framerate->count = count;
+    framerate->policy = policy;
+
+    for (i = 0; i < FRAMERATE_DEPTH; i++)
+    {
+        framerate->leds[i] = calloc(count ? count : 1, sizeof(*framerate->leds[i]));
+        if (!framerate->leds[i])
+        {
+            framerate_destroy(framerate);
+            return NULL;
+        }
+    }
+
+    if (policy == FRAMERATE_BLEND)
+    {
+        framerate->keyframe = keyframe_create(count);
+        if (!framerate->keyframe)
+        {
+            framerate_destroy(framerate);
+            return NULL;
+        }
+    }
+
+    return framerate;
+}
+
+/**
+ * Free a frame rate converter.
+ *
+ * @param    framerate  Converter, may be NULL.
+ *
+ * @returns  None
+ */
+void framerate_destroy(framerate_t *framerate)
+{
+    int i;
+
+    if (framerate)
+    {
+        for (i = 0; i < FRAMERATE_DEPTH; i++)
+        {
+            free(framerate->leds[i]);
+        }
+        keyframe_destroy(framerate->keyframe);
+        free(framerate);
+    }
+}
+
+/**
+ * Queue a frame.  Queued frames at or after its time are replaced.  If the
+ * queue is full, the oldest frame is dropped.
+ *
+ * @param    framerate  Converter.
+ * @param    leds       Colors of the frame, 0x00RRGGBB.
+ * @param    time_us    Time the frame is to be shown at.
+ *
+ * @returns  None
+ */
+void framerate_push(framerate_t *framerate, const ws2811_led_t *leds, uint64_t time_us)
+{
+    int slot;
+
+    framerate->stats.pushed++;
+    if (framerate->rendered && (time_us <= framerate->last_us))
+    {
+        framerate->stats.late++;
+    }
+
+    while (framerate->frames &&
+           (framerate->time_us[(framerate->first + framerate->frames - 1) % FRAMERATE_DEPTH] >= time_us))
+    {
+        framerate->frames--;
+        if (!framerate->shown[(framerate->first + framerate->frames) % FRAMERATE_DEPTH])
+        {
+            framerate->stats.dropped++;
+        }
+    }
+
+    if (framerate->frames == FRAMERATE_DEPTH)
+    {
+        drop_first(framerate);
+    }
+
+    slot = (framerate->first + framerate->frames) % FRAMERATE_DEPTH;
+    memcpy(framerate->leds[slot], leds, framerate->count * sizeof(*leds));
+    framerate->time_us[slot] = time_us;
+    framerate->id[slot] = framerate->next_id++;
+    framerate->shown[slot] = 0;
+    framerate->frames++;
+
+    if (framerate->keyframe)
+    {
+        keyframe_push(framerate->keyframe, leds, time_us);
+    }
+}
+
+/**
+ * Render the frame due at a show time.  Frames before the last one due by
+ * then are dropped, so show times must not go backwards.
+ *
+ * @param    framerate  Converter.
+ * @param    show_us    Time the render will reach the LEDs.
+ * @param    leds       Filled with the colors, 0x00RRGGBB, if they changed.
+ *
+ * @returns  1 if the colors were rendered, 0 if they are the same as last
+ *           time or no frame was pushed yet.
+ */
+int framerate_render(framerate_t *framerate, uint64_t show_us, ws2811_led_t *leds)
+{
+    uint64_t now_us = show_us, t0;
+    uint32_t weight = 0;
+    int from, to;
+
+    if (framerate->delay_us > 0)
+    {
+        now_us = (show_us > (uint64_t)framerate->delay_us) ? (show_us - framerate->delay_us) : 0;
+    }
+
+    if (!framerate->frames)
+    {
+        return 0;
+    }
+
+    while ((framerate->frames > 1) &&
+           (framerate->time_us[(framerate->first + 1) % FRAMERATE_DEPTH] <= now_us))
+    {
+        drop_first(framerate);
+    }
+
+    from = to = framerate->first;
+    t0 = framerate->time_us[from];
+    if ((framerate->frames > 1) && (now_us > t0))
+    {
+        int next = (from + 1) % FRAMERATE_DEPTH;
+        uint64_t span = framerate->time_us[next] - t0;
+
+        switch (framerate->policy)
+        {
+            case FRAMERATE_NEAREST:
+                if (((now_us - t0) * 2) >= span)
+                {
+                    from = to = next;
+                }
+                break;
+
+            case FRAMERATE_BLEND:
+                weight = ((now_us - t0) << BLEND_SHIFT) / span;
+                if (weight)
+                {
+                    to = next;
+                }
+                break;
+        }
+    }
+    else if ((framerate->policy == FRAMERATE_BLEND) && (now_us > t0))
+    {
+        framerate->stats.starved++;
+    }
+
+    framerate->last_us = now_us;
+
+    if (framerate->rendered && (framerate->id[from] == framerate->last_from) &&
+        (framerate->id[to] == framerate->last_to) && (weight == framerate->last_weight))
+    {
+        framerate->stats.duplicated++;
+        return 0;
+    }
+
+    mark_shown(framerate, from);
+    mark_shown(framerate, to);
+
+    if (weight)
+    {
+        keyframe_render(framerate->keyframe, now_us, leds);
+        framerate->stats.blended++;
+    }
+    else
+    {
+        memcpy(leds, framerate->leds[from], framerate->count * sizeof(*leds));
+    }
+
+    framerate->last_from = framerate->id[from];
+    framerate->last_to = framerate->id[to];
+    framerate->last_weight = weight;
+    framerate->rendered = 1;
+    framerate->stats.renders++;
+
+    return 1;
+}
@@ -0,0 +1,110 @@
+/*
+ * framerate.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __FRAMERATE_H__
+#define __FRAMERATE_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+#include "keyframe.h"
+
+
+/*
+ * Frame rate conversion.  Producers make frames at their own rate, 24, 25,
+ * 30, 50 or 60 per second, and the chain is refreshed at whatever rate it
+ * can be sent.  Each frame is pushed with the time it is meant to be seen,
+ * and each render picks what to show at the time the render will reach the
+ * LEDs, ws2811_show_time_ns(), rather than when it starts.  Content stays
+ * in step with its timestamps, so a 25 fps video on a 60 Hz chain shows
+ * each frame for two or three refreshes as the timestamps fall, not in
+ * whatever pattern the render loop happens to wake up in.
+ *
+ * The policy decides what a render between two frames shows:
+ *
+ *     FRAMERATE_HOLD     the last frame due, frames are repeated or dropped
+ *     FRAMERATE_NEAREST  the frame closest in time, halving the worst error
+ *     FRAMERATE_BLEND    a linear light crossfade of the two, see keyframe.h
+ *
+ * Blending needs the next frame before its time, so the producer should
+ * run a frame ahead, or delay_us set to one frame period.  A render that
+ * would show the same as the previous one returns 0 and leaves the LEDs
+ * alone, and the caller can skip ws2811_render() for it.
+ *
+ * Times are microseconds on CLOCK_MONOTONIC, the clock of the show time.
+ * Pushing and rendering must not run concurrently.
+ */
+
+#define FRAMERATE_HOLD                           0
+#define FRAMERATE_NEAREST                        1
+#define FRAMERATE_BLEND                          2
+
+#define FRAMERATE_DEPTH                          KEYFRAME_DEPTH  // Frames queued ahead of the show time
+
+typedef struct
+{
+    uint64_t pushed;                             //< Frames pushed
+    uint64_t shown;                              //< Frames shown at least once, alone or blended
+    uint64_t dropped;                            //< Frames replaced or passed before being shown
+    uint64_t late;                               //< Frames pushed after their show time had passed
+    uint64_t renders;                            //< Renders that changed the LEDs
+    uint64_t duplicated;                         //< Renders skipped as nothing changed
+    uint64_t blended;                            //< Renders that crossfaded two frames
+    uint64_t starved;                            //< Blending renders held as the next frame was missing
+} framerate_stats_t;
+
+typedef struct
+{
+    int count;                                   //< Number of LEDs
+    int policy;                                  //< FRAMERATE_xxx
+    int64_t delay_us;                            //< Shows frames this much after their time
+    int frames;                                  //< Frames queued
+    int first;                                   //< Oldest frame in the queue
+    uint64_t time_us[FRAMERATE_DEPTH];           //< Time each frame is shown at
+    uint64_t id[FRAMERATE_DEPTH];                //< Push order, tells frames in the same slot apart
+    int shown[FRAMERATE_DEPTH];                  //< Frame has been shown
+    ws2811_led_t *leds[FRAMERATE_DEPTH];         //< Colors of each frame
+    uint64_t next_id;
+    uint64_t last_us;                            //< Content time of the last render
+    uint64_t last_from, last_to;                 //< Frames the last render showed
+    uint32_t last_weight;                        //< And how far between them
+    int rendered;                                //< Some render changed the LEDs
+    keyframe_t *keyframe;                        //< Crossfades when blending
+    framerate_stats_t stats;
+} framerate_t;
+
+
+framerate_t *framerate_create(int count, int policy);
+void framerate_destroy(framerate_t *framerate);
+void framerate_push(framerate_t *framerate, const ws2811_led_t *leds, uint64_t time_us);
+int framerate_render(framerate_t *framerate, uint64_t show_us, ws2811_led_t *leds);
+
+
+#endif /* __FRAMERATE_H__ */
@@ -0,0 +1,534 @@
+/*
+ * fuzz.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "encode.h"
+#include "lut3d.h"
+
+
+/*
+ * Differential fuzz harness for the encoder kernels.  Every kernel must
+ * produce exactly the PCM output of the reference kernel.
+ *
+ *   fuzz [-n iterations] [-s seed] [-o mismatch.bin]
+ *   fuzz input...
+ *
+ * The first form feeds random inputs and minimises the first mismatch found,
+ * writing it to a file.  The second replays inputs and aborts on a mismatch,
+ * which is the form AFL runs ('afl-fuzz -i in -o out -- ./fuzz @@').  Built
+ * with -DFUZZ_LIBFUZZER only the libFuzzer entry point is compiled, see the
+ * fuzz-libfuzzer make target.
+ *
+ * An input is decoded as the channel settings followed by a script of frames,
+ * each either a full update, a partial update of a range of LEDs, or a change
+ * of brightness, strip type, inversion, power zones, color correction,
+ * calibration or gamma curves.  Bytes past the end of the input
+ * read as 0, so minimising simply drops and clears bytes.  Every other frame
+ * the color histograms used for power limiting are compared as well.
+ */
+
+
+#define ARRAY_SIZE(stuff)                        (sizeof(stuff) / sizeof(stuff[0]))
+
+#define FUZZ_MAX_LEDS                            1024
+#define FUZZ_MAX_FRAMES                          8
+#define FUZZ_MAX_ZONES                           4
+#define FUZZ_MAX_LUT3D                           17
+#define FUZZ_MAX_INPUT                           4096
+#define FUZZ_FILL                                0xa5a5a5a5  // Buffer contents before the first frame
+
+#define OP_FULL                                  0
+#define OP_PARTIAL                               1
+#define OP_BRIGHTNESS                            2
+#define OP_SETTINGS                              3
+#define OP_ZONES                                 4
+#define OP_LUT3D                                 5
+#define OP_CALIBRATION                           6
+#define OP_GAMMA                                 7
+#define OP_COUNT                                 8
+
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} input_t;
+
+static const int strip_types[] =
+{
+    WS2811_STRIP_RGB,
+    WS2811_STRIP_RBG,
+    WS2811_STRIP_GRB,
+    WS2811_STRIP_GBR,
+    WS2811_STRIP_BRG,
+    WS2811_STRIP_BGR,
+};
+
+
+static uint8_t input_u8(input_t *input)
+{
+    return (input->pos < input->size) ? input->data[input->pos++] : 0;
+}
+
+static uint32_t input_u16(input_t *input)
+{
+    uint32_t hi = input_u8(input);
+
+    return (hi << 8) | input_u8(input);
+}
+
+static uint32_t input_led(input_t *input)
+{
+    uint32_t r = input_u8(input);
+    uint32_t g = input_u8(input);
+
+    return (r << 16) | (g << 8) | input_u8(input);
+}
+
+/**
+ * Run one input through all kernels and compare against the reference.
+ *
+ * @param    data  Input bytes.
+ * @param    size  Input length.
+ * @param    why   Filled with a description of the first mismatch.
+ * @param    len   Size of why.
+ *
+ * @returns  0 if all kernels match, 1 on a mismatch, -1 if out of memory.
+ */
+static int fuzz_one(const uint8_t *data, size_t size, char *why, size_t len)
+{
+    input_t input = { data, size, 0 };
+    ws2811_channel_t channel = { 0 };
+    encoder_t encoders[encode_kernel_count];
+    encode_zone_t zones[encode_kernel_count][FUZZ_MAX_ZONES];
+    uint32_t *out[encode_kernel_count];
+    lut3d_t *lut = NULL;
+    ws2811_led_t *gains;
+    uint8_t curves[3 * 256];
+    uint32_t seed;
+    int words, frames, frame, k, w, i;
+    int ret = 0;
+
+    channel.count = input_u16(&input) % (FUZZ_MAX_LEDS + 1);
+    channel.brightness = input_u8(&input);
+    channel.strip_type = strip_types[input_u8(&input) % ARRAY_SIZE(strip_types)];
+    channel.invert = input_u8(&input) & 1;
+    frames = (input_u8(&input) % FUZZ_MAX_FRAMES) + 1;
+
+    // One spare word to check nothing is written past the last LED
+    words = ENCODE_WORDS(channel.count) + 1;
+
+    channel.leds = calloc(channel.count + 1, sizeof(*channel.leds));
+    gains = calloc(channel.count + 1, sizeof(*gains));
+    memset(out, 0, sizeof(out));
+    for (k = 0; k < encode_kernel_count; k++)
+    {
+        encoder_init(&encoders[k]);
+        encoders[k].zone = zones[k];
+        for (i = 0; i < FUZZ_MAX_ZONES; i++)
+        {
+            encode_zone_init(&zones[k][i], 0);
+        }
+        out[k] = malloc(words * sizeof(*out[k]));
+        if (out[k])
+        {
+            for (w = 0; w < words; w++)
+            {
+                out[k][w] = FUZZ_FILL;
+            }
+        }
+        else
+        {
+            ret = -1;
+        }
+    }
+    if (!channel.leds || !gains)
+    {
+        ret = -1;
+    }
+
+    for (frame = 0; (frame < frames) && !ret; frame++)
+    {
+        int op = input_u8(&input) % OP_COUNT;
+        int start, count;
+
+        switch (op)
+        {
+            case OP_FULL:
+                for (i = 0; i < channel.count; i++)
+                {
+                    channel.leds[i] = input_led(&input);
+                }
+                break;
+
+            case OP_PARTIAL:
+                if (channel.count)
+                {
+                    start = input_u16(&input) % channel.count;
+                    count = (input_u16(&input) % (channel.count - start)) + 1;
+                    for (i = start; i < start + count; i++)
+                    {
+                        channel.leds[i] = input_led(&input);
+                    }
+                }
+                break;
+
+            case OP_BRIGHTNESS:
+                channel.brightness = input_u8(&input);
+                break;
+
+            case OP_SETTINGS:
+                channel.strip_type = strip_types[input_u8(&input) % ARRAY_SIZE(strip_types)];
+                channel.invert = input_u8(&input) & 1;
+                break;
+
+            case OP_ZONES:
+                // Zones in LED order, the last one may stop short of the end
+                count = input_u8(&input) % (FUZZ_MAX_ZONES + 1);
+                start = 0;
+                for (i = 0; i < count; i++)
+                {
+                    int brightness = input_u8(&input);
+
+                    start += input_u16(&input) % (channel.count + 1);
+                    if (start > channel.count)
+                    {
+                        start = channel.count;
+                    }
+
+                    for (k = 0; k < encode_kernel_count; k++)
+                    {
+                        zones[k][i].end = start;
+                        zones[k][i].brightness = brightness;
+                    }
+                }
+                for (k = 0; k < encode_kernel_count; k++)
+                {
+                    encoders[k].zones = count;
+                }
+                break;
+
+            case OP_LUT3D:
+                // Size 0 turns correction off, the points are random from a seed
+                lut3d_destroy(lut);
+                count = input_u8(&input) % (FUZZ_MAX_LUT3D + 1);
+                seed = input_u16(&input);
+                lut = lut3d_create(count);
+                if (lut)
+                {
+                    for (i = 0; i < count * count * count; i++)
+                    {
+                        for (w = 0; w < 3; w++)
+                        {
+                            seed = (seed * 1103515245) + 12345;
+                            lut->table[i].c[w] = (seed >> 8) % (0xff00 + 1);
+                        }
+                    }
+                }
+                channel.lut3d = lut;
+                break;
+
+            case OP_CALIBRATION:
+                // Odd seeds turn calibration off, gains are random from the seed
+                seed = input_u16(&input);
+                channel.calibration = (seed & 1) ? NULL : gains;
+                for (i = 0; i < channel.count; i++)
+                {
+                    seed = (seed * 1103515245) + 12345;
+                    gains[i] = seed >> 8;
+                }
+                break;
+
+            case OP_GAMMA:
+                // Custom tables are random from the seed and edited in place
+                channel.gamma.curve = input_u8(&input) % (WS2811_GAMMA_CUSTOM + 2);
+                for (i = 0; i < 3; i++)
+                {
+                    channel.gamma.exponent[i] = input_u8(&input) / 32.0f;
+                }
+                seed = input_u16(&input);
+                channel.gamma.table = (seed & 1) ? NULL : curves;
+                for (i = 0; i < 3 * 256; i++)
+                {
+                    seed = (seed * 1103515245) + 12345;
+                    curves[i] = seed >> 16;
+                }
+                break;
+        }
+
+        for (k = 0; k < encode_kernel_count; k++)
+        {
+            memset(encoders[k].whole.hist, 0, sizeof(encoders[k].whole.hist));
+            for (i = 0; i < encoders[k].zones; i++)
+            {
+                memset(zones[k][i].hist, 0, sizeof(zones[k][i].hist));
+            }
+            encoders[k].histogram = frame & 1;
+            encode_kernels[k].encode(&encoders[k], &channel, out[k]);
+        }
+
+        for (k = 1; (k < encode_kernel_count) && !ret; k++)
+        {
+            for (w = 0; w < words; w++)
+            {
+                if (out[k][w] != out[0][w])
+                {
+                    snprintf(why, len, "kernel %s: %d leds, brightness %d, strip %06x, invert %d, "
+                             "frame %d: word %d is %08x, reference %08x",
+                             encode_kernels[k].name, channel.count, channel.brightness,
+                             channel.strip_type, channel.invert, frame, w, out[k][w], out[0][w]);
+                    ret = 1;
+                    break;
+                }
+            }
+
+            if (!ret && memcmp(encoders[k].whole.hist, encoders[0].whole.hist,
+                               sizeof(encoders[k].whole.hist)))
+            {
+                snprintf(why, len, "kernel %s: %d leds, frame %d: color histogram differs",
+                         encode_kernels[k].name, channel.count, frame);
+                ret = 1;
+            }
+
+            for (i = 0; (i < encoders[k].zones) && !ret; i++)
+            {
+                if (memcmp(zones[k][i].hist, zones[0][i].hist, sizeof(zones[k][i].hist)))
+                {
+                    snprintf(why, len, "kernel %s: %d leds, frame %d: zone %d color histogram differs",
+                             encode_kernels[k].name, channel.count, frame, i);
+                    ret = 1;
+                }
+            }
+        }
+    }
+
+    for (k = 0; k < encode_kernel_count; k++)
+    {
+        free(out[k]);
+    }
+    free(channel.leds);
+    free(gains);
+    lut3d_destroy(lut);
+
+    return ret;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    char why[256];
+
+    if (fuzz_one(data, size, why, sizeof(why)) > 0)
+    {
+        fprintf(stderr, "mismatch: %s\n", why);
+        abort();
+    }
+
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+    rnd_state = rnd_state * 1664525 + 1013904223;
+
+    return rnd_state >> 8;
+}
+
+/**
+ * Shrink an input while it still mismatches, first by dropping ever smaller
+ * chunks, then by clearing single bytes.
+ *
+ * @param    data  Mismatching input, modified in place.
+ * @param    size  Input length.
+ *
+ * @returns  Length of the minimised input.
+ */
+static size_t minimise(uint8_t *data, size_t size)
+{
+    uint8_t *trial = malloc(size ? size : 1);
+    char why[256];
+    size_t chunk, pos;
+
+    if (!trial)
+    {
+        return size;
+    }
+
+    for (chunk = size / 2; chunk > 0; chunk /= 2)
+    {
+        pos = 0;
+        while (pos + chunk <= size)
+        {
+            memcpy(trial, data, pos);
+            memcpy(trial + pos, data + pos + chunk, size - pos - chunk);
+            if (fuzz_one(trial, size - chunk, why, sizeof(why)) > 0)
+            {
+                memcpy(data, trial, size - chunk);
+                size -= chunk;
+            }
+            else
+            {
+                pos += chunk;
+            }
+        }
+    }
+
+    for (pos = 0; pos < size; pos++)
+    {
+        uint8_t byte = data[pos];
+
+        if (byte)
+        {
+            data[pos] = 0;
+            if (fuzz_one(data, size, why, sizeof(why)) <= 0)
+            {
+                data[pos] = byte;
+            }
+        }
+    }
+
+    free(trial);
+
+    return size;
+}
+
+static int replay(const char *path)
+{
+    static uint8_t data[FUZZ_MAX_INPUT];
+    FILE *file = fopen(path, "rb");
+    size_t size;
+
+    if (!file)
+    {
+        perror(path);
+        return -1;
+    }
+    size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+
+    return LLVMFuzzerTestOneInput(data, size);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n iterations] [-s seed] [-o mismatch.bin]\n"
+                    "       %s input...\n", prog, prog);
+}
+
+int main(int argc, char *argv[])
+{
+    static uint8_t data[FUZZ_MAX_INPUT];
+    const char *output = "mismatch.bin";
+    unsigned long iterations = 100000, n;
+    char why[256];
+    size_t size, i;
+    FILE *file;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                rnd_state = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind < argc)
+    {
+        for (; optind < argc; optind++)
+        {
+            if (replay(argv[optind]))
+            {
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    for (n = 0; n < iterations; n++)
+    {
+        // Mostly short inputs, the LED count comes from the first bytes
+        size = rnd() % ((n & 7) ? 64 : FUZZ_MAX_INPUT);
+        for (i = 0; i < size; i++)
+        {
+            data[i] = rnd();
+        }
+
+        if (fuzz_one(data, size, why, sizeof(why)) > 0)
+        {
+            size = minimise(data, size);
+            fuzz_one(data, size, why, sizeof(why));
+
+            fprintf(stderr, "mismatch after %lu inputs: %s\ninput:", n + 1, why);
+            for (i = 0; i < size; i++)
+            {
+                fprintf(stderr, " %02x", data[i]);
+            }
+            fprintf(stderr, "\n");
+
+            file = fopen(output, "wb");
+            if (file)
+            {
+                fwrite(data, 1, size, file);
+                fclose(file);
+                fprintf(stderr, "written to %s\n", output);
+            }
+
+            return 1;
+        }
+    }
+
+    fprintf(stderr, "%lu inputs, %d kernels match the reference\n", iterations, encode_kernel_count - 1);
+
+    return 0;
+}
+
+#endif /* FUZZ_LIBFUZZER */
@@ -0,0 +1,240 @@
+/*
+ * gamma.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gamma.h"
+
+
+/*
+ * The library doesn't link libm, so the power curve comes from a log and
+ * exp of its own, good to far better than the 8 bit tables need.
+ */
+
+#define LN2                                      0.69314718055994530942
+#define EXPONENT_MAX                             10.0
+
+
+// The curve the library always used, and still the default
+static const uint8_t gamma_default[256] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2,
+    2, 2, 2, 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5,
+    6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 11, 11,
+    11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16, 17, 17, 18, 18,
+    19, 19, 20, 21, 21, 22, 22, 23, 23, 24, 25, 25, 26, 27, 27, 28,
+    29, 29, 30, 31, 31, 32, 33, 34, 34, 35, 36, 37, 37, 38, 39, 40,
+    40, 41, 42, 43, 44, 45, 46, 46, 47, 48, 49, 50, 51, 52, 53, 54,
+    55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70,
+    71, 72, 73, 74, 76, 77, 78, 79, 80, 81, 83, 84, 85, 86, 88, 89,
+    90, 91, 93, 94, 95, 96, 98, 99,100,102,103,104,106,107,109,110,
+    111,113,114,116,117,119,120,121,123,124,126,128,129,131,132,134,
+    135,137,138,140,142,143,145,146,148,150,151,153,155,157,158,160,
+    162,163,165,167,169,170,172,174,176,178,179,181,183,185,187,189,
+    191,193,194,196,198,200,202,204,206,208,210,212,214,216,218,220,
+    222,224,227,229,231,233,235,237,239,241,244,246,248,250,252,255
+};
+
+
+// Natural log of x > 0
+static double log_e(double x)
+{
+    double y, y2, term, sum = 0.0;
+    int k = 0, n;
+
+    while (x > 2.0)
+    {
+        x /= 2.0;
+        k++;
+    }
+    while (x < 0.5)
+    {
+        x *= 2.0;
+        k--;
+    }
+
+    // ln(x) = 2 atanh((x - 1) / (x + 1)), |y| is at most 1/3 here
+    y = (x - 1.0) / (x + 1.0);
+    y2 = y * y;
+    term = y;
+    for (n = 1; n < 40; n += 2)
+    {
+        sum += term / n;
+        term *= y2;
+    }
+
+    return (2.0 * sum) + (k * LN2);
+}
+
+// e to the power of x <= 0
+static double exp_e(double x)
+{
+    double term = 1.0, sum = 1.0;
+    int k = 0, n;
+
+    while (x < -0.5)
+    {
+        x += LN2;
+        k++;
+    }
+
+    for (n = 1; n < 24; n++)
+    {
+        term *= x / n;
+        sum += term;
+    }
+
+    while (k--)
+    {
+        sum /= 2.0;
+    }
+
+    return sum;
+}
+
+// CIE 1931 luminance of a lightness from 0 to 1
+static double cie_luminance(double lightness)
+{
+    double l = lightness * 100.0;
+
+    if (l <= 8.0)
+    {
+        return l / 903.3;
+    }
+
+    l = (l + 16.0) / 116.0;
+    return l * l * l;
+}
+
+static uint8_t unit_byte(double x)
+{
+    x = (x * 255.0) + 0.5;
+
+    return (x >= 255.0) ? 255 : ((x <= 0.0) ? 0 : (uint8_t)x);
+}
+
+static int config_equal(const ws2811_gamma_t *a, const ws2811_gamma_t *b)
+{
+    if (a->curve != b->curve)
+    {
+        return 0;
+    }
+
+    switch (a->curve)
+    {
+        case WS2811_GAMMA_POWER:
+            return !memcmp(a->exponent, b->exponent, sizeof(a->exponent));
+
+        case WS2811_GAMMA_CUSTOM:
+            return a->table == b->table;
+
+        default:
+            return 1;
+    }
+}
+
+
+/**
+ * Build red, green and blue gamma tables.
+ *
+ * @param    table   Filled with the tables.
+ * @param    config  Curve settings.  Exponents of 0 or less are taken as 1,
+ *                   an unknown curve or a custom curve without a table as
+ *                   the default.
+ *
+ * @returns  None
+ */
+void gamma_build(uint8_t table[3][256], const ws2811_gamma_t *config)
+{
+    int color, value;
+
+    for (color = 0; color < 3; color++)
+    {
+        double exponent = config->exponent[color];
+
+        exponent = (exponent <= 0.0) ? 1.0 : ((exponent > EXPONENT_MAX) ? EXPONENT_MAX : exponent);
+
+        for (value = 0; value < 256; value++)
+        {
+            double x = value / 255.0;
+
+            switch (config->curve)
+            {
+                case WS2811_GAMMA_POWER:
+                    table[color][value] = value ? unit_byte(exp_e(exponent * log_e(x))) : 0;
+                    break;
+
+                case WS2811_GAMMA_CIE:
+                    table[color][value] = unit_byte(cie_luminance(x));
+                    break;
+
+                case WS2811_GAMMA_CUSTOM:
+                    table[color][value] = config->table ? config->table[(color * 256) + value] :
+                                                          gamma_default[value];
+                    break;
+
+                default:
+                    table[color][value] = gamma_default[value];
+                    break;
+            }
+        }
+    }
+}
+
+/**
+ * Rebuild gamma tables if the settings changed since they were built.  A
+ * custom table is compared by content, so it can be edited in place.
+ *
+ * @param    lut     Tables, zeroed before the first call.
+ * @param    config  Curve settings.
+ *
+ * @returns  1 if the tables were rebuilt, 0 if they were up to date.
+ */
+int gamma_update(gamma_lut_t *lut, const ws2811_gamma_t *config)
+{
+    if (lut->serial && config_equal(&lut->config, config) &&
+        ((config->curve != WS2811_GAMMA_CUSTOM) || !config->table ||
+         !memcmp(lut->table, config->table, sizeof(lut->table))))
+    {
+        return 0;
+    }
+
+    gamma_build(lut->table, config);
+    lut->config = *config;
+    lut->serial++;
+    if (!lut->serial)
+    {
+        lut->serial = 1;
+    }
+
+    return 1;
+}
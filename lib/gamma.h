@@ -1,20 +1,58 @@
-#ifndef GAMMA_H
-#define GAMMA_H
-const uint8_t ws281x_gamma[] = {
-0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2,
-2, 2, 2, 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5,
-6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 11, 11,
-11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16, 17, 17, 18, 18,
-19, 19, 20, 21, 21, 22, 22, 23, 23, 24, 25, 25, 26, 27, 27, 28,
-29, 29, 30, 31, 31, 32, 33, 34, 34, 35, 36, 37, 37, 38, 39, 40,
-40, 41, 42, 43, 44, 45, 46, 46, 47, 48, 49, 50, 51, 52, 53, 54,
-55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70,
-71, 72, 73, 74, 76, 77, 78, 79, 80, 81, 83, 84, 85, 86, 88, 89,
-90, 91, 93, 94, 95, 96, 98, 99,100,102,103,104,106,107,109,110,
-111,113,114,116,117,119,120,121,123,124,126,128,129,131,132,134,
-135,137,138,140,142,143,145,146,148,150,151,153,155,157,158,160,
-162,163,165,167,169,170,172,174,176,178,179,181,183,185,187,189,
-191,193,194,196,198,200,202,204,206,208,210,212,214,216,218,220,
-222,224,227,229,231,233,235,237,239,241,244,246,248,250,252,255};
-#endif
+/*
+ * gamma.h
+ *
+ * Copyright (c) 2016 Ton van Overbeek <tvoverbeek @ gmail.com>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __GAMMA_H__
+#define __GAMMA_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+
+
+/*
+ * Gamma tables built at run time from a channel's ws2811_gamma_t settings,
+ * one for each of red, green and blue.  gamma_update() compares the settings
+ * with the ones the tables were built for and only rebuilds on a change, so
+ * it can be called every frame.
+ */
+
+typedef struct
+{
+    ws2811_gamma_t config;                       //< Settings the tables are built for
+    unsigned serial;                             //< Bumped on every rebuild, 0 before the first
+    uint8_t table[3][256];                       //< Red, green and blue
+} gamma_lut_t;
+
+
+void gamma_build(uint8_t table[3][256], const ws2811_gamma_t *config);
+int gamma_update(gamma_lut_t *lut, const ws2811_gamma_t *config);
+
+
+#endif /* __GAMMA_H__ */
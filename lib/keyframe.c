@@ -0,0 +1,310 @@
+/*
+ * keyframe.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "keyframe.h"
+
+
+/*
+ * Linear light follows a square law of the color value, close to the response
+ * of the eye and cheap to invert without floating point.  Linear light is 16
+ * bit, and going back to colors is a table lookup on its top 12 bits with the
+ * low 4 interpolated, giving 8.8 fixed point colors.  The curve is too steep
+ * near black for that, so the darkest values have a table of their own.  The blend itself is a
+ * plain weighted sum over all red, green and blue values, which the compiler
+ * vectorizes.
+ *
+ * Dithering adds a threshold before dropping the fraction.  Each LED steps
+ * through all 256 thresholds in bit reversed order, one per render, so its
+ * average over a few renders is the exact color, and neighbouring LEDs are at
+ * different points of the sequence.
+ */
+
+#define BLEND_SHIFT                              15
+#define BLEND_ONE                                (1 << BLEND_SHIFT)
+#define DITHER_SPREAD                            89          // Sequence offset between neighbouring LEDs
+
+
+static uint32_t isqrt64(uint64_t x)
+{
+    uint64_t root = 0, bit = 1ULL << 62;
+
+    while (bit > x)
+    {
+        bit >>= 2;
+    }
+
+    while (bit)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+// Linear light to 8.8 fixed point color
+static inline uint32_t linear_color(const keyframe_t *keyframe, uint32_t linear)
+{
+    uint32_t step = linear >> 4;
+    uint32_t low = keyframe->to_color[step], high = keyframe->to_color[step + 1];
+
+    if (linear < KEYFRAME_LINEAR_DARK)
+    {
+        return keyframe->to_color_dark[linear];
+    }
+
+    return low + (((high - low) * (linear & 0xf)) >> 4);
+}
+
+// 8.8 fixed point color of a linear light value
+static uint16_t color_of(uint64_t linear)
+{
+    return isqrt64(((linear * 65280 * 65280) + (65535 / 2)) / 65535);
+}
+
+/**
+ * Create a keyframe queue.
+ *
+ * @param    count  Number of LEDs.
+ *
+ * @returns  Queue, NULL on bad arguments or if out of memory.
+ */
+keyframe_t *keyframe_create(int count)
+{
+    keyframe_t *keyframe;
+    int i, bit;
+
+    if (count < 0)
+    {
+        return NULL;
+    }
+
+    keyframe = calloc(1, sizeof(*keyframe));
+    if (!keyframe)
+    {
+        return NULL;
+    }
+
+    keyframe->count = count;
+    keyframe->blend = calloc(count ? (count * 3) : 1, sizeof(*keyframe->blend));
+    if (!keyframe->blend)
+    {
+        keyframe_destroy(keyframe);
+        return NULL;
+    }
+
+    for (i = 0; i < KEYFRAME_DEPTH; i++)
+    {
+        keyframe->linear[i] = calloc(count ? (count * 3) : 1, sizeof(*keyframe->linear[i]));
+        if (!keyframe->linear[i])
+        {
+            keyframe_destroy(keyframe);
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        keyframe->to_linear[i] = (((uint32_t)i * i * 65535) + (65025 / 2)) / 65025;
+
+        keyframe->threshold[i] = 0;
+        for (bit = 0; bit < 8; bit++)
+        {
+            keyframe->threshold[i] |= ((i >> bit) & 1) << (7 - bit);
+        }
+    }
+
+    for (i = 0; i <= KEYFRAME_LINEAR_STEPS; i++)
+    {
+        uint64_t linear = (uint64_t)i * (65536 / KEYFRAME_LINEAR_STEPS);
+
+        keyframe->to_color[i] = color_of((linear > 65535) ? 65535 : linear);
+    }
+
+    for (i = 0; i < KEYFRAME_LINEAR_DARK; i++)
+    {
+        keyframe->to_color_dark[i] = color_of(i);
+    }
+
+    return keyframe;
+}
+
+/**
+ * Free a keyframe queue.
+ *
+ * @param    keyframe  Queue, may be NULL.
+ *
+ * @returns  None
+ */
+void keyframe_destroy(keyframe_t *keyframe)
+{
+    int i;
+
+    if (keyframe)
+    {
+        for (i = 0; i < KEYFRAME_DEPTH; i++)
+        {
+            free(keyframe->linear[i]);
+        }
+        free(keyframe->blend);
+        free(keyframe);
+    }
+}
+
+/**
+ * Queue a keyframe.  Queued keyframes at or after its time are replaced.  If
+ * the queue is full, the oldest keyframe is dropped.
+ *
+ * @param    keyframe  Queue.
+ * @param    leds      Colors of the keyframe, 0x00RRGGBB.
+ * @param    time_us   Time the keyframe is to be shown at.
+ *
+ * @returns  None
+ */
+void keyframe_push(keyframe_t *keyframe, const ws2811_led_t *leds, uint64_t time_us)
+{
+    const uint16_t *to_linear = keyframe->to_linear;
+    uint16_t *linear;
+    int slot, i;
+
+    while (keyframe->frames &&
+           (keyframe->time_us[(keyframe->first + keyframe->frames - 1) % KEYFRAME_DEPTH] >= time_us))
+    {
+        keyframe->frames--;
+    }
+
+    if (keyframe->frames == KEYFRAME_DEPTH)
+    {
+        keyframe->first = (keyframe->first + 1) % KEYFRAME_DEPTH;
+        keyframe->frames--;
+    }
+
+    slot = (keyframe->first + keyframe->frames) % KEYFRAME_DEPTH;
+    linear = keyframe->linear[slot];
+    for (i = 0; i < keyframe->count; i++)
+    {
+        linear[(i * 3) + 0] = to_linear[(leds[i] >> 16) & 0xff];
+        linear[(i * 3) + 1] = to_linear[(leds[i] >> 8) & 0xff];
+        linear[(i * 3) + 2] = to_linear[leds[i] & 0xff];
+    }
+
+    keyframe->time_us[slot] = time_us;
+    keyframe->frames++;
+}
+
+/**
+ * Render the colors at a point in time.  Keyframes before the last one at or
+ * before that time are dropped, so times must not go backwards.
+ *
+ * @param    keyframe  Queue.
+ * @param    now_us    Time to render.
+ * @param    leds      Filled with the colors, 0x00RRGGBB.
+ *
+ * @returns  1 if the colors were rendered, 0 if no keyframe was pushed yet.
+ */
+int keyframe_render(keyframe_t *keyframe, uint64_t now_us, ws2811_led_t *leds)
+{
+    const uint16_t *linear;
+    int values = keyframe->count * 3;
+    int i;
+
+    if (!keyframe->frames)
+    {
+        return 0;
+    }
+
+    while ((keyframe->frames > 1) &&
+           (keyframe->time_us[(keyframe->first + 1) % KEYFRAME_DEPTH] <= now_us))
+    {
+        keyframe->first = (keyframe->first + 1) % KEYFRAME_DEPTH;
+        keyframe->frames--;
+    }
+
+    linear = keyframe->linear[keyframe->first];
+    if ((keyframe->frames > 1) && (now_us > keyframe->time_us[keyframe->first]))
+    {
+        int next = (keyframe->first + 1) % KEYFRAME_DEPTH;
+        const uint16_t *from = linear, *to = keyframe->linear[next];
+        uint64_t span = keyframe->time_us[next] - keyframe->time_us[keyframe->first];
+        uint32_t weight = ((now_us - keyframe->time_us[keyframe->first]) << BLEND_SHIFT) / span;
+        uint32_t keep = BLEND_ONE - weight;
+        uint16_t *blend = keyframe->blend;
+
+        for (i = 0; i < values; i++)
+        {
+            blend[i] = ((from[i] * keep) + (to[i] * weight) + (BLEND_ONE / 2)) >> BLEND_SHIFT;
+        }
+
+        linear = blend;
+    }
+
+    if (keyframe->dither)
+    {
+        const uint8_t *threshold = keyframe->threshold;
+        uint32_t frame = keyframe->frame;
+
+        for (i = 0; i < keyframe->count; i++)
+        {
+            uint32_t t = threshold[(frame + (i * DITHER_SPREAD)) & 0xff];
+            uint32_t r = (linear_color(keyframe, linear[(i * 3) + 0]) + t) >> 8;
+            uint32_t g = (linear_color(keyframe, linear[(i * 3) + 1]) + t) >> 8;
+            uint32_t b = (linear_color(keyframe, linear[(i * 3) + 2]) + t) >> 8;
+
+            leds[i] = (r << 16) | (g << 8) | b;
+        }
+    }
+    else
+    {
+        for (i = 0; i < keyframe->count; i++)
+        {
+            uint32_t r = (linear_color(keyframe, linear[(i * 3) + 0]) + 0x80) >> 8;
+            uint32_t g = (linear_color(keyframe, linear[(i * 3) + 1]) + 0x80) >> 8;
+            uint32_t b = (linear_color(keyframe, linear[(i * 3) + 2]) + 0x80) >> 8;
+
+            leds[i] = (r << 16) | (g << 8) | b;
+        }
+    }
+
+    keyframe->frame++;
+
+    return 1;
+}
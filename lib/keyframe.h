@@ -0,0 +1,78 @@
+/*
+ * keyframe.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __KEYFRAME_H__
+#define __KEYFRAME_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+
+
+/*
+ * Keyframe crossfading.  A producer pushes timestamped keyframes at its own
+ * rate, and every render interpolates between the two keyframes around the
+ * current time, so the chain can be refreshed as fast as it can be sent.
+ * Blending is done in linear light, where a crossfade between two colors
+ * doesn't dip in brightness halfway.  Keyframes are queued until their time
+ * has passed, the newest is held once all have.
+ *
+ * Times are in microseconds on any clock, as long as pushes and renders use
+ * the same.  Pushing and rendering must not run concurrently.
+ */
+
+#define KEYFRAME_DEPTH                           4           // Keyframes queued ahead of the render time
+#define KEYFRAME_LINEAR_STEPS                    4096        // Entries of the linear to color table
+#define KEYFRAME_LINEAR_DARK                     256         // Linear values looked up exactly
+
+typedef struct
+{
+    int count;                                   //< Number of LEDs
+    int dither;                                  //< Dither the fraction lost going back to 8 bit colors
+    int frames;                                  //< Keyframes queued
+    int first;                                   //< Oldest keyframe in the queue
+    uint64_t time_us[KEYFRAME_DEPTH];            //< Time each keyframe is shown at
+    uint16_t *linear[KEYFRAME_DEPTH];            //< Red, green and blue of each LED in linear light
+    uint16_t *blend;                             //< Interpolated linear light
+    uint32_t frame;                              //< Renders so far, moves the dither pattern
+    uint16_t to_linear[256];                     //< Color value to linear light
+    uint16_t to_color[KEYFRAME_LINEAR_STEPS + 1]; //< Linear light to 8.8 color value
+    uint16_t to_color_dark[KEYFRAME_LINEAR_DARK]; //< Same for the darkest values, where the curve is steep
+    uint8_t threshold[256];                      //< Dither thresholds in low discrepancy order
+} keyframe_t;
+
+
+keyframe_t *keyframe_create(int count);
+void keyframe_destroy(keyframe_t *keyframe);
+void keyframe_push(keyframe_t *keyframe, const ws2811_led_t *leds, uint64_t time_us);
+int keyframe_render(keyframe_t *keyframe, uint64_t now_us, ws2811_led_t *leds);
+
+
+#endif /* __KEYFRAME_H__ */
@@ -0,0 +1,127 @@
+/*
+ * latency.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency.h"
+
+
+/**
+ * Tag a frame that was just handed to the DMA.
+ *
+ * @param    latency  Latency state.
+ * @param    submit   Time of the render call.
+ * @param    encoded  Time the PCM buffer was encoded.
+ * @param    started  Time the DMA was started.
+ *
+ * @returns  None
+ */
+void latency_frame_start(latency_t *latency, uint64_t submit, uint64_t encoded, uint64_t started)
+{
+    latency->pending = 1;
+    latency->submit = submit;
+    latency->encoded = encoded;
+    latency->started = started;
+}
+
+/**
+ * Complete the measurement of the frame on the wire.  The last bit leaves the
+ * PCM one wire time after the DMA start, unless the DMA was seen finishing
+ * later than that, for instance because it was starved of bus bandwidth.
+ *
+ * @param    latency   Latency state.
+ * @param    observed  Time the last bit was observed to be out, 0 if unknown.
+ *
+ * @returns  Non-zero when the percentiles are due for an update.
+ */
+int latency_frame_done(latency_t *latency, uint64_t observed)
+{
+    unsigned slot = latency->count % LATENCY_WINDOW;
+    uint64_t done = latency->started + latency->wire_ns;
+
+    if (!latency->pending)
+    {
+        return 0;
+    }
+    latency->pending = 0;
+
+    if (observed > done)
+    {
+        done = observed;
+    }
+
+    latency->samples[WS2811_LATENCY_ENCODE][slot] = latency->encoded - latency->submit;
+    latency->samples[WS2811_LATENCY_QUEUE][slot] = latency->started - latency->encoded;
+    latency->samples[WS2811_LATENCY_WIRE][slot] = done - latency->started;
+    latency->samples[WS2811_LATENCY_TOTAL][slot] = done - latency->submit;
+    latency->count++;
+
+    return !(latency->count % LATENCY_REFRESH);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Compute the percentiles over the most recent frames.
+ *
+ * @param    latency  Latency state.
+ * @param    result   Array of WS2811_LATENCY_COUNT results.
+ *
+ * @returns  None
+ */
+void latency_percentiles(latency_t *latency, ws2811_latency_t *result)
+{
+    unsigned n = latency->count < LATENCY_WINDOW ? latency->count : LATENCY_WINDOW;
+    uint64_t sorted[LATENCY_WINDOW];
+    int i;
+
+    if (!n)
+    {
+        return;
+    }
+
+    for (i = 0; i < WS2811_LATENCY_COUNT; i++)
+    {
+        memcpy(sorted, latency->samples[i], n * sizeof(sorted[0]));
+        qsort(sorted, n, sizeof(sorted[0]), cmp_u64);
+
+        result[i].p50 = sorted[(n * 50) / 100];
+        result[i].p95 = sorted[(n * 95) / 100];
+        result[i].p99 = sorted[(n * 99) / 100];
+        result[i].max = sorted[n - 1];
+    }
+}
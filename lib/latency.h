@@ -0,0 +1,57 @@
+/*
+ * latency.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include "ws2811-pcm.h"
+
+
+#define LATENCY_WINDOW                           256   // Frames the percentiles are taken over
+#define LATENCY_REFRESH                          16    // Frames between percentile updates
+
+typedef struct
+{
+    int pending;                                 //< A frame is on the wire
+    uint64_t submit;                             //< Render call, monotonic nanoseconds
+    uint64_t encoded;                            //< Encode done
+    uint64_t started;                            //< DMA started
+    uint64_t wire_ns;                            //< Time to clock out the whole PCM buffer
+    unsigned count;                              //< Frames measured
+    uint64_t samples[WS2811_LATENCY_COUNT][LATENCY_WINDOW];
+} latency_t;
+
+
+void latency_frame_start(latency_t *latency, uint64_t submit, uint64_t encoded, uint64_t started);
+int latency_frame_done(latency_t *latency, uint64_t observed);
+void latency_percentiles(latency_t *latency, ws2811_latency_t *result);
+
+
+#endif /* __LATENCY_H__ */
@@ -0,0 +1,357 @@
+/*
+ * lut3d.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lut3d.h"
+
+
+/*
+ * A color value v lies at v * (size - 1) / 255 along an axis, so in cell
+ * index[v] at weight[v] / 256 of the way to the next point.  The cell is split
+ * into six tetrahedra along its diagonal, and the one holding the color is
+ * picked by the order of the three weights.  Its four corners are blended
+ * with weights summing to 256, the same for all four lanes of a point, which
+ * the compiler turns into one vector multiply-accumulate per corner.
+ */
+
+#define LINE_WIDTH_MAX                           256
+
+
+/**
+ * Interpolate one color.
+ *
+ * @param    lut    Cube.
+ * @param    color  Color, 0x00RRGGBB.
+ *
+ * @returns  Corrected color, 0x00RRGGBB.
+ */
+static inline ws2811_led_t lut3d_interpolate(const lut3d_t *lut, ws2811_led_t color)
+{
+    uint8_t r = color >> 16, g = color >> 8, b = color;
+    int size = lut->size;
+    int fa = lut->weight[r], fb = lut->weight[g], fc = lut->weight[b];
+    int sa = 1, sb = size, sc = size * size;
+    const lut3d_entry_t *p0, *p1, *p2, *p3;
+    uint32_t w0, w1, w2, w3, acc[4];
+    int t, k;
+
+    p0 = &lut->table[lut->index[r] + (lut->index[g] * sb) + (lut->index[b] * sc)];
+
+    // Sort the weights, with their axis strides, into fa >= fb >= fc
+    if (fa < fb)
+    {
+        t = fa; fa = fb; fb = t;
+        t = sa; sa = sb; sb = t;
+    }
+    if (fb < fc)
+    {
+        t = fb; fb = fc; fc = t;
+        t = sb; sb = sc; sc = t;
+    }
+    if (fa < fb)
+    {
+        t = fa; fa = fb; fb = t;
+        t = sa; sa = sb; sb = t;
+    }
+
+    p1 = p0 + sa;
+    p2 = p1 + sb;
+    p3 = p2 + sc;
+    w0 = 256 - fa;
+    w1 = fa - fb;
+    w2 = fb - fc;
+    w3 = fc;
+
+    for (k = 0; k < 4; k++)
+    {
+        acc[k] = (w0 * p0->c[k]) + (w1 * p1->c[k]) + (w2 * p2->c[k]) + (w3 * p3->c[k]) + 0x8000;
+    }
+
+    return ((acc[0] >> 16) << 16) | ((acc[1] >> 16) << 8) | (acc[2] >> 16);
+}
+
+/**
+ * Create a cube that leaves colors unchanged.
+ *
+ * @param    size  Points along each axis, LUT3D_SIZE_MIN to LUT3D_SIZE_MAX.
+ *
+ * @returns  Cube, NULL on bad arguments or if out of memory.
+ */
+lut3d_t *lut3d_create(int size)
+{
+    lut3d_t *lut;
+    int v, r, g, b;
+
+    if ((size < LUT3D_SIZE_MIN) || (size > LUT3D_SIZE_MAX))
+    {
+        return NULL;
+    }
+
+    lut = calloc(1, sizeof(*lut));
+    if (!lut)
+    {
+        return NULL;
+    }
+
+    lut->size = size;
+    lut->table = calloc(size * size * size, sizeof(*lut->table));
+    if (!lut->table)
+    {
+        free(lut);
+        return NULL;
+    }
+
+    for (v = 0; v < 256; v++)
+    {
+        int pos = v * (size - 1);
+        int cell = pos / 255;
+
+        // The last point has no cell after it, use the end of the one before
+        if (cell == size - 1)
+        {
+            lut->index[v] = cell - 1;
+            lut->weight[v] = 256;
+        }
+        else
+        {
+            lut->index[v] = cell;
+            lut->weight[v] = (((pos % 255) * 256) + 127) / 255;
+        }
+    }
+
+    for (b = 0; b < size; b++)
+    {
+        for (g = 0; g < size; g++)
+        {
+            for (r = 0; r < size; r++)
+            {
+                lut3d_set(lut, r, g, b, (float)r / (size - 1), (float)g / (size - 1),
+                          (float)b / (size - 1));
+            }
+        }
+    }
+
+    return lut;
+}
+
+/**
+ * Load a cube from a .cube file, as written by most color grading tools.
+ * Only 3D tables are supported, and the domain must be 0 to 1.
+ *
+ * @param    path  File name.
+ *
+ * @returns  Cube, NULL if the file can't be read or isn't a 3D .cube file.
+ */
+lut3d_t *lut3d_load_cube(const char *path)
+{
+    FILE *in = fopen(path, "r");
+    char line[LINE_WIDTH_MAX];
+    lut3d_t *lut = NULL;
+    int points = 0, total = 0;
+    int complete;
+
+    if (!in)
+    {
+        return NULL;
+    }
+
+    while (fgets(line, sizeof(line), in))
+    {
+        float red, green, blue;
+        int size;
+
+        if ((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r') || !strncmp(line, "TITLE", 5))
+        {
+            continue;
+        }
+
+        if (sscanf(line, "LUT_3D_SIZE %d", &size) == 1)
+        {
+            if (lut)
+            {
+                break;
+            }
+
+            lut = lut3d_create(size);
+            if (!lut)
+            {
+                break;
+            }
+            total = size * size * size;
+            continue;
+        }
+
+        if (sscanf(line, "DOMAIN_MIN %f %f %f", &red, &green, &blue) == 3)
+        {
+            if ((red != 0.0f) || (green != 0.0f) || (blue != 0.0f))
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (sscanf(line, "DOMAIN_MAX %f %f %f", &red, &green, &blue) == 3)
+        {
+            if ((red != 1.0f) || (green != 1.0f) || (blue != 1.0f))
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (sscanf(line, "%f %f %f", &red, &green, &blue) != 3)
+        {
+            break;
+        }
+
+        if (!lut || (points >= total))
+        {
+            break;
+        }
+
+        lut3d_set(lut, points % lut->size, (points / lut->size) % lut->size,
+                  points / (lut->size * lut->size), red, green, blue);
+        points++;
+    }
+
+    complete = feof(in);
+    fclose(in);
+
+    if (!lut || (points != total) || !complete)
+    {
+        lut3d_destroy(lut);
+        return NULL;
+    }
+
+    return lut;
+}
+
+/**
+ * Free a cube.
+ *
+ * @param    lut  Cube, may be NULL.
+ *
+ * @returns  None
+ */
+void lut3d_destroy(lut3d_t *lut)
+{
+    if (lut)
+    {
+        free(lut->table);
+        free(lut);
+    }
+}
+
+/**
+ * Set one point of the cube.
+ *
+ * @param    lut    Cube.
+ * @param    r      Point along the red axis, 0 to size - 1.
+ * @param    g      Point along the green axis.
+ * @param    b      Point along the blue axis.
+ * @param    red    Red output at the point, 0.0 to 1.0, clamped.
+ * @param    green  Green output.
+ * @param    blue   Blue output.
+ *
+ * @returns  None
+ */
+void lut3d_set(lut3d_t *lut, int r, int g, int b, float red, float green, float blue)
+{
+    float out[3] = { red, green, blue };
+    lut3d_entry_t *entry;
+    int k;
+
+    if ((r < 0) || (g < 0) || (b < 0) || (r >= lut->size) || (g >= lut->size) || (b >= lut->size))
+    {
+        return;
+    }
+
+    entry = &lut->table[r + (g * lut->size) + (b * lut->size * lut->size)];
+    for (k = 0; k < 3; k++)
+    {
+        float v = (out[k] < 0.0f) ? 0.0f : ((out[k] > 1.0f) ? 1.0f : out[k]);
+
+        entry->c[k] = (uint16_t)((v * (255.0f * 256.0f)) + 0.5f);
+    }
+    entry->c[3] = 0;
+}
+
+/**
+ * Correct one color.
+ *
+ * @param    lut    Cube.
+ * @param    color  Color, 0x00RRGGBB.
+ *
+ * @returns  Corrected color, 0x00RRGGBB.
+ */
+ws2811_led_t lut3d_color(const lut3d_t *lut, ws2811_led_t color)
+{
+    return lut3d_interpolate(lut, color & 0xffffff);
+}
+
+/**
+ * Correct an array of colors.  Runs of the same color, as left by fills and
+ * solid backgrounds, are only interpolated once.
+ *
+ * @param    lut    Cube.
+ * @param    in     Colors, 0x00RRGGBB.
+ * @param    out    Corrected colors, may be the same as in.
+ * @param    count  Number of colors.
+ *
+ * @returns  None
+ */
+void lut3d_apply(const lut3d_t *lut, const ws2811_led_t *in, ws2811_led_t *out, int count)
+{
+    ws2811_led_t last = 0, corrected = 0;
+    int i;
+
+    if (count > 0)
+    {
+        last = in[0] & 0xffffff;
+        corrected = lut3d_interpolate(lut, last);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        ws2811_led_t color = in[i] & 0xffffff;
+
+        if (color != last)
+        {
+            last = color;
+            corrected = lut3d_interpolate(lut, color);
+        }
+
+        out[i] = corrected;
+    }
+}
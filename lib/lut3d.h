@@ -0,0 +1,72 @@
+/*
+ * lut3d.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __LUT3D_H__
+#define __LUT3D_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+
+
+/*
+ * 3D lookup table color correction, as measured to match LED batches.  The
+ * cube has size points along each of red, green and blue, and colors between
+ * the points are interpolated over the tetrahedron of the cube cell holding
+ * them, in fixed point.
+ */
+
+#define LUT3D_SIZE_MIN                           2
+#define LUT3D_SIZE_MAX                           65
+
+// One point of the cube, red, green and blue in 8.8 fixed point, padded to four lanes
+typedef struct
+{
+    uint16_t c[4];
+} lut3d_entry_t;
+
+typedef struct lut3d
+{
+    int size;                                    //< Points along each axis
+    lut3d_entry_t *table;                        //< size^3 points, red varying fastest
+    uint8_t index[256];                          //< Color value to cell along an axis
+    uint16_t weight[256];                        //< Color value to position in the cell, 0-256
+} lut3d_t;
+
+
+lut3d_t *lut3d_create(int size);
+lut3d_t *lut3d_load_cube(const char *path);
+void lut3d_destroy(lut3d_t *lut);
+void lut3d_set(lut3d_t *lut, int r, int g, int b, float red, float green, float blue);
+ws2811_led_t lut3d_color(const lut3d_t *lut, ws2811_led_t color);
+void lut3d_apply(const lut3d_t *lut, const ws2811_led_t *in, ws2811_led_t *out, int count);
+
+
+#endif /* __LUT3D_H__ */
@@ -45,6 +45,7 @@
 #include "dma.h"
 #include "pcm.h"
 
+#include "effects.h"
 #include "ws2811-pcm.h"
 
 
@@ -58,6 +59,8 @@
 #define HEIGHT                                   8
 #define LED_COUNT                                (WIDTH * HEIGHT)
 
+#define FPS                                      15
+
 
 ws2811_channel_t ledchannel =
 {
@@ -75,83 +78,35 @@ ws2811_t ledstring =
     .channel = &ledchannel,
 };
 
-ws2811_led_t matrix[WIDTH][HEIGHT];
-
-
-void matrix_render(void)
-{
-    int x, y;
-
-    for (x = 0; x < WIDTH; x++)
-    {
-        for (y = 0; y < HEIGHT; y++)
-        {
-            ledstring.channel->leds[(y * WIDTH) + x] = matrix[x][y];
-        }
-    }
-}
+effect_rainbow_t rainbow = { .speed = EFFECT_FIXED(0.25), .spread = EFFECT_FIXED(1), .value = 0x30 };
+effect_chase_t chase = { .color = 0x300000, .spacing = 3, .speed = EFFECT_FIXED(FPS) };
+effect_fire_t fire = { .cooling = 55, .sparking = 120, .rate = EFFECT_FIXED(FPS) };
+effect_twinkle_t twinkle = { .color = 0x303030, .density = EFFECT_FIXED(0.2), .decay = EFFECT_FIXED(1) };
+effect_plasma_t plasma = { .width = WIDTH, .scale = EFFECT_FIXED(0.08), .speed = EFFECT_FIXED(0.1), .value = 0x30 };
+effect_gradient_t gradient = { .from = 0x300000, .to = 0x000030, .speed = EFFECT_FIXED(0.25) };
 
-void matrix_raise(void)
-{
-    int x, y;
-
-    for (y = 0; y < (HEIGHT - 1); y++)
-    {
-        for (x = 0; x < WIDTH; x++)
-        {
-            matrix[x][y] = matrix[x][y + 1];
-        }
-    }
-}
-
-int dotspos[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
-ws2811_led_t dotcolors[] =
-{
-/*
-    0x200000,  // red
-    0x201000,  // orange
-    0x202000,  // yellow
-    0x002000,  // green
-    0x002020,  // lightblue
-    0x000020,  // blue
-    0x100010,  // purple
-    0x200010,  // pink
-*/
-    0x300000,  // red
-    0x301800,  // orange
-    0x303000,  // yellow
-    0x003000,  // green
-    0x003030,  // lightblue
-    0x000030,  // blue
-    0x180018,  // purple
-    0x300018,  // pink
-};
+const char *effects[] = { "rainbow", "chase", "fire", "twinkle", "plasma", "gradient" };
+int effect = 0;
 
-void matrix_bottom(void)
+void effect_render(void)
 {
-    int i;
+    ws2811_led_t *leds = ledstring.channel->leds;
+    uint32_t dt = 1000000 / FPS;
 
-    for (i = 0; i < ARRAY_SIZE(dotspos); i++)
+    switch (effect)
     {
-        dotspos[i]++;
-        if (dotspos[i] > (WIDTH - 1))
-        {
-            dotspos[i] = 0;
-        }
-
-        matrix[dotspos[i]][HEIGHT - 1] = dotcolors[i];
+        case 0: effect_rainbow(&rainbow, leds, LED_COUNT, dt); break;
+        case 1: effect_chase(&chase, leds, LED_COUNT, dt); break;
+        case 2: effect_fire(&fire, leds, LED_COUNT, dt); break;
+        case 3: effect_twinkle(&twinkle, leds, LED_COUNT, dt); break;
+        case 4: effect_plasma(&plasma, leds, LED_COUNT, dt); break;
+        case 5: effect_gradient(&gradient, leds, LED_COUNT, dt); break;
     }
 }
 
 static void ctrl_c_handler(int signum)
 {
-    int x, y;
-    for (x = 0; x < WIDTH; x++) {
-        for (y = 0; y < HEIGHT; y++) {
-            matrix[x][y] = 0;
-        }
-    }
-    matrix_render();
+    memset(ledstring.channel->leds, 0, sizeof(ws2811_led_t) * LED_COUNT);
     ws2811_render(&ledstring);
     usleep(10000/15);
     ws2811_fini(&ledstring);
@@ -172,6 +127,34 @@ int main(int argc, char *argv[])
 {
     int ret = 0;
 
+    if (argc > 1)
+    {
+        for (effect = 0; effect < ARRAY_SIZE(effects); effect++)
+        {
+            if (!strcmp(argv[1], effects[effect]))
+            {
+                break;
+            }
+        }
+
+        if (effect == ARRAY_SIZE(effects))
+        {
+            fprintf(stderr, "Unknown effect %s, one of:", argv[1]);
+            for (effect = 0; effect < ARRAY_SIZE(effects); effect++)
+            {
+                fprintf(stderr, " %s", effects[effect]);
+            }
+            fprintf(stderr, "\n");
+
+            return 1;
+        }
+    }
+
+    if (effect_fire_init(&fire, LED_COUNT) || effect_twinkle_init(&twinkle, LED_COUNT))
+    {
+        return -1;
+    }
+
     setup_handlers();
 
     if (ws2811_init(&ledstring))
@@ -181,9 +164,7 @@ int main(int argc, char *argv[])
 
     while (1)
     {
-        matrix_raise();
-        matrix_bottom();
-        matrix_render();
+        effect_render();
 
         if (ws2811_render(&ledstring))
         {
@@ -192,7 +173,7 @@ int main(int argc, char *argv[])
         }
 
         // 15 frames /sec
-        usleep(1000000 / 15);
+        usleep(1000000 / FPS);
     }
 
     ws2811_fini(&ledstring);
@@ -0,0 +1,512 @@
+/*
+ * metrics.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+
+
+#define METRICS_POLL_MS                          100   // Stop request latency
+#define METRICS_REQUEST_MS                       50    // Time a client gets to send a request
+
+#define ARRAY_SIZE(stuff)                        (sizeof(stuff) / sizeof(stuff[0]))
+
+
+struct metrics
+{
+    // Written by the render thread only.  Kept on cache lines of its own, the
+    // exporter only reads it through metrics_snapshot().
+    struct
+    {
+        uint32_t seq;                            // Odd while an update is in progress
+        ws2811_stats_t stats;
+    } __attribute__((aligned(64))) shared;
+
+    // Owned by the exporter thread
+    pthread_t thread;
+    int stop;
+    int mode;
+    int interval_ms;
+    int fd;
+    char *path;
+    uint64_t last_frames;
+    struct timespec last_ts;
+} __attribute__((aligned(64)));
+
+static const char *stage_name[WS2811_STAGE_COUNT] =
+{
+    [WS2811_STAGE_ENCODE] = "encode",
+    [WS2811_STAGE_WAIT]   = "wait",
+    [WS2811_STAGE_START]  = "start",
+};
+
+static const char *latency_name[WS2811_LATENCY_COUNT] =
+{
+    [WS2811_LATENCY_ENCODE] = "encode",
+    [WS2811_LATENCY_QUEUE]  = "queue",
+    [WS2811_LATENCY_WIRE]   = "wire",
+    [WS2811_LATENCY_TOTAL]  = "total",
+};
+
+static const char *error_name[WS2811_ERROR_COUNT] =
+{
+    [WS2811_ERROR_GENERIC]       = "dma",
+    [WS2811_ERROR_DMA_READ]      = "dma_read",
+    [WS2811_ERROR_DMA_FIFO]      = "dma_fifo",
+    [WS2811_ERROR_DMA_READ_LAST] = "dma_read_last",
+    [WS2811_ERROR_PCM_UNDERRUN]  = "pcm_underrun",
+    [WS2811_ERROR_CLK_TIMEOUT]   = "clk_timeout",
+};
+
+
+/**
+ * Publish a new statistics snapshot.  Only to be called from the render thread.
+ *
+ * @param    metrics  Exporter instance.
+ * @param    stats    Current statistics.
+ *
+ * @returns  None
+ */
+void metrics_publish(metrics_t *metrics, const ws2811_stats_t *stats)
+{
+    uint32_t seq = metrics->shared.seq;
+
+    __atomic_store_n(&metrics->shared.seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    metrics->shared.stats = *stats;
+
+    __atomic_store_n(&metrics->shared.seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Take a consistent copy of the last published statistics.  Safe to call from
+ * any thread, never blocks the render thread.
+ *
+ * @param    metrics  Exporter instance.
+ * @param    stats    Destination for the statistics.
+ *
+ * @returns  None
+ */
+void metrics_snapshot(metrics_t *metrics, ws2811_stats_t *stats)
+{
+    uint32_t seq;
+
+    do
+    {
+        while ((seq = __atomic_load_n(&metrics->shared.seq, __ATOMIC_ACQUIRE)) & 1)
+        {
+            sched_yield();
+        }
+
+        *stats = metrics->shared.stats;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&metrics->shared.seq, __ATOMIC_RELAXED) != seq);
+}
+
+static double ns_to_s(uint64_t ns)
+{
+    return ns / 1000000000.0;
+}
+
+/**
+ * Write the current statistics in the Prometheus text exposition format.
+ *
+ * @param    metrics  Exporter instance.
+ * @param    out      Destination stream.
+ *
+ * @returns  None
+ */
+static void metrics_format(metrics_t *metrics, FILE *out)
+{
+    ws2811_stats_t stats;
+    struct timespec now;
+    uint64_t cumulative = 0;
+    double elapsed, fps = 0.0;
+    unsigned i;
+
+    metrics_snapshot(metrics, &stats);
+
+    // Frame rate since the previous export
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (now.tv_sec - metrics->last_ts.tv_sec) +
+              (now.tv_nsec - metrics->last_ts.tv_nsec) / 1000000000.0;
+    if (elapsed > 0.0 && stats.frames >= metrics->last_frames)
+    {
+        fps = (stats.frames - metrics->last_frames) / elapsed;
+    }
+    metrics->last_frames = stats.frames;
+    metrics->last_ts = now;
+
+    fprintf(out, "# HELP ws2811_frames_total Frames rendered.\n"
+                 "# TYPE ws2811_frames_total counter\n"
+                 "ws2811_frames_total %llu\n",
+                 (unsigned long long)stats.frames);
+
+    fprintf(out, "# HELP ws2811_fps Frame rate since the previous export.\n"
+                 "# TYPE ws2811_fps gauge\n"
+                 "ws2811_fps %.3f\n", fps);
+
+    fprintf(out, "# HELP ws2811_errors_total DMA errors and PCM underruns by type.\n"
+                 "# TYPE ws2811_errors_total counter\n");
+    for (i = 1; i < ARRAY_SIZE(error_name); i++)
+    {
+        fprintf(out, "ws2811_errors_total{type=\"%s\"} %llu\n",
+                error_name[i], (unsigned long long)stats.errors[i]);
+    }
+
+    fprintf(out, "# HELP ws2811_render_seconds Time spent in ws2811_render().\n"
+                 "# TYPE ws2811_render_seconds histogram\n");
+    for (i = 0; i < WS2811_HIST_BUCKETS; i++)
+    {
+        cumulative += stats.render_hist[i];
+
+        if (i == WS2811_HIST_BUCKETS - 1)
+        {
+            fprintf(out, "ws2811_render_seconds_bucket{le=\"+Inf\"} %llu\n",
+                    (unsigned long long)cumulative);
+        }
+        else
+        {
+            fprintf(out, "ws2811_render_seconds_bucket{le=\"%g\"} %llu\n",
+                    ns_to_s(WS2811_HIST_BOUND_NS(i)), (unsigned long long)cumulative);
+        }
+    }
+    fprintf(out, "ws2811_render_seconds_sum %.9f\n"
+                 "ws2811_render_seconds_count %llu\n",
+                 ns_to_s(stats.render_ns), (unsigned long long)cumulative);
+
+    fprintf(out, "# HELP ws2811_stage_seconds_total Time spent per render stage.\n"
+                 "# TYPE ws2811_stage_seconds_total counter\n");
+    for (i = 0; i < ARRAY_SIZE(stage_name); i++)
+    {
+        fprintf(out, "ws2811_stage_seconds_total{stage=\"%s\"} %.9f\n",
+                stage_name[i], ns_to_s(stats.total[i].ns));
+    }
+
+    if (stats.latency_frames)
+    {
+        fprintf(out, "# HELP ws2811_latency_seconds Recent frame latencies from render call to last bit out.\n"
+                     "# TYPE ws2811_latency_seconds gauge\n");
+        for (i = 0; i < ARRAY_SIZE(latency_name); i++)
+        {
+            ws2811_latency_t *latency = &stats.latency[i];
+
+            fprintf(out, "ws2811_latency_seconds{segment=\"%s\",quantile=\"0.5\"} %.9f\n"
+                         "ws2811_latency_seconds{segment=\"%s\",quantile=\"0.95\"} %.9f\n"
+                         "ws2811_latency_seconds{segment=\"%s\",quantile=\"0.99\"} %.9f\n"
+                         "ws2811_latency_seconds{segment=\"%s\",quantile=\"1\"} %.9f\n",
+                    latency_name[i], ns_to_s(latency->p50), latency_name[i], ns_to_s(latency->p95),
+                    latency_name[i], ns_to_s(latency->p99), latency_name[i], ns_to_s(latency->max));
+        }
+    }
+
+    if (stats.power_limit_ma)
+    {
+        fprintf(out, "# HELP ws2811_power_amperes Estimated supply current of the last frame.\n"
+                     "# TYPE ws2811_power_amperes gauge\n"
+                     "ws2811_power_amperes{kind=\"limit\"} %.3f\n"
+                     "ws2811_power_amperes{kind=\"draw\"} %.3f\n"
+                     "ws2811_power_amperes{kind=\"demand\"} %.3f\n",
+                stats.power_limit_ma / 1000.0, stats.power_ma / 1000.0, stats.power_demand_ma / 1000.0);
+        fprintf(out, "# HELP ws2811_power_brightness Brightness the last frame was sent with.\n"
+                     "# TYPE ws2811_power_brightness gauge\n"
+                     "ws2811_power_brightness %d\n", stats.power_brightness);
+        fprintf(out, "# HELP ws2811_power_limited_frames_total Frames dimmed to stay within the power limit.\n"
+                     "# TYPE ws2811_power_limited_frames_total counter\n"
+                     "ws2811_power_limited_frames_total %llu\n", (unsigned long long)stats.power_limited);
+    }
+
+    if (!stats.pmu)
+    {
+        return;
+    }
+
+    fprintf(out, "# HELP ws2811_stage_cycles_total CPU cycles per render stage.\n"
+                 "# TYPE ws2811_stage_cycles_total counter\n");
+    for (i = 0; i < ARRAY_SIZE(stage_name); i++)
+    {
+        fprintf(out, "ws2811_stage_cycles_total{stage=\"%s\"} %llu\n",
+                stage_name[i], (unsigned long long)stats.total[i].cycles);
+    }
+
+    fprintf(out, "# HELP ws2811_stage_instructions_total Instructions per render stage.\n"
+                 "# TYPE ws2811_stage_instructions_total counter\n");
+    for (i = 0; i < ARRAY_SIZE(stage_name); i++)
+    {
+        fprintf(out, "ws2811_stage_instructions_total{stage=\"%s\"} %llu\n",
+                stage_name[i], (unsigned long long)stats.total[i].instructions);
+    }
+
+    fprintf(out, "# HELP ws2811_stage_cache_misses_total Cache misses per render stage.\n"
+                 "# TYPE ws2811_stage_cache_misses_total counter\n");
+    for (i = 0; i < ARRAY_SIZE(stage_name); i++)
+    {
+        fprintf(out, "ws2811_stage_cache_misses_total{stage=\"%s\"} %llu\n",
+                stage_name[i], (unsigned long long)stats.total[i].cache_misses);
+    }
+}
+
+/**
+ * Answer one client on the metrics socket.  Clients sending an HTTP request get
+ * an HTTP response, anything else gets the plain text body.
+ *
+ * @param    metrics  Exporter instance.
+ * @param    fd       Connected client socket, closed on return.
+ *
+ * @returns  None
+ */
+static void metrics_serve(metrics_t *metrics, int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    char request[256];
+    int http = 0;
+    char *body;
+    size_t len;
+    FILE *out;
+
+    if (poll(&pfd, 1, METRICS_REQUEST_MS) > 0)
+    {
+        ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+
+        http = (n >= 4) && !memcmp(request, "GET ", 4);
+    }
+
+    out = open_memstream(&body, &len);
+    if (!out)
+    {
+        close(fd);
+        return;
+    }
+    metrics_format(metrics, out);
+    fclose(out);
+
+    // MSG_NOSIGNAL, a scraper hanging up early mustn't SIGPIPE the LED process
+    if (http)
+    {
+        char header[128];
+        int n = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\n"
+                                                 "Content-Type: text/plain; version=0.0.4\r\n"
+                                                 "Content-Length: %zu\r\n\r\n", len);
+
+        if (send(fd, header, n, MSG_NOSIGNAL) < 0)
+        {
+            free(body);
+            close(fd);
+            return;
+        }
+    }
+    if (send(fd, body, len, MSG_NOSIGNAL) < 0)
+    {
+        perror("metrics write");
+    }
+
+    free(body);
+    close(fd);
+}
+
+/**
+ * Rewrite the metrics file.  The new contents are written to a temporary file
+ * that is renamed over the old one, so readers never see a partial file.
+ *
+ * @param    metrics  Exporter instance.
+ *
+ * @returns  None
+ */
+static void metrics_write_file(metrics_t *metrics)
+{
+    char tmp[strlen(metrics->path) + 5];
+    FILE *out;
+
+    sprintf(tmp, "%s.tmp", metrics->path);
+
+    out = fopen(tmp, "w");
+    if (!out)
+    {
+        return;
+    }
+    metrics_format(metrics, out);
+    fclose(out);
+
+    rename(tmp, metrics->path);
+}
+
+static void *metrics_thread(void *arg)
+{
+    metrics_t *metrics = arg;
+    int waited = 0;
+
+    while (!__atomic_load_n(&metrics->stop, __ATOMIC_ACQUIRE))
+    {
+        if (metrics->mode == WS2811_METRICS_SOCKET)
+        {
+            struct pollfd pfd = { .fd = metrics->fd, .events = POLLIN };
+
+            if (poll(&pfd, 1, METRICS_POLL_MS) > 0)
+            {
+                int client = accept(metrics->fd, NULL, NULL);
+
+                if (client >= 0)
+                {
+                    metrics_serve(metrics, client);
+                }
+            }
+        }
+        else
+        {
+            if (waited >= metrics->interval_ms)
+            {
+                metrics_write_file(metrics);
+                waited = 0;
+            }
+
+            usleep(METRICS_POLL_MS * 1000);
+            waited += METRICS_POLL_MS;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Start the metrics exporter thread.
+ *
+ * @param    mode         WS2811_METRICS_SOCKET or WS2811_METRICS_FILE.
+ * @param    path         Socket path or metrics file path.
+ * @param    interval_ms  File rewrite interval, unused for the socket.
+ *
+ * @returns  Exporter instance, NULL on error.
+ */
+metrics_t *metrics_start(int mode, const char *path, int interval_ms)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    metrics_t *metrics;
+
+    if (posix_memalign((void **)&metrics, 64, sizeof(*metrics)))
+    {
+        return NULL;
+    }
+    memset(metrics, 0, sizeof(*metrics));
+
+    metrics->mode = mode;
+    metrics->interval_ms = interval_ms;
+    metrics->fd = -1;
+    metrics->path = strdup(path);
+    if (!metrics->path)
+    {
+        goto err;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &metrics->last_ts);
+
+    if (mode == WS2811_METRICS_SOCKET)
+    {
+        struct stat st;
+
+        if (strlen(path) >= sizeof(addr.sun_path))
+        {
+            goto err;
+        }
+
+        metrics->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (metrics->fd < 0)
+        {
+            goto err;
+        }
+
+        // Remove a stale socket left behind by a previous run, but nothing else
+        if (!lstat(path, &st) && S_ISSOCK(st.st_mode))
+        {
+            unlink(path);
+        }
+        strcpy(addr.sun_path, path);
+
+        if (bind(metrics->fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+            listen(metrics->fd, 4))
+        {
+            perror("metrics socket");
+            goto err;
+        }
+    }
+    else if (mode != WS2811_METRICS_FILE || interval_ms <= 0)
+    {
+        goto err;
+    }
+
+    if (pthread_create(&metrics->thread, NULL, metrics_thread, metrics))
+    {
+        goto err;
+    }
+
+    return metrics;
+
+err:
+    if (metrics->fd != -1)
+    {
+        close(metrics->fd);
+    }
+    free(metrics->path);
+    free(metrics);
+
+    return NULL;
+}
+
+/**
+ * Stop the exporter thread and release its resources.
+ *
+ * @param    metrics  Exporter instance.
+ *
+ * @returns  None
+ */
+void metrics_stop(metrics_t *metrics)
+{
+    __atomic_store_n(&metrics->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(metrics->thread, NULL);
+
+    if (metrics->mode == WS2811_METRICS_SOCKET)
+    {
+        close(metrics->fd);
+        unlink(metrics->path);
+    }
+
+    free(metrics->path);
+    free(metrics);
+}
@@ -0,0 +1,427 @@
+/*
+ * noise.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+
+#include "noise.h"
+
+
+/*
+ * Samples are generated a block at a time.  Each octave adds its signed 1.15
+ * noise to a block accumulator, which is then normalised to 8 bit.  Lattice
+ * values and gradients come from an integer hash of the lattice point, so no
+ * permutation table lookups are needed.
+ *
+ * Value noise only needs 32 bit integer math and no branches, so the compiler
+ * vectorizes its sample loops.  Simplex noise needs 64 bit positions for the
+ * skew to the simplex lattice, and only partly vectorizes, but it is free of
+ * the axis aligned artefacts of value noise and has only three or four
+ * corners per sample where value noise has four or eight.
+ */
+
+#define NOISE_BLOCK                              64
+#define OCTAVE_SEED                              0x9e3779b9  // Seed difference between octaves
+#define WEIGHT_BITS                              12          // Interpolation and falloff precision
+
+#define F2                                       0x5db3d743  // (sqrt(3) - 1) / 2, 0.32 fixed point
+#define G2                                       0x361962ea  // (3 - sqrt(3)) / 6
+#define F3                                       0x55555555  // 1 / 3
+#define G3                                       0x2aaaaaab  // 1 / 6
+#define SIMPLEX2_SCALE                           32          // Peak of the 2D sum in 4.28 to 1.15, measured
+#define SIMPLEX3_SCALE                           36          // Same for 3D
+
+typedef void (*octave_fn_t)(const noise_t *noise, int32_t *acc, int first, int n, int octave);
+
+
+static inline uint32_t hash(uint32_t x, uint32_t y, uint32_t z, uint32_t seed)
+{
+    uint32_t h = seed + (x * 0x9e3779b1) + (y * 0x85ebca77) + (z * 0xc2b2ae3d);
+
+    h ^= h >> 15;
+    h *= 0x2c1b3c6d;
+    h ^= h >> 12;
+    h *= 0x297a2d39;
+    h ^= h >> 15;
+
+    return h;
+}
+
+// Value of a lattice point, signed 1.15
+static inline int32_t lattice(uint32_t h)
+{
+    return (int32_t)(h >> 16) - 32768;
+}
+
+// Smoothstep of a 0.16 fraction, 0.12 result
+static inline int32_t fade(uint32_t frac)
+{
+    int32_t t = frac >> (16 - WEIGHT_BITS);
+    int32_t t2 = (t * t) >> WEIGHT_BITS;
+
+    return (t2 * ((3 << WEIGHT_BITS) - (2 * t))) >> WEIGHT_BITS;
+}
+
+static inline int32_t lerp(int32_t a, int32_t b, int32_t weight)
+{
+    return a + (((b - a) * weight) >> WEIGHT_BITS);
+}
+
+// 16.16 value times a 0.32 constant, exact to the last bit without 128 bit products
+static inline int64_t mul_frac(int64_t v, uint32_t frac)
+{
+    return (((v >> 16) * frac) >> 16) + ((uint64_t)(v & 0xffff) * frac >> 32);
+}
+
+// Simplex corner falloff t^4 of a 0.12 value, 0.16 result, fine enough that corners fade in smoothly
+static inline int32_t falloff(int32_t t)
+{
+    int32_t t2;
+
+    t = (t < 0) ? 0 : t;
+    t2 = (t * t) >> 7;
+
+    return (t2 * t2) >> 18;
+}
+
+// Dot product of one of 8 gradients with a 4.12 offset
+static inline int32_t grad2(uint32_t h, int32_t x, int32_t y)
+{
+    h &= 7;
+    int32_t gx = (h < 6) ? ((h & 1) ? -x : x) : 0;
+    int32_t gy = (h < 4) ? ((h & 2) ? -y : y) : ((h < 6) ? 0 : ((h & 1) ? -y : y));
+
+    return gx + gy;
+}
+
+// Dot product of one of the 12 cube edge gradients with a 4.12 offset
+static inline int32_t grad3(uint32_t h, int32_t x, int32_t y, int32_t z)
+{
+    h &= 15;
+    int32_t u = (h < 8) ? x : y;
+    int32_t v = (h < 4) ? y : (((h == 12) || (h == 14)) ? x : z);
+
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+static void value2_octave(const noise_t *noise, int32_t *acc, int first, int n, int octave)
+{
+    uint32_t seed = noise->seed + (octave * OCTAVE_SEED);
+    uint32_t step = (uint32_t)noise->step << octave;
+    uint32_t x = ((uint32_t)noise->x + ((uint32_t)first * (uint32_t)noise->step)) << octave;
+    uint32_t y = (uint32_t)noise->y << octave;
+    uint32_t y0 = y >> 16, y1 = (y0 + 1) & 0xffff;
+    int32_t wy = fade(y & 0xffff);
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        uint32_t px = x + (i * step);
+        uint32_t x0 = px >> 16, x1 = (x0 + 1) & 0xffff;
+        int32_t wx = fade(px & 0xffff);
+        int32_t a = lerp(lattice(hash(x0, y0, 0, seed)), lattice(hash(x1, y0, 0, seed)), wx);
+        int32_t b = lerp(lattice(hash(x0, y1, 0, seed)), lattice(hash(x1, y1, 0, seed)), wx);
+
+        acc[i] += lerp(a, b, wy) >> octave;
+    }
+}
+
+static void value3_octave(const noise_t *noise, int32_t *acc, int first, int n, int octave)
+{
+    uint32_t seed = noise->seed + (octave * OCTAVE_SEED);
+    uint32_t step = (uint32_t)noise->step << octave;
+    uint32_t x = ((uint32_t)noise->x + ((uint32_t)first * (uint32_t)noise->step)) << octave;
+    uint32_t y = (uint32_t)noise->y << octave;
+    uint32_t z = (uint32_t)noise->z << octave;
+    uint32_t y0 = y >> 16, y1 = (y0 + 1) & 0xffff;
+    uint32_t z0 = z >> 16, z1 = (z0 + 1) & 0xffff;
+    int32_t wy = fade(y & 0xffff), wz = fade(z & 0xffff);
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        uint32_t px = x + (i * step);
+        uint32_t x0 = px >> 16, x1 = (x0 + 1) & 0xffff;
+        int32_t wx = fade(px & 0xffff);
+        int32_t a = lerp(lattice(hash(x0, y0, z0, seed)), lattice(hash(x1, y0, z0, seed)), wx);
+        int32_t b = lerp(lattice(hash(x0, y1, z0, seed)), lattice(hash(x1, y1, z0, seed)), wx);
+        int32_t c = lerp(lattice(hash(x0, y0, z1, seed)), lattice(hash(x1, y0, z1, seed)), wx);
+        int32_t d = lerp(lattice(hash(x0, y1, z1, seed)), lattice(hash(x1, y1, z1, seed)), wx);
+
+        acc[i] += lerp(lerp(a, b, wy), lerp(c, d, wy), wz) >> octave;
+    }
+}
+
+static void simplex2_octave(const noise_t *noise, int32_t *acc, int first, int n, int octave)
+{
+    uint32_t seed = noise->seed + (octave * OCTAVE_SEED);
+    int64_t scale = (int64_t)1 << octave;
+    int64_t step = noise->step * scale;
+    int64_t x = ((int64_t)noise->x + ((int64_t)first * noise->step)) * scale;
+    int64_t y = noise->y * scale;
+    int32_t g = (int32_t)(((uint64_t)G2 + 0x8000) >> 16);  // G2 in 16.16
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        int64_t px = x + (i * step);
+        int64_t s = mul_frac(px + y, F2);
+        int64_t ci = (px + s) >> 16, cj = (y + s) >> 16;
+        int64_t t = mul_frac((ci + cj) * 65536, G2);
+        int32_t x0 = px - (ci * 65536) + t, y0 = y - (cj * 65536) + t;
+        int32_t i1 = x0 > y0, j1 = !i1;
+        int32_t dx[3], dy[3];
+        uint32_t h[3];
+        int32_t sum = 0;
+        int k;
+
+        // Offsets to the three corners, in 4.12
+        dx[0] = x0 >> 4;
+        dy[0] = y0 >> 4;
+        dx[1] = (x0 - (i1 << 16) + g) >> 4;
+        dy[1] = (y0 - (j1 << 16) + g) >> 4;
+        dx[2] = (x0 - 65536 + (2 * g)) >> 4;
+        dy[2] = (y0 - 65536 + (2 * g)) >> 4;
+        h[0] = hash(ci, cj, 0, seed);
+        h[1] = hash(ci + i1, cj + j1, 0, seed);
+        h[2] = hash(ci + 1, cj + 1, 0, seed);
+
+        for (k = 0; k < 3; k++)
+        {
+            int32_t r = (1 << (WEIGHT_BITS - 1)) - (((dx[k] * dx[k]) + (dy[k] * dy[k])) >> WEIGHT_BITS);
+
+            sum += falloff(r) * grad2(h[k], dx[k], dy[k]);
+        }
+
+        sum = (sum * SIMPLEX2_SCALE) >> 12;
+        sum = (sum > 32767) ? 32767 : ((sum < -32767) ? -32767 : sum);
+        acc[i] += sum >> octave;
+    }
+}
+
+static void simplex3_octave(const noise_t *noise, int32_t *acc, int first, int n, int octave)
+{
+    uint32_t seed = noise->seed + (octave * OCTAVE_SEED);
+    int64_t scale = (int64_t)1 << octave;
+    int64_t step = noise->step * scale;
+    int64_t x = ((int64_t)noise->x + ((int64_t)first * noise->step)) * scale;
+    int64_t y = noise->y * scale;
+    int64_t z = noise->z * scale;
+    int32_t g = (int32_t)(((uint64_t)G3 + 0x8000) >> 16);  // G3 in 16.16
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        int64_t px = x + (i * step);
+        int64_t s = mul_frac(px + y + z, F3);
+        int64_t ci = (px + s) >> 16, cj = (y + s) >> 16, ck = (z + s) >> 16;
+        int64_t t = mul_frac((ci + cj + ck) * 65536, G3);
+        int32_t x0 = px - (ci * 65536) + t, y0 = y - (cj * 65536) + t, z0 = z - (ck * 65536) + t;
+        // First and second corner steps, along the largest offset then the two largest
+        int32_t i1 = (x0 >= y0) & (x0 >= z0), j1 = (y0 > x0) & (y0 >= z0), k1 = (z0 > x0) & (z0 > y0);
+        int32_t i2 = (x0 >= y0) | (x0 >= z0), j2 = (y0 > x0) | (y0 >= z0), k2 = (z0 > x0) | (z0 > y0);
+        int32_t dx[4], dy[4], dz[4];
+        uint32_t h[4];
+        int32_t sum = 0;
+        int k;
+
+        dx[0] = x0 >> 4;
+        dy[0] = y0 >> 4;
+        dz[0] = z0 >> 4;
+        dx[1] = (x0 - (i1 << 16) + g) >> 4;
+        dy[1] = (y0 - (j1 << 16) + g) >> 4;
+        dz[1] = (z0 - (k1 << 16) + g) >> 4;
+        dx[2] = (x0 - (i2 << 16) + (2 * g)) >> 4;
+        dy[2] = (y0 - (j2 << 16) + (2 * g)) >> 4;
+        dz[2] = (z0 - (k2 << 16) + (2 * g)) >> 4;
+        dx[3] = (x0 - 65536 + (3 * g)) >> 4;
+        dy[3] = (y0 - 65536 + (3 * g)) >> 4;
+        dz[3] = (z0 - 65536 + (3 * g)) >> 4;
+        h[0] = hash(ci, cj, ck, seed);
+        h[1] = hash(ci + i1, cj + j1, ck + k1, seed);
+        h[2] = hash(ci + i2, cj + j2, ck + k2, seed);
+        h[3] = hash(ci + 1, cj + 1, ck + 1, seed);
+
+        for (k = 0; k < 4; k++)
+        {
+            int32_t r = (1 << (WEIGHT_BITS - 1)) -
+                        (((dx[k] * dx[k]) + (dy[k] * dy[k]) + (dz[k] * dz[k])) >> WEIGHT_BITS);
+
+            sum += falloff(r) * grad3(h[k], dx[k], dy[k], dz[k]);
+        }
+
+        sum = (sum * SIMPLEX3_SCALE) >> 12;
+        sum = (sum > 32767) ? 32767 : ((sum < -32767) ? -32767 : sum);
+        acc[i] += sum >> octave;
+    }
+}
+
+/**
+ * Sum the octaves a block at a time and normalise to 8 bit.  Inlined into
+ * each generator, so the octave function is a direct call.
+ */
+static inline void noise_run(const noise_t *noise, uint8_t *out, int count, octave_fn_t octave_fn)
+{
+    int octaves = noise->octaves;
+    int32_t acc[NOISE_BLOCK];
+    int32_t norm;
+    int first, i, o;
+
+    octaves = (octaves < 1) ? 1 : ((octaves > NOISE_OCTAVES_MAX) ? NOISE_OCTAVES_MAX : octaves);
+
+    // The octaves sum to (2^n - 1) / 2^(n - 1) times the first, scale that back to 1
+    norm = ((1 << (octaves - 1)) << 15) / ((1 << octaves) - 1);
+
+    for (first = 0; first < count; first += NOISE_BLOCK)
+    {
+        int n = ((count - first) < NOISE_BLOCK) ? (count - first) : NOISE_BLOCK;
+
+        memset(acc, 0, n * sizeof(acc[0]));
+        for (o = 0; o < octaves; o++)
+        {
+            octave_fn(noise, acc, first, n, o);
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            int32_t v = (((acc[i] * norm) >> 15) >> 8) + 128;
+
+            out[first + i] = (v < 0) ? 0 : ((v > 255) ? 255 : v);
+        }
+    }
+}
+
+/**
+ * 2D value noise along a row.
+ *
+ * @param    noise  Position, step, seed and octaves.
+ * @param    out    Filled with the intensities.
+ * @param    count  Number of samples.
+ *
+ * @returns  None
+ */
+void noise_value2(const noise_t *noise, uint8_t *out, int count)
+{
+    noise_run(noise, out, count, value2_octave);
+}
+
+/**
+ * 3D value noise along a row.
+ *
+ * @param    noise  Position, step, seed and octaves.
+ * @param    out    Filled with the intensities.
+ * @param    count  Number of samples.
+ *
+ * @returns  None
+ */
+void noise_value3(const noise_t *noise, uint8_t *out, int count)
+{
+    noise_run(noise, out, count, value3_octave);
+}
+
+/**
+ * 2D simplex noise along a row.
+ *
+ * @param    noise  Position, step, seed and octaves.
+ * @param    out    Filled with the intensities.
+ * @param    count  Number of samples.
+ *
+ * @returns  None
+ */
+void noise_simplex2(const noise_t *noise, uint8_t *out, int count)
+{
+    noise_run(noise, out, count, simplex2_octave);
+}
+
+/**
+ * 3D simplex noise along a row.
+ *
+ * @param    noise  Position, step, seed and octaves.
+ * @param    out    Filled with the intensities.
+ * @param    count  Number of samples.
+ *
+ * @returns  None
+ */
+void noise_simplex3(const noise_t *noise, uint8_t *out, int count)
+{
+    noise_run(noise, out, count, simplex3_octave);
+}
+
+/**
+ * Build a 256 entry palette from evenly spaced key colors.
+ *
+ * @param    palette  Filled with 256 colors.
+ * @param    keys     Key colors, the first for intensity 0, the last for 255.
+ * @param    nkeys    Number of key colors, at least 1.
+ *
+ * @returns  None
+ */
+void noise_palette_build(ws2811_led_t *palette, const ws2811_led_t *keys, int nkeys)
+{
+    int v;
+
+    for (v = 0; v < 256; v++)
+    {
+        int pos = (v * (nkeys - 1) * 256) / 255;
+        int key = pos >> 8, weight = pos & 0xff;
+        ws2811_led_t a = keys[key], b = (key + 1 < nkeys) ? keys[key + 1] : a;
+        ws2811_led_t color = 0;
+        int shift;
+
+        for (shift = 16; shift >= 0; shift -= 8)
+        {
+            int ca = (a >> shift) & 0xff, cb = (b >> shift) & 0xff;
+
+            color |= (ws2811_led_t)(ca + ((((cb - ca) * weight) + 128) >> 8)) << shift;
+        }
+
+        palette[v] = color;
+    }
+}
+
+/**
+ * Map intensities to colors.
+ *
+ * @param    values   Intensities.
+ * @param    palette  256 colors, see noise_palette_build().
+ * @param    leds     Filled with the colors.
+ * @param    count    Number of LEDs.
+ *
+ * @returns  None
+ */
+void noise_palette(const uint8_t *values, const ws2811_led_t *palette, ws2811_led_t *leds, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        leds[i] = palette[values[i]];
+    }
+}
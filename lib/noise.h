@@ -0,0 +1,73 @@
+/*
+ * noise.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __NOISE_H__
+#define __NOISE_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+
+
+/*
+ * Fixed point value and simplex noise, evaluated a whole row of samples per
+ * call into an 8 bit intensity buffer.  The intensities can be mapped to
+ * colors with a 256 entry palette, for fire, clouds or water, and the colors
+ * drawn into an LED buffer or a compositor layer.
+ *
+ * Positions are 16.16 fixed point lattice units, EFFECT_FIXED() style.  A row
+ * starts at x, y, z and steps along x.  Animate by moving y on a strip, or z
+ * on a matrix with a row per matrix line.  Each octave adds detail at twice
+ * the frequency and half the amplitude of the one before.  Value noise is
+ * periodic every 65536 units, simplex noise isn't.
+ */
+
+#define NOISE_OCTAVES_MAX                        8
+
+typedef struct
+{
+    int32_t x;                                   //< Position of the first sample
+    int32_t y;
+    int32_t z;                                   //< Ignored by the 2D generators
+    int32_t step;                                //< Distance between samples along x
+    uint32_t seed;                               //< Any value, picks one of many noise fields
+    int octaves;                                 //< Octaves summed, 1 to NOISE_OCTAVES_MAX
+} noise_t;
+
+
+void noise_value2(const noise_t *noise, uint8_t *out, int count);
+void noise_value3(const noise_t *noise, uint8_t *out, int count);
+void noise_simplex2(const noise_t *noise, uint8_t *out, int count);
+void noise_simplex3(const noise_t *noise, uint8_t *out, int count);
+void noise_palette_build(ws2811_led_t *palette, const ws2811_led_t *keys, int nkeys);
+void noise_palette(const uint8_t *values, const ws2811_led_t *palette, ws2811_led_t *leds, int count);
+
+
+#endif /* __NOISE_H__ */
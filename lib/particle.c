@@ -0,0 +1,358 @@
+/*
+ * particle.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "particle.h"
+
+
+#define ONE                                      PARTICLE_FIXED_ONE
+#define MAX_DT_US                                1000000     // Longest step, after a stall
+
+
+static inline uint32_t xorshift(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+// Semi-implicit Euler along one axis, the new velocity moves the particle
+static void integrate(float *restrict pos, float *restrict vel, int count, float keep, float dv, float dt)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        vel[i] = (vel[i] * keep) + dv;
+        pos[i] += vel[i] * dt;
+    }
+}
+
+// 16.16 to float
+static inline float from_fixed(int32_t x)
+{
+    return x * (1.0f / ONE);
+}
+
+
+/**
+ * Allocate a particle pool for a canvas size.
+ *
+ * @param    capacity  Most particles alive at once.
+ * @param    width     Canvas width.
+ * @param    height    Canvas height.
+ *
+ * @returns  Particle system, or NULL on bad arguments or allocation failure.
+ */
+particle_system_t *particle_create(int capacity, int width, int height)
+{
+    particle_system_t *ps;
+
+    if ((capacity <= 0) || (width <= 0) || (height <= 0))
+    {
+        return NULL;
+    }
+
+    ps = calloc(1, sizeof(*ps));
+    if (!ps)
+    {
+        return NULL;
+    }
+
+    ps->capacity = capacity;
+    ps->width = width;
+    ps->height = height;
+
+    ps->x = malloc(capacity * sizeof(*ps->x));
+    ps->y = malloc(capacity * sizeof(*ps->y));
+    ps->vx = malloc(capacity * sizeof(*ps->vx));
+    ps->vy = malloc(capacity * sizeof(*ps->vy));
+    ps->level = malloc(capacity * sizeof(*ps->level));
+    ps->fade = malloc(capacity * sizeof(*ps->fade));
+    ps->color = malloc(capacity * sizeof(*ps->color));
+    ps->acc = malloc(width * height * 3 * sizeof(*ps->acc));
+    if (!ps->x || !ps->y || !ps->vx || !ps->vy || !ps->level || !ps->fade || !ps->color || !ps->acc)
+    {
+        particle_destroy(ps);
+        return NULL;
+    }
+
+    return ps;
+}
+
+/**
+ * Free a particle system.
+ *
+ * @param    ps  Particle system from particle_create(), may be NULL.
+ *
+ * @returns  None
+ */
+void particle_destroy(particle_system_t *ps)
+{
+    if (!ps)
+    {
+        return;
+    }
+
+    free(ps->x);
+    free(ps->y);
+    free(ps->vx);
+    free(ps->vy);
+    free(ps->level);
+    free(ps->fade);
+    free(ps->color);
+    free(ps->acc);
+    free(ps);
+}
+
+/**
+ * Remove all particles.
+ *
+ * @param    ps  Particle system.
+ *
+ * @returns  None
+ */
+void particle_clear(particle_system_t *ps)
+{
+    ps->count = 0;
+}
+
+/**
+ * Start new particles.  The random direction is uniform over a disc, so a
+ * burst from a point fills a circle rather than forming a ring.
+ *
+ * @param    ps       Particle system.
+ * @param    emitter  Where and how particles start, its seed is advanced.
+ * @param    count    Particles to start.
+ *
+ * @returns  Particles started, fewer than count if the pool is full.
+ */
+int particle_emit(particle_system_t *ps, particle_emitter_t *emitter, int count)
+{
+    uint32_t seed = emitter->seed ? emitter->seed : 1;
+    float x = from_fixed(emitter->x), y = from_fixed(emitter->y);
+    float width = from_fixed(emitter->width), height = from_fixed(emitter->height);
+    float vx = from_fixed(emitter->vx), vy = from_fixed(emitter->vy);
+    float speed = from_fixed(emitter->speed) / 0x8000;
+    int n;
+
+    if (count > ps->capacity - ps->count)
+    {
+        count = ps->capacity - ps->count;
+    }
+
+    for (n = 0; n < count; n++)
+    {
+        int i = ps->count + n;
+        uint32_t r = xorshift(&seed);
+        int32_t dx, dy, life;
+
+        ps->x[i] = x + (width * (((int32_t)(r & 0xffff) - 0x8000) * (1.0f / 0x10000)));
+        ps->y[i] = y + (height * (((int32_t)(r >> 16) - 0x8000) * (1.0f / 0x10000)));
+
+        do
+        {
+            r = xorshift(&seed);
+            dx = (int32_t)(r & 0xffff) - 0x8000;
+            dy = (int32_t)(r >> 16) - 0x8000;
+        } while (((uint32_t)(dx * dx) + (uint32_t)(dy * dy)) > (0x8000 * 0x8000));
+
+        ps->vx[i] = vx + (dx * speed);
+        ps->vy[i] = vy + (dy * speed);
+
+        life = emitter->life + (int32_t)(((int64_t)(xorshift(&seed) & 0xffff) * emitter->life_spread) >> 16);
+        life = (life > 0x100) ? life : 0x100;
+
+        ps->level[i] = 1.0f;
+        ps->fade[i] = 1.0f / from_fixed(life);
+        ps->color[i] = emitter->color;
+    }
+
+    ps->count += count;
+    emitter->seed = seed;
+
+    return count;
+}
+
+/**
+ * Move all particles on by a time step, fade them and drop the dead ones.
+ *
+ * @param    ps     Particle system.
+ * @param    dt_us  Time since the previous step.
+ *
+ * @returns  None
+ */
+void particle_step(particle_system_t *ps, uint32_t dt_us)
+{
+    float *restrict x = ps->x, *restrict y = ps->y;
+    float *restrict vx = ps->vx, *restrict vy = ps->vy;
+    float *restrict level = ps->level;
+    float *restrict fade = ps->fade;
+    ws2811_led_t *restrict color = ps->color;
+    float dt, dvx, dvy, keep;
+    float right = ps->width, bottom = ps->height;
+    int count = ps->count;
+    int i, alive;
+
+    dt_us = (dt_us < MAX_DT_US) ? dt_us : MAX_DT_US;
+    dt = dt_us * 1e-6f;
+    dvx = from_fixed(ps->ax) * dt;
+    dvy = from_fixed(ps->ay) * dt;
+    keep = 1.0f - (from_fixed(ps->drag) * dt);
+    keep = (keep < 0.0f) ? 0.0f : ((keep > 1.0f) ? 1.0f : keep);
+
+    // One pass per axis, two streams each vectorize where all six at once don't
+    integrate(x, vx, count, keep, dvx, dt);
+    integrate(y, vy, count, keep, dvy, dt);
+    for (i = 0; i < count; i++)
+    {
+        level[i] -= fade[i] * dt;
+    }
+
+    // Pack the live ones to the front, nothing moves until the first dead one
+    for (i = 0, alive = 0; i < count; i++)
+    {
+        int gone = (level[i] <= 0.0f) ||
+                   ((x[i] <= -1.0f) && (vx[i] <= 0.0f) && (ps->ax <= 0)) ||
+                   ((x[i] >= right) && (vx[i] >= 0.0f) && (ps->ax >= 0)) ||
+                   ((y[i] <= -1.0f) && (vy[i] <= 0.0f) && (ps->ay <= 0)) ||
+                   ((y[i] >= bottom) && (vy[i] >= 0.0f) && (ps->ay >= 0));
+
+        if (gone)
+        {
+            continue;
+        }
+
+        if (alive != i)
+        {
+            x[alive] = x[i];
+            y[alive] = y[i];
+            vx[alive] = vx[i];
+            vy[alive] = vy[i];
+            level[alive] = level[i];
+            fade[alive] = fade[i];
+            color[alive] = color[i];
+        }
+        alive++;
+    }
+    ps->count = alive;
+}
+
+/**
+ * Add the particles to the canvas pixels, saturating.  Clear or draw the
+ * background first.
+ *
+ * @param    ps      Particle system.
+ * @param    canvas  Canvas of the size given to particle_create().
+ *
+ * @returns  0 on success, -1 if the canvas size doesn't match.
+ */
+int particle_render(particle_system_t *ps, canvas_t *canvas)
+{
+    uint32_t *acc = ps->acc;
+    int width = ps->width, height = ps->height;
+    int i, k;
+
+    if ((canvas->width != width) || (canvas->height != height))
+    {
+        return -1;
+    }
+
+    memset(acc, 0, width * height * 3 * sizeof(*acc));
+
+    for (i = 0; i < ps->count; i++)
+    {
+        float x = ps->x[i], y = ps->y[i];
+        uint32_t color = ps->color[i];
+        int32_t px, py;
+        uint32_t fx, fy, level, r, g, b, weight[4];
+        int corner;
+
+        // Off the canvas, also keeps the conversions in range
+        if ((x <= -1.0f) || (x >= width) || (y <= -1.0f) || (y >= height))
+        {
+            continue;
+        }
+
+        // 24.8 positions, offset so truncation rounds down
+        px = (int32_t)((x + 1.0f) * 256.0f) - 256;
+        py = (int32_t)((y + 1.0f) * 256.0f) - 256;
+        fx = px & 0xff;
+        fy = py & 0xff;
+        px >>= 8;
+        py >>= 8;
+
+        level = (uint32_t)(ps->level[i] * 256.0f);
+        r = ((color >> 16) & 0xff) * level;
+        g = ((color >> 8) & 0xff) * level;
+        b = (color & 0xff) * level;
+
+        weight[0] = (256 - fx) * (256 - fy);
+        weight[1] = fx * (256 - fy);
+        weight[2] = (256 - fx) * fy;
+        weight[3] = fx * fy;
+
+        for (corner = 0; corner < 4; corner++)
+        {
+            int cx = px + (corner & 1), cy = py + (corner >> 1);
+            uint32_t *sum;
+
+            if ((cx < 0) || (cx >= width) || (cy < 0) || (cy >= height))
+            {
+                continue;
+            }
+            sum = &acc[((cy * width) + cx) * 3];
+
+            sum[0] += (r * weight[corner]) >> 16;
+            sum[1] += (g * weight[corner]) >> 16;
+            sum[2] += (b * weight[corner]) >> 16;
+        }
+    }
+
+    for (k = 0; k < width * height; k++)
+    {
+        ws2811_led_t c = canvas->pixels[k];
+        uint32_t r = ((c >> 16) & 0xff) + ((acc[(k * 3) + 0] + 128) >> 8);
+        uint32_t g = ((c >> 8) & 0xff) + ((acc[(k * 3) + 1] + 128) >> 8);
+        uint32_t b = (c & 0xff) + ((acc[(k * 3) + 2] + 128) >> 8);
+
+        canvas->pixels[k] = (((r < 255) ? r : 255) << 16) | (((g < 255) ? g : 255) << 8) | ((b < 255) ? b : 255);
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * particle.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __PARTICLE_H__
+#define __PARTICLE_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+#include "canvas.h"
+
+
+/*
+ * Particle engine for sparks, fireworks, rain and the like on a canvas.
+ * Particles live in a pool allocated once, as one array per field, so the
+ * step is a straight loop over all particles that the compiler vectorizes.
+ * Dead particles are packed out of the arrays in the same step.  Rendering
+ * adds each particle's color to the 2x2 pixels around it, weighted by how
+ * close it is to each, and saturates onto the canvas.
+ *
+ * Settings are 16.16 fixed point like the effects: positions in pixels
+ * with pixel (0, 0) centered on 0.0, velocities in pixels per second,
+ * accelerations in pixels per second squared and times in seconds.  The
+ * particles themselves are floats, which vectorize on NEON and SSE alike
+ * without the 64 bit products 16.16 would need.  Particles fade out
+ * linearly over their life, and die early once they have left the canvas
+ * and can't come back.
+ */
+
+#define PARTICLE_FIXED_ONE                       (1 << 16)
+#define PARTICLE_FIXED(x)                        ((int32_t)((x) * PARTICLE_FIXED_ONE))
+
+typedef struct
+{
+    int32_t x, y;                                //< Center of the area new particles start in
+    int32_t width, height;                       //< Size of that area, 0 for a point
+    int32_t vx, vy;                              //< Starting velocity
+    int32_t speed;                               //< Most speed added in a random direction
+    int32_t life;                                //< Shortest life
+    int32_t life_spread;                         //< Most random life added
+    ws2811_led_t color;
+    uint32_t seed;                               //< Random state, any non-zero value
+} particle_emitter_t;
+
+typedef struct
+{
+    int capacity;
+    int count;                                   //< Live particles, the first count of each array
+    int width;                                   //< Canvas size
+    int height;
+    int32_t ax, ay;                              //< Acceleration of all particles, gravity
+    int32_t drag;                                //< Fraction of the velocity lost per second
+    float *x;                                    //< Pixels
+    float *y;
+    float *vx;                                   //< Pixels per second
+    float *vy;
+    float *level;                                //< Brightness left, 1 at birth
+    float *fade;                                 //< Brightness lost per second
+    ws2811_led_t *color;
+    uint32_t *acc;                               //< Red, green and blue sums per pixel, 8.8
+} particle_system_t;
+
+
+particle_system_t *particle_create(int capacity, int width, int height);
+void particle_destroy(particle_system_t *ps);
+void particle_clear(particle_system_t *ps);
+int particle_emit(particle_system_t *ps, particle_emitter_t *emitter, int count);
+void particle_step(particle_system_t *ps, uint32_t dt_us);
+int particle_render(particle_system_t *ps, canvas_t *canvas);
+
+
+#endif /* __PARTICLE_H__ */
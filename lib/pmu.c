@@ -0,0 +1,166 @@
+/*
+ * pmu.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "pmu.h"
+
+
+// Hardware event selection by counter index
+static const uint64_t pmu_event[PMU_COUNT] =
+{
+    [PMU_CYCLES]       = PERF_COUNT_HW_CPU_CYCLES,
+    [PMU_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+    [PMU_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+};
+
+
+static int perf_event_open(struct perf_event_attr *attr, int group_fd)
+{
+    // Count for the calling thread on any CPU
+    return syscall(__NR_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+/**
+ * Open the cycle, instruction and cache miss counters for the calling thread.
+ * Only user space execution is counted, so sleeping in the kernel while waiting
+ * for the DMA doesn't show up.
+ *
+ * @param    pmu  Counter set to initialize.
+ *
+ * @returns  0 if at least one counter could be opened, -1 otherwise.
+ */
+int pmu_open(pmu_t *pmu)
+{
+    struct perf_event_attr attr;
+    int i;
+
+    pmu->leader = -1;
+    pmu->nr = 0;
+
+    for (i = 0; i < PMU_COUNT; i++)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = pmu_event[i];
+        attr.disabled = (pmu->leader == -1);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        pmu->fd[i] = perf_event_open(&attr, pmu->leader);
+        if (pmu->fd[i] < 0)
+        {
+            pmu->fd[i] = -1;
+            continue;
+        }
+
+        if (pmu->leader == -1)
+        {
+            pmu->leader = pmu->fd[i];
+        }
+        pmu->nr++;
+    }
+
+    if (pmu->leader == -1)
+    {
+        return -1;
+    }
+
+    ioctl(pmu->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(pmu->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    return 0;
+}
+
+/**
+ * Close all counters.
+ *
+ * @param    pmu  Counter set previously passed to pmu_open().
+ *
+ * @returns  None
+ */
+void pmu_close(pmu_t *pmu)
+{
+    int i;
+
+    for (i = 0; i < PMU_COUNT; i++)
+    {
+        if (pmu->fd[i] != -1)
+        {
+            close(pmu->fd[i]);
+            pmu->fd[i] = -1;
+        }
+    }
+
+    pmu->leader = -1;
+    pmu->nr = 0;
+}
+
+/**
+ * Read the current value of all counters with a single system call.
+ *
+ * @param    pmu     Counter set.
+ * @param    values  Array of PMU_COUNT entries, unavailable counters read as zero.
+ *
+ * @returns  None
+ */
+void pmu_read(pmu_t *pmu, uint64_t *values)
+{
+    uint64_t buf[1 + PMU_COUNT];
+    int i, n = 1;
+
+    memset(values, 0, sizeof(*values) * PMU_COUNT);
+
+    if (pmu->leader == -1)
+    {
+        return;
+    }
+
+    if (read(pmu->leader, buf, sizeof(uint64_t) * (1 + pmu->nr)) <= 0)
+    {
+        return;
+    }
+
+    // Group values come back in the order the counters were opened
+    for (i = 0; i < PMU_COUNT; i++)
+    {
+        if (pmu->fd[i] != -1)
+        {
+            values[i] = buf[n++];
+        }
+    }
+}
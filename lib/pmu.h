@@ -0,0 +1,60 @@
+/*
+ * pmu.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __PMU_H__
+#define __PMU_H__
+
+
+/*
+ * Hardware performance counters, read through perf_event_open(2).
+ *
+ * All counters are opened as one group so a single read() returns a
+ * consistent sample.  Counters the kernel or CPU can't provide are left
+ * closed and always read as zero.
+ */
+#define PMU_CYCLES                               0
+#define PMU_INSTRUCTIONS                         1
+#define PMU_CACHE_MISSES                         2
+#define PMU_COUNT                                3
+
+typedef struct
+{
+    int fd[PMU_COUNT];                           //< Counter file descriptors, -1 if unavailable
+    int leader;                                  //< Group leader descriptor, -1 if none opened
+    int nr;                                      //< Number of counters in the group
+} pmu_t;
+
+
+int pmu_open(pmu_t *pmu);
+void pmu_close(pmu_t *pmu);
+void pmu_read(pmu_t *pmu, uint64_t *values);
+
+
+#endif /* __PMU_H__ */
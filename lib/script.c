@@ -0,0 +1,1094 @@
+/*
+ * script.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "script.h"
+
+
+/*
+ * The compiler is a recursive descent parser emitting three operand code
+ * straight away.  Expressions on constants only are folded by running the
+ * instruction on a single lane, so the VM never sees them.  Temporaries are
+ * freed as soon as they are consumed, and a result always goes to a register
+ * none of its operands is in, so the instruction loops can take restrict
+ * pointers and vectorize.
+ *
+ * Registers are loaded before the code runs according to their source:
+ * constants and uniform inputs (t, n, w, h, parameters) once per run, LED
+ * index and position once per batch.
+ */
+
+#define ONE                                      (1 << 16)
+#define NAME_MAX_LEN                             16
+
+enum
+{
+    SRC_NONE,                                    // Computed by the code
+    SRC_CONST,
+    SRC_I,
+    SRC_X,
+    SRC_Y,
+    SRC_T,
+    SRC_N,
+    SRC_W,
+    SRC_H,
+    SRC_PARAM,                                   // SRC_PARAM + 0 to SRC_PARAM + 7
+    SRC_COUNT = SRC_PARAM + SCRIPT_PARAMS,
+};
+
+enum
+{
+    OP_MOV,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_NEG,
+    OP_LT,
+    OP_LE,
+    OP_EQ,
+    OP_NE,
+    OP_MIN,
+    OP_MAX,
+    OP_ABS,
+    OP_FLOOR,
+    OP_FRAC,
+    OP_SIN,
+    OP_SQRT,
+    OP_HASH,
+    OP_SELECT,                                   // a ? b : c
+    OP_MIX,                                      // a + (b - a) * c
+    OP_CLAMP,                                    // min(max(a, b), c)
+};
+
+enum
+{
+    TOK_EOF = 256,
+    TOK_END,                                     // Newline or ';'
+    TOK_NUMBER,
+    TOK_NAME,
+    TOK_LE,
+    TOK_GE,
+    TOK_EQ,
+    TOK_NE,
+};
+
+static const struct
+{
+    const char *name;
+    int source;
+} inputs[] =
+{
+    { "i", SRC_I }, { "x", SRC_X }, { "y", SRC_Y }, { "t", SRC_T }, { "n", SRC_N }, { "w", SRC_W },
+    { "h", SRC_H }, { "p0", SRC_PARAM + 0 }, { "p1", SRC_PARAM + 1 }, { "p2", SRC_PARAM + 2 },
+    { "p3", SRC_PARAM + 3 }, { "p4", SRC_PARAM + 4 }, { "p5", SRC_PARAM + 5 }, { "p6", SRC_PARAM + 6 },
+    { "p7", SRC_PARAM + 7 },
+};
+
+static const struct
+{
+    const char *name;
+    int args;
+    int op;                                      // -1 for cos, which is sin a quarter turn later
+} functions[] =
+{
+    { "sin", 1, OP_SIN }, { "cos", 1, -1 }, { "abs", 1, OP_ABS }, { "floor", 1, OP_FLOOR },
+    { "frac", 1, OP_FRAC }, { "sqrt", 1, OP_SQRT }, { "hash", 1, OP_HASH }, { "min", 2, OP_MIN },
+    { "max", 2, OP_MAX }, { "clamp", 3, OP_CLAMP }, { "mix", 3, OP_MIX },
+};
+
+typedef struct
+{
+    int reg;                                     //< -1 for a constant
+    int32_t value;
+} operand_t;
+
+typedef struct
+{
+    script_t *script;
+    const char *pos;
+    int line;
+    char *error;
+    int error_size;
+    int failed;
+    uint64_t used;                               //< Registers holding something
+    uint64_t fixed;                              //< Registers never freed: variables, constants, inputs
+    uint64_t written;                            //< Registers some instruction writes
+    int input_reg[SRC_COUNT];
+    struct
+    {
+        char name[NAME_MAX_LEN];
+        int reg;
+    } vars[SCRIPT_REGISTERS];
+    int var_count;
+    int tok;
+    int32_t number;
+    char name[NAME_MAX_LEN];
+} compiler_t;
+
+
+static uint32_t isqrt64(uint64_t x)
+{
+    uint64_t root = 0, bit = 1ULL << 62;
+
+    while (bit > x)
+    {
+        bit >>= 2;
+    }
+    while (bit)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+// Sine of x turns in 16.16, a parabola with one correction step, error below 0.001
+static inline int32_t sine(int32_t x)
+{
+    int32_t f = (int16_t)(x & 0xffff);           // -0.5 to 0.5 turns
+    int32_t y = (f * (ONE - 2 * ((f < 0) ? -f : f))) >> 13;
+    int64_t yy = ((int64_t)y * ((y < 0) ? -y : y)) >> 16;
+
+    return y + (int32_t)(((yy - y) * 14746) >> 16);
+}
+
+static inline int32_t hash(int32_t x)
+{
+    uint32_t h = (uint32_t)x * 0x9e3779b1;
+
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+
+    return h & 0xffff;
+}
+
+static void execute(int op, int32_t *restrict d, const int32_t *restrict a, const int32_t *restrict b,
+                    const int32_t *restrict c, int n)
+{
+    int k;
+
+    switch (op)
+    {
+        case OP_MOV:
+            memcpy(d, a, n * sizeof(*d));
+            break;
+
+        case OP_ADD:
+            for (k = 0; k < n; k++) d[k] = (int32_t)((uint32_t)a[k] + (uint32_t)b[k]);
+            break;
+
+        case OP_SUB:
+            for (k = 0; k < n; k++) d[k] = (int32_t)((uint32_t)a[k] - (uint32_t)b[k]);
+            break;
+
+        case OP_MUL:
+            for (k = 0; k < n; k++) d[k] = (int32_t)(((int64_t)a[k] * b[k]) >> 16);
+            break;
+
+        case OP_DIV:
+            for (k = 0; k < n; k++) d[k] = b[k] ? (int32_t)(((int64_t)a[k] * ONE) / b[k]) : 0;
+            break;
+
+        case OP_MOD:
+            for (k = 0; k < n; k++)
+            {
+                int64_t r = b[k] ? ((int64_t)a[k] % b[k]) : 0;
+
+                d[k] = (int32_t)(r + (((r != 0) && ((r < 0) != (b[k] < 0))) ? b[k] : 0));
+            }
+            break;
+
+        case OP_NEG:
+            for (k = 0; k < n; k++) d[k] = (int32_t)(0 - (uint32_t)a[k]);
+            break;
+
+        case OP_LT:
+            for (k = 0; k < n; k++) d[k] = (a[k] < b[k]) ? ONE : 0;
+            break;
+
+        case OP_LE:
+            for (k = 0; k < n; k++) d[k] = (a[k] <= b[k]) ? ONE : 0;
+            break;
+
+        case OP_EQ:
+            for (k = 0; k < n; k++) d[k] = (a[k] == b[k]) ? ONE : 0;
+            break;
+
+        case OP_NE:
+            for (k = 0; k < n; k++) d[k] = (a[k] != b[k]) ? ONE : 0;
+            break;
+
+        case OP_MIN:
+            for (k = 0; k < n; k++) d[k] = (a[k] < b[k]) ? a[k] : b[k];
+            break;
+
+        case OP_MAX:
+            for (k = 0; k < n; k++) d[k] = (a[k] > b[k]) ? a[k] : b[k];
+            break;
+
+        case OP_ABS:
+            for (k = 0; k < n; k++) d[k] = (a[k] < 0) ? (int32_t)(0 - (uint32_t)a[k]) : a[k];
+            break;
+
+        case OP_FLOOR:
+            for (k = 0; k < n; k++) d[k] = a[k] & ~(ONE - 1);
+            break;
+
+        case OP_FRAC:
+            for (k = 0; k < n; k++) d[k] = a[k] & (ONE - 1);
+            break;
+
+        case OP_SIN:
+            for (k = 0; k < n; k++) d[k] = sine(a[k]);
+            break;
+
+        case OP_SQRT:
+            for (k = 0; k < n; k++) d[k] = (a[k] > 0) ? (int32_t)isqrt64((uint64_t)a[k] << 16) : 0;
+            break;
+
+        case OP_HASH:
+            for (k = 0; k < n; k++) d[k] = hash(a[k]);
+            break;
+
+        case OP_SELECT:
+            for (k = 0; k < n; k++) d[k] = a[k] ? b[k] : c[k];
+            break;
+
+        case OP_MIX:
+            for (k = 0; k < n; k++) d[k] = (int32_t)(a[k] + ((((int64_t)b[k] - a[k]) * c[k]) >> 16));
+            break;
+
+        case OP_CLAMP:
+            for (k = 0; k < n; k++) d[k] = (a[k] < b[k]) ? b[k] : ((a[k] > c[k]) ? c[k] : a[k]);
+            break;
+    }
+}
+
+static void fail(compiler_t *cc, const char *format, ...)
+{
+    va_list args;
+    int len;
+
+    if (cc->failed)
+    {
+        return;
+    }
+    cc->failed = 1;
+    cc->tok = TOK_EOF;
+
+    if (cc->error && (cc->error_size > 0))
+    {
+        len = snprintf(cc->error, cc->error_size, "line %d: ", cc->line);
+        if ((len >= 0) && (len < cc->error_size))
+        {
+            va_start(args, format);
+            vsnprintf(cc->error + len, cc->error_size - len, format, args);
+            va_end(args);
+        }
+    }
+}
+
+static void next(compiler_t *cc)
+{
+    const char *p = cc->pos;
+    int len;
+
+    if (cc->failed)
+    {
+        return;
+    }
+
+    while ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '#'))
+    {
+        if (*p == '#')
+        {
+            while (*p && (*p != '\n'))
+            {
+                p++;
+            }
+        }
+        else
+        {
+            p++;
+        }
+    }
+
+    if (!*p)
+    {
+        cc->tok = TOK_EOF;
+    }
+    else if ((*p == '\n') || (*p == ';'))
+    {
+        cc->line += (*p == '\n');
+        cc->tok = TOK_END;
+        p++;
+    }
+    else if (((*p >= '0') && (*p <= '9')) || (*p == '.'))
+    {
+        char *end;
+        double value = strtod(p, &end);
+
+        if ((end == p) || (value >= 32768.0))
+        {
+            cc->pos = p;
+            fail(cc, "bad number");
+            return;
+        }
+        cc->number = (int32_t)((value * ONE) + 0.5);
+        cc->tok = TOK_NUMBER;
+        p = end;
+    }
+    else if (((*p >= 'a') && (*p <= 'z')) || ((*p >= 'A') && (*p <= 'Z')) || (*p == '_'))
+    {
+        for (len = 0; ((p[len] >= 'a') && (p[len] <= 'z')) || ((p[len] >= 'A') && (p[len] <= 'Z')) ||
+                      ((p[len] >= '0') && (p[len] <= '9')) || (p[len] == '_'); len++)
+        {
+        }
+        if (len >= NAME_MAX_LEN)
+        {
+            fail(cc, "name too long");
+            return;
+        }
+        memcpy(cc->name, p, len);
+        cc->name[len] = '\0';
+        cc->tok = TOK_NAME;
+        p += len;
+    }
+    else if ((p[1] == '=') && strchr("<>=!", *p))
+    {
+        cc->tok = (*p == '<') ? TOK_LE : (*p == '>') ? TOK_GE : (*p == '=') ? TOK_EQ : TOK_NE;
+        p += 2;
+    }
+    else if (strchr("+-*/%<>()?:,=", *p))
+    {
+        cc->tok = *p++;
+    }
+    else
+    {
+        fail(cc, "unexpected '%c'", *p);
+        return;
+    }
+
+    cc->pos = p;
+}
+
+static void expect(compiler_t *cc, int tok, const char *what)
+{
+    if (cc->tok != tok)
+    {
+        fail(cc, "expected %s", what);
+    }
+    next(cc);
+}
+
+// Registers loaded before the code runs must also be ones no instruction writes
+static int reg_alloc(compiler_t *cc, int fixed, int loaded)
+{
+    uint64_t taken = cc->used | (loaded ? cc->written : 0);
+    int reg;
+
+    for (reg = 0; reg < SCRIPT_REGISTERS; reg++)
+    {
+        if (!(taken & (1ULL << reg)))
+        {
+            cc->used |= 1ULL << reg;
+            cc->fixed |= (uint64_t)fixed << reg;
+            return reg;
+        }
+    }
+
+    fail(cc, "expression too complex");
+    return 0;
+}
+
+static void reg_release(compiler_t *cc, operand_t o)
+{
+    if ((o.reg >= 0) && !(cc->fixed & (1ULL << o.reg)))
+    {
+        cc->used &= ~(1ULL << o.reg);
+    }
+}
+
+// Register holding an operand, adding constants to the pool the first time
+static int reg_of(compiler_t *cc, operand_t o)
+{
+    script_t *script = cc->script;
+    int reg;
+
+    if (o.reg >= 0)
+    {
+        return o.reg;
+    }
+
+    for (reg = 0; reg < SCRIPT_REGISTERS; reg++)
+    {
+        if ((cc->fixed & (1ULL << reg)) && (script->source[reg] == SRC_CONST) &&
+            (script->constant[reg] == o.value))
+        {
+            return reg;
+        }
+    }
+
+    reg = reg_alloc(cc, 1, 1);
+    script->source[reg] = SRC_CONST;
+    script->constant[reg] = o.value;
+
+    return reg;
+}
+
+static operand_t constant(int32_t value)
+{
+    operand_t o = { -1, value };
+
+    return o;
+}
+
+static operand_t emit(compiler_t *cc, int op, operand_t a, operand_t b, operand_t c)
+{
+    script_insn_t *insn;
+    operand_t d = constant(0);
+
+    if (cc->failed)
+    {
+        return d;
+    }
+
+    if ((a.reg < 0) && (b.reg < 0) && (c.reg < 0))
+    {
+        execute(op, &d.value, &a.value, &b.value, &c.value, 1);
+        return d;
+    }
+
+    if (cc->script->code_count >= SCRIPT_CODE_MAX)
+    {
+        fail(cc, "program too long");
+        return d;
+    }
+
+    insn = &cc->script->code[cc->script->code_count++];
+    insn->op = op;
+    insn->a = reg_of(cc, a);
+    insn->b = reg_of(cc, b);
+    insn->c = reg_of(cc, c);
+    insn->dst = d.reg = reg_alloc(cc, 0, 0);
+    cc->script->source[d.reg] = SRC_NONE;
+    cc->written |= 1ULL << d.reg;
+
+    reg_release(cc, a);
+    reg_release(cc, b);
+    reg_release(cc, c);
+
+    return d;
+}
+
+static operand_t emit1(compiler_t *cc, int op, operand_t a)
+{
+    return emit(cc, op, a, a, a);
+}
+
+static operand_t emit2(compiler_t *cc, int op, operand_t a, operand_t b)
+{
+    return emit(cc, op, a, b, a);
+}
+
+static int var_find(compiler_t *cc, const char *name)
+{
+    int i;
+
+    for (i = 0; i < cc->var_count; i++)
+    {
+        if (!strcmp(cc->vars[i].name, name))
+        {
+            return cc->vars[i].reg;
+        }
+    }
+
+    return -1;
+}
+
+static operand_t expression(compiler_t *cc);
+
+static operand_t call(compiler_t *cc, const char *name)
+{
+    operand_t args[3];
+    unsigned f;
+    int i;
+
+    for (f = 0; (f < sizeof(functions) / sizeof(functions[0])) && strcmp(functions[f].name, name); f++)
+    {
+    }
+    if (f == sizeof(functions) / sizeof(functions[0]))
+    {
+        fail(cc, "unknown function '%s'", name);
+        return constant(0);
+    }
+
+    next(cc);
+    for (i = 0; i < functions[f].args; i++)
+    {
+        if (i)
+        {
+            expect(cc, ',', "','");
+        }
+        args[i] = expression(cc);
+    }
+    expect(cc, ')', "')'");
+
+    switch (functions[f].args)
+    {
+        case 1:
+            if (functions[f].op < 0)
+            {
+                return emit1(cc, OP_SIN, emit2(cc, OP_ADD, args[0], constant(ONE / 4)));
+            }
+            return emit1(cc, functions[f].op, args[0]);
+
+        case 2:
+            return emit2(cc, functions[f].op, args[0], args[1]);
+
+        default:
+            return emit(cc, functions[f].op, args[0], args[1], args[2]);
+    }
+}
+
+static operand_t primary(compiler_t *cc)
+{
+    operand_t o = constant(0);
+    char name[NAME_MAX_LEN];
+    unsigned i;
+
+    if (cc->tok == TOK_NUMBER)
+    {
+        o = constant(cc->number);
+        next(cc);
+    }
+    else if (cc->tok == '(')
+    {
+        next(cc);
+        o = expression(cc);
+        expect(cc, ')', "')'");
+    }
+    else if (cc->tok == TOK_NAME)
+    {
+        strcpy(name, cc->name);
+        next(cc);
+
+        if (cc->tok == '(')
+        {
+            return call(cc, name);
+        }
+
+        o.reg = var_find(cc, name);
+        for (i = 0; (o.reg < 0) && (i < sizeof(inputs) / sizeof(inputs[0])); i++)
+        {
+            if (!strcmp(inputs[i].name, name))
+            {
+                int source = inputs[i].source;
+
+                if (cc->input_reg[source] < 0)
+                {
+                    cc->input_reg[source] = reg_alloc(cc, 1, 1);
+                    cc->script->source[cc->input_reg[source]] = source;
+                }
+                o.reg = cc->input_reg[source];
+            }
+        }
+        if (o.reg < 0)
+        {
+            fail(cc, "unknown name '%s'", name);
+        }
+    }
+    else
+    {
+        fail(cc, "expected a value");
+    }
+
+    return o;
+}
+
+static operand_t unary(compiler_t *cc)
+{
+    if (cc->tok == '-')
+    {
+        next(cc);
+        return emit1(cc, OP_NEG, unary(cc));
+    }
+    if (cc->tok == '+')
+    {
+        next(cc);
+        return unary(cc);
+    }
+
+    return primary(cc);
+}
+
+static operand_t term(compiler_t *cc)
+{
+    operand_t o = unary(cc);
+
+    while ((cc->tok == '*') || (cc->tok == '/') || (cc->tok == '%'))
+    {
+        int op = (cc->tok == '*') ? OP_MUL : (cc->tok == '/') ? OP_DIV : OP_MOD;
+
+        next(cc);
+        o = emit2(cc, op, o, unary(cc));
+    }
+
+    return o;
+}
+
+static operand_t sum(compiler_t *cc)
+{
+    operand_t o = term(cc);
+
+    while ((cc->tok == '+') || (cc->tok == '-'))
+    {
+        int op = (cc->tok == '+') ? OP_ADD : OP_SUB;
+
+        next(cc);
+        o = emit2(cc, op, o, term(cc));
+    }
+
+    return o;
+}
+
+static operand_t comparison(compiler_t *cc)
+{
+    operand_t o = sum(cc);
+
+    while ((cc->tok == '<') || (cc->tok == '>') || (cc->tok == TOK_LE) || (cc->tok == TOK_GE) ||
+           (cc->tok == TOK_EQ) || (cc->tok == TOK_NE))
+    {
+        int tok = cc->tok;
+        operand_t right;
+
+        next(cc);
+        right = sum(cc);
+        switch (tok)
+        {
+            case '<':    o = emit2(cc, OP_LT, o, right); break;
+            case '>':    o = emit2(cc, OP_LT, right, o); break;
+            case TOK_LE: o = emit2(cc, OP_LE, o, right); break;
+            case TOK_GE: o = emit2(cc, OP_LE, right, o); break;
+            case TOK_EQ: o = emit2(cc, OP_EQ, o, right); break;
+            default:     o = emit2(cc, OP_NE, o, right); break;
+        }
+    }
+
+    return o;
+}
+
+static operand_t expression(compiler_t *cc)
+{
+    operand_t cond = comparison(cc), yes, no;
+
+    if (cc->tok != '?')
+    {
+        return cond;
+    }
+
+    next(cc);
+    yes = expression(cc);
+    expect(cc, ':', "':'");
+    no = expression(cc);
+
+    return emit(cc, OP_SELECT, cond, yes, no);
+}
+
+static void assignment(compiler_t *cc)
+{
+    script_t *script = cc->script;
+    char name[NAME_MAX_LEN];
+    operand_t value;
+    unsigned i;
+    int reg;
+
+    if (cc->tok != TOK_NAME)
+    {
+        fail(cc, "expected an assignment");
+        return;
+    }
+    strcpy(name, cc->name);
+    for (i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
+    {
+        if (!strcmp(inputs[i].name, name))
+        {
+            fail(cc, "can't assign to input '%s'", name);
+            return;
+        }
+    }
+    next(cc);
+    expect(cc, '=', "'='");
+
+    value = expression(cc);
+    if (cc->failed)
+    {
+        return;
+    }
+
+    reg = var_find(cc, name);
+    if (reg < 0)
+    {
+        reg = reg_alloc(cc, 1, 0);
+        script->source[reg] = SRC_NONE;
+        strcpy(cc->vars[cc->var_count].name, name);
+        cc->vars[cc->var_count++].reg = reg;
+    }
+
+    // Write a fresh result straight to the variable unless it reads the variable
+    if ((value.reg >= 0) && !(cc->fixed & (1ULL << value.reg)) && script->code_count &&
+        (script->code[script->code_count - 1].dst == value.reg) &&
+        (script->code[script->code_count - 1].a != reg) && (script->code[script->code_count - 1].b != reg) &&
+        (script->code[script->code_count - 1].c != reg))
+    {
+        script->code[script->code_count - 1].dst = reg;
+        cc->written |= 1ULL << reg;
+        reg_release(cc, value);
+    }
+    else if (value.reg != reg)
+    {
+        script_insn_t *insn;
+        int src = reg_of(cc, value);
+
+        if (script->code_count >= SCRIPT_CODE_MAX)
+        {
+            fail(cc, "program too long");
+            return;
+        }
+        insn = &script->code[script->code_count++];
+        insn->op = OP_MOV;
+        insn->dst = reg;
+        insn->a = insn->b = insn->c = src;
+        cc->written |= 1ULL << reg;
+        reg_release(cc, value);
+    }
+}
+
+
+/**
+ * Compile a program.
+ *
+ * @param    source      Program text.
+ * @param    error       Buffer for a message saying what's wrong, may be NULL.
+ * @param    error_size  Size of the buffer.
+ *
+ * @returns  Compiled program, or NULL on errors or allocation failure.
+ */
+script_t *script_compile(const char *source, char *error, int error_size)
+{
+    static const char *outputs[] = { "r", "g", "b" };
+    compiler_t cc;
+    script_t *script;
+    int i;
+
+    if (error && (error_size > 0))
+    {
+        error[0] = '\0';
+    }
+
+    script = calloc(1, sizeof(*script));
+    if (!script)
+    {
+        return NULL;
+    }
+    script->regs = calloc(SCRIPT_REGISTERS, sizeof(*script->regs));
+    if (!script->regs)
+    {
+        script_destroy(script);
+        return NULL;
+    }
+    script->reg_files = 1;
+
+    memset(&cc, 0, sizeof(cc));
+    cc.script = script;
+    cc.pos = source;
+    cc.line = 1;
+    cc.error = error;
+    cc.error_size = error_size;
+    for (i = 0; i < SRC_COUNT; i++)
+    {
+        cc.input_reg[i] = -1;
+    }
+
+    next(&cc);
+    while (cc.tok != TOK_EOF)
+    {
+        if (cc.tok != TOK_END)
+        {
+            assignment(&cc);
+            if ((cc.tok != TOK_END) && (cc.tok != TOK_EOF))
+            {
+                fail(&cc, "expected end of statement");
+            }
+        }
+        next(&cc);
+    }
+
+    // Outputs never assigned stay dark
+    for (i = 0; i < 3; i++)
+    {
+        int reg = var_find(&cc, outputs[i]);
+
+        script->out[i] = (reg >= 0) ? reg : reg_of(&cc, constant(0));
+    }
+
+    if (cc.failed)
+    {
+        script_destroy(script);
+        return NULL;
+    }
+
+    return script;
+}
+
+/**
+ * Free a compiled program.
+ *
+ * @param    script  Program from script_compile(), may be NULL.
+ *
+ * @returns  None
+ */
+void script_destroy(script_t *script)
+{
+    if (!script)
+    {
+        return;
+    }
+
+    free(script->regs);
+    free(script);
+}
+
+/**
+ * Set one of the parameters p0 to p7, for instance an audio level.
+ *
+ * @param    script  Program.
+ * @param    index   Parameter, 0 to SCRIPT_PARAMS - 1.
+ * @param    value   Value, -32768 to 32767.
+ *
+ * @returns  0 on success, -1 for a bad index.
+ */
+int script_param(script_t *script, int index, double value)
+{
+    if ((index < 0) || (index >= SCRIPT_PARAMS))
+    {
+        return -1;
+    }
+
+    script->params[index] = (int32_t)((value * ONE) + ((value < 0) ? -0.5 : 0.5));
+
+    return 0;
+}
+
+// Color from 16.16 r, g and b, clamped to 0..1
+static inline ws2811_led_t pack(int32_t r, int32_t g, int32_t b)
+{
+    r = (r < 0) ? 0 : (r > ONE) ? ONE : r;
+    g = (g < 0) ? 0 : (g > ONE) ? ONE : g;
+    b = (b < 0) ? 0 : (b > ONE) ? ONE : b;
+
+    return ((((uint32_t)r * 255 + (ONE / 2)) >> 16) << 16) | ((((uint32_t)g * 255 + (ONE / 2)) >> 16) << 8) |
+           (((uint32_t)b * 255 + (ONE / 2)) >> 16);
+}
+
+// 16.16 of an integer input, wrapping like t above 32767 instead of overflowing
+static inline int32_t fixed_of(int value)
+{
+    return (int32_t)((uint32_t)value << 16);
+}
+
+// One run of a program, for the tile function
+typedef struct
+{
+    script_t *script;
+    const canvas_t *canvas;
+    ws2811_led_t *leds;
+    int count;
+    uint64_t time_us;
+} script_run_t;
+
+// Run pixels first to first + count - 1, first a multiple of SCRIPT_BATCH, on a worker's registers
+static void script_tile(void *arg, int first, int count, int worker)
+{
+    const script_run_t *run = arg;
+    const script_t *script = run->script;
+    const canvas_t *canvas = run->canvas;
+    ws2811_led_t *leds = run->leds;
+    int32_t (*regs)[SCRIPT_BATCH] = &script->regs[worker * SCRIPT_REGISTERS];
+    int width = canvas ? canvas->width : run->count;
+    int total = canvas ? (canvas->width * canvas->height) : run->count;
+    int i_reg = -1, x_reg = -1, y_reg = -1;
+    int base, reg, k, pc;
+
+    for (reg = 0; reg < SCRIPT_REGISTERS; reg++)
+    {
+        int32_t value;
+
+        switch (script->source[reg])
+        {
+            case SRC_I:     i_reg = reg; continue;
+            case SRC_X:     x_reg = reg; continue;
+            case SRC_Y:     y_reg = reg; continue;
+            case SRC_CONST: value = script->constant[reg]; break;
+            case SRC_T:     value = (int32_t)((run->time_us << 16) / 1000000); break;
+            case SRC_N:     value = fixed_of(total); break;
+            case SRC_W:     value = fixed_of(width); break;
+            case SRC_H:     value = fixed_of(canvas ? canvas->height : 1); break;
+            default:
+                if (script->source[reg] < SRC_PARAM)
+                {
+                    continue;
+                }
+                value = script->params[script->source[reg] - SRC_PARAM];
+                break;
+        }
+
+        for (k = 0; k < SCRIPT_BATCH; k++)
+        {
+            regs[reg][k] = value;
+        }
+    }
+
+    for (base = first; base < first + count; base += SCRIPT_BATCH)
+    {
+        int n = ((first + count - base) < SCRIPT_BATCH) ? (first + count - base) : SCRIPT_BATCH;
+        const int *map = canvas ? &canvas->map[base] : NULL;
+        const int32_t *r, *g, *b;
+        int x = base % width, y = base / width;
+
+        if (i_reg >= 0)
+        {
+            for (k = 0; k < n; k++) regs[i_reg][k] = fixed_of(map ? map[k] : (base + k));
+        }
+        if ((x_reg >= 0) || (y_reg >= 0))
+        {
+            int32_t unused[SCRIPT_BATCH];
+            int32_t *xs = (x_reg >= 0) ? regs[x_reg] : unused, *ys = (y_reg >= 0) ? regs[y_reg] : unused;
+
+            for (k = 0; k < n; k++)
+            {
+                xs[k] = fixed_of(x);
+                ys[k] = fixed_of(y);
+                if (++x == width)
+                {
+                    x = 0;
+                    y++;
+                }
+            }
+        }
+
+        for (pc = 0; pc < script->code_count; pc++)
+        {
+            const script_insn_t *insn = &script->code[pc];
+
+            execute(insn->op, regs[insn->dst], regs[insn->a], regs[insn->b], regs[insn->c], n);
+        }
+
+        r = regs[script->out[0]];
+        g = regs[script->out[1]];
+        b = regs[script->out[2]];
+        if (!map || canvas->identity)
+        {
+            int end = (base + n < run->count) ? n : (run->count - base);
+
+            for (k = 0; k < end; k++)
+            {
+                leds[base + k] = pack(r[k], g[k], b[k]);
+            }
+        }
+        else
+        {
+            for (k = 0; k < n; k++)
+            {
+                if ((map[k] >= 0) && (map[k] < run->count))
+                {
+                    leds[map[k]] = pack(r[k], g[k], b[k]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Run a program for every LED of a strip, or every pixel of a canvas.  With
+ * a canvas, x and y are the pixel position and the colors go to the LEDs the
+ * pixel map gives, straight to the LED buffer.  With a pool the first run
+ * allocates registers for each of its threads, if that fails it runs on the
+ * calling thread.
+ *
+ * @param    script   Program.
+ * @param    canvas   Canvas whose pixel map places the LEDs, or NULL for a strip.
+ * @param    leds     LED buffer.
+ * @param    count    LEDs in the buffer.
+ * @param    time_us  Time the input t gives, in microseconds.
+ *
+ * @returns  None
+ */
+void script_run(script_t *script, const canvas_t *canvas, ws2811_led_t *leds, int count, uint64_t time_us)
+{
+    script_run_t run = { .script = script, .canvas = canvas, .leds = leds, .count = count, .time_us = time_us };
+    int total = canvas ? (canvas->width * canvas->height) : count;
+    int threads = tasks_threads(script->tasks);
+    tasks_t *tasks = script->tasks;
+
+    if (threads > script->reg_files)
+    {
+        int32_t (*regs)[SCRIPT_BATCH] = realloc(script->regs, threads * SCRIPT_REGISTERS * sizeof(*regs));
+
+        if (regs)
+        {
+            script->regs = regs;
+            script->reg_files = threads;
+        }
+        else
+        {
+            tasks = NULL;
+        }
+    }
+
+    tasks_run(tasks, script_tile, &run, total, tasks_grain(sizeof(*leds) + sizeof(int), SCRIPT_BATCH));
+}
@@ -0,0 +1,95 @@
+/*
+ * script.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __SCRIPT_H__
+#define __SCRIPT_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+#include "canvas.h"
+#include "tasks.h"
+
+
+/*
+ * Per LED effects written as expressions, compiled to register bytecode and
+ * run over the whole strip or matrix.  A program is a list of assignments,
+ * separated by newlines or ';', that ends up setting r, g and b between 0
+ * and 1:
+ *
+ *     v = sin(x / w + t * 0.25) * 0.5 + 0.5
+ *     r = v * p0; g = 0.2; b = 1 - v
+ *
+ * Inputs are i (LED index), x and y (pixel position on the canvas, i and 0
+ * without one), w and h (canvas size), n (LEDs evaluated), t (seconds,
+ * wrapping every 9 hours) and p0 to p7, parameters set by script_param().  Operators are + - * / %,
+ * comparisons giving 0 or 1, and a ? b : c.  Functions are sin and cos in
+ * turns, abs, floor, frac, sqrt, hash (0 to 1, pseudo random), min, max,
+ * clamp(x, lo, hi) and mix(a, b, f).  '#' starts a comment.
+ *
+ * Values are 16.16 fixed point, so i, x, y, w, h and n wrap above 32767
+ * like t does.  Each register holds SCRIPT_BATCH LEDs, so
+ * every instruction is one tight loop over a batch.  With a pool in tasks,
+ * tiles of batches run on all cores, each with its own registers.
+ */
+
+#define SCRIPT_BATCH                             64          // LEDs per instruction
+#define SCRIPT_REGISTERS                         64
+#define SCRIPT_CODE_MAX                          256         // Instructions per program
+#define SCRIPT_PARAMS                            8
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t dst;
+    uint8_t a, b, c;                             //< Operand registers, unused ones repeat a
+} script_insn_t;
+
+typedef struct
+{
+    int code_count;
+    script_insn_t code[SCRIPT_CODE_MAX];
+    uint8_t source[SCRIPT_REGISTERS];            //< What loads each register before the code runs
+    int32_t constant[SCRIPT_REGISTERS];          //< Value of constant registers
+    int32_t params[SCRIPT_PARAMS];               //< p0 to p7, 16.16
+    uint8_t out[3];                              //< Registers of r, g and b
+    tasks_t *tasks;                              //< Pool to run on, NULL for the calling thread
+    int reg_files;                               //< Register files in regs, one per thread
+    int32_t (*regs)[SCRIPT_BATCH];
+} script_t;
+
+
+script_t *script_compile(const char *source, char *error, int error_size);
+void script_destroy(script_t *script);
+int script_param(script_t *script, int index, double value);
+void script_run(script_t *script, const canvas_t *canvas, ws2811_led_t *leds, int count, uint64_t time_us);
+
+
+#endif /* __SCRIPT_H__ */
@@ -0,0 +1,253 @@
+/*
+ * slew.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slew.h"
+
+
+/*
+ * Linear light follows the same square law as keyframes.  Going back to
+ * colors looks up the nearest color value.  The tables give every color
+ * back exactly from its own linear value, so settled content at full level
+ * passes through unchanged without a special case.
+ *
+ * slew_apply() makes two passes.  The step in linear light is branch free,
+ * with the square law computed rather than looked up and the limits as
+ * selects, so the compiler vectorizes it.  Going back to colors is a table
+ * lookup per value, which NEON can't vectorize, and stays a scalar loop.
+ */
+
+
+static uint32_t isqrt32(uint32_t x)
+{
+    uint32_t root = 0, bit = 1U << 30;
+
+    while (bit > x)
+    {
+        bit >>= 2;
+    }
+    while (bit)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+// Nearest color value of a linear light value
+static uint8_t color_of(uint32_t linear)
+{
+    uint32_t x = (uint32_t)((((uint64_t)linear * 65025) + 32767) / 65535);
+    uint32_t root = isqrt32(x);
+
+    return root + (x > (root * root) + root);
+}
+
+// Linear light of a color value, the to_linear table without the lookup
+static inline int32_t linear_of(uint32_t color)
+{
+    return ((color * color * 65535) + (65025 / 2)) / 65025;
+}
+
+// One of red, green or blue moved towards its target, returns the change
+static inline int32_t channel_step(uint16_t *linear, uint16_t *shown, uint32_t color, int32_t limit,
+                                   uint32_t level)
+{
+    int32_t current = *linear;
+    int32_t delta = linear_of(color) - current;
+
+    delta = (delta > limit) ? limit : delta;
+    delta = (delta < -limit) ? -limit : delta;
+    current += delta;
+    *linear = current;
+    *shown = ((uint32_t)current * level) >> 16;
+
+    return delta;
+}
+
+/**
+ * Create a slew limiter, starting dark at full level and with no limit.
+ *
+ * @param    count  Number of LEDs.
+ *
+ * @returns  Limiter, NULL on bad arguments or if out of memory.
+ */
+slew_t *slew_create(int count)
+{
+    slew_t *slew;
+    int i;
+
+    if (count < 0)
+    {
+        return NULL;
+    }
+
+    slew = calloc(1, sizeof(*slew));
+    if (!slew)
+    {
+        return NULL;
+    }
+
+    slew->count = count;
+    slew->max_step = SLEW_UNLIMITED;
+    slew->level = slew->level_target = SLEW_LEVEL_ONE;
+    slew->linear = calloc(count ? (count * 3) : 1, sizeof(*slew->linear));
+    slew->shown = calloc(count ? (count * 3) : 1, sizeof(*slew->shown));
+    if (!slew->linear || !slew->shown)
+    {
+        slew_destroy(slew);
+        return NULL;
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        slew->to_linear[i] = (((uint32_t)i * i * 65535) + (65025 / 2)) / 65025;
+    }
+
+    for (i = 0; i < SLEW_LINEAR_STEPS; i++)
+    {
+        slew->to_color[i] = color_of((i * (65536 / SLEW_LINEAR_STEPS)) + (65536 / SLEW_LINEAR_STEPS / 2));
+    }
+
+    for (i = 0; i < SLEW_LINEAR_DARK; i++)
+    {
+        slew->to_color_dark[i] = color_of(i);
+    }
+
+    return slew;
+}
+
+/**
+ * Free a slew limiter.
+ *
+ * @param    slew  Limiter, may be NULL.
+ *
+ * @returns  None
+ */
+void slew_destroy(slew_t *slew)
+{
+    if (slew)
+    {
+        free(slew->shown);
+        free(slew->linear);
+        free(slew);
+    }
+}
+
+/**
+ * Ramp the global level to a brightness.
+ *
+ * @param    slew        Limiter.
+ * @param    brightness  Level to end at, 255 for full.
+ * @param    frames      Calls to slew_apply() the ramp takes, 0 to jump.
+ *
+ * @returns  None
+ */
+void slew_ramp(slew_t *slew, uint8_t brightness, int frames)
+{
+    uint32_t distance;
+
+    slew->level_target = ((brightness * SLEW_LEVEL_ONE) + 127) / 255;
+    distance = (slew->level > slew->level_target) ? (slew->level - slew->level_target) :
+                                                    (slew->level_target - slew->level);
+
+    if (frames <= 0)
+    {
+        slew->level = slew->level_target;
+        slew->level_step = 0;
+        return;
+    }
+
+    slew->level_step = (distance + frames - 1) / frames;
+}
+
+/**
+ * Move the LEDs one step towards new colors and apply the global level.
+ *
+ * @param    slew    Limiter.
+ * @param    target  Colors to move towards, 0x00RRGGBB.
+ * @param    leds    Filled with the colors to show, may be target.
+ *
+ * @returns  1 if LEDs or the level are still moving, 0 once settled.
+ */
+int slew_apply(slew_t *slew, const ws2811_led_t *target, ws2811_led_t *leds)
+{
+    uint16_t *restrict linear = slew->linear;
+    uint16_t *restrict shown = slew->shown;
+    const uint8_t *to_color = slew->to_color, *to_color_dark = slew->to_color_dark;
+    int32_t limit = slew->max_step;
+    uint32_t level, moving = 0;
+    int i, count = slew->count;
+
+    if (slew->level < slew->level_target)
+    {
+        slew->level = ((slew->level_target - slew->level) > slew->level_step) ?
+                      (slew->level + slew->level_step) : slew->level_target;
+    }
+    else if (slew->level > slew->level_target)
+    {
+        slew->level = ((slew->level - slew->level_target) > slew->level_step) ?
+                      (slew->level - slew->level_step) : slew->level_target;
+    }
+    level = slew->level;
+
+    for (i = 0; i < count; i++)
+    {
+        ws2811_led_t color = target[i];
+
+        moving |= channel_step(&linear[(i * 3) + 0], &shown[(i * 3) + 0], (color >> 16) & 0xff, limit, level);
+        moving |= channel_step(&linear[(i * 3) + 1], &shown[(i * 3) + 1], (color >> 8) & 0xff, limit, level);
+        moving |= channel_step(&linear[(i * 3) + 2], &shown[(i * 3) + 2], color & 0xff, limit, level);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t r = shown[(i * 3) + 0], g = shown[(i * 3) + 1], b = shown[(i * 3) + 2];
+
+        r = (r < SLEW_LINEAR_DARK) ? to_color_dark[r] : to_color[r >> 4];
+        g = (g < SLEW_LINEAR_DARK) ? to_color_dark[g] : to_color[g >> 4];
+        b = (b < SLEW_LINEAR_DARK) ? to_color_dark[b] : to_color[b >> 4];
+        leds[i] = (r << 16) | (g << 8) | b;
+    }
+
+    return (moving != 0) || (slew->level != slew->level_target);
+}
@@ -0,0 +1,77 @@
+/*
+ * slew.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __SLEW_H__
+#define __SLEW_H__
+
+#include <stdint.h>
+
+#include "ws2811-pcm.h"
+
+
+/*
+ * Slew rate limiting and brightness ramps.  Each LED follows the colors
+ * given to slew_apply() with its red, green and blue changing by at most
+ * max_step per call in linear light, so hard cuts in the content become
+ * short fades instead of flicker and current surges.  The output is also
+ * scaled by a global level, ramped by slew_ramp() for fade ins and fade
+ * outs.  Both happen in the same pass over the LEDs.
+ *
+ * Call slew_apply() once per refresh, not just when the content changes,
+ * until it returns 0.
+ */
+
+#define SLEW_UNLIMITED                           65535       // max_step that jumps straight to the target
+#define SLEW_LEVEL_ONE                           (1 << 16)   // Full level
+#define SLEW_LINEAR_STEPS                        4096        // Entries of the linear to color table
+#define SLEW_LINEAR_DARK                         256         // Linear values looked up exactly
+
+typedef struct
+{
+    int count;                                   //< Number of LEDs
+    uint32_t max_step;                           //< Largest change per call, linear light out of 65535
+    uint32_t level;                              //< Global level, SLEW_LEVEL_ONE for full
+    uint32_t level_target;                       //< Level the ramp ends at
+    uint32_t level_step;                         //< Level change per call while ramping
+    uint16_t *linear;                            //< Red, green and blue of each LED shown, in linear light
+    uint16_t *shown;                             //< Same after the level, scratch for slew_apply()
+    uint16_t to_linear[256];                     //< Color value to linear light
+    uint8_t to_color[SLEW_LINEAR_STEPS];         //< Linear light to color value, by the top 12 bits
+    uint8_t to_color_dark[SLEW_LINEAR_DARK];     //< Same for the darkest values, where the curve is steep
+} slew_t;
+
+
+slew_t *slew_create(int count);
+void slew_destroy(slew_t *slew);
+void slew_ramp(slew_t *slew, uint8_t brightness, int frames);
+int slew_apply(slew_t *slew, const ws2811_led_t *target, ws2811_led_t *leds);
+
+
+#endif /* __SLEW_H__ */
@@ -0,0 +1,391 @@
+/*
+ * tasks.c
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tasks.h"
+
+
+/*
+ * Each thread has a range of tile numbers, head and tail packed in one 64
+ * bit word.  The owner takes tiles from the head and thieves from the tail,
+ * both with a compare and swap of the whole word, so a tile is handed out
+ * exactly once without locks.  The ranges are only rewritten by
+ * tasks_run() while no worker looks at them.
+ *
+ * The lock and condition variables only wake the workers for a new run and
+ * the caller when the last tile finishes.  A run bumps the generation,
+ * workers count themselves active while working on it, and the next run
+ * waits for stragglers from the previous one to leave before dealing out
+ * new tiles.
+ */
+
+typedef struct
+{
+    uint64_t range;                              // Head in the low half, tail in the high half
+} __attribute__((aligned(64))) tasks_queue_t;
+
+struct tasks
+{
+    int threads;
+    pthread_t thread[TASKS_MAX];
+    tasks_queue_t queue[TASKS_MAX];
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;                         // New run or stop, for the workers
+    pthread_cond_t done;                         // Last tile done or last worker left, for the caller
+    unsigned generation;                         // Runs so far
+    int active;                                  // Workers inside a run
+    int stop;
+
+    // The current run, written under the lock before bumping the generation
+    tasks_fn_t fn;
+    void *arg;
+    int count;
+    int grain;
+
+    int remaining __attribute__((aligned(64)));  // Tiles not finished yet
+};
+
+typedef struct
+{
+    tasks_t *tasks;
+    int index;
+} tasks_worker_t;
+
+
+static inline int queue_pop(tasks_queue_t *queue)
+{
+    uint64_t range = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+
+    while ((uint32_t)range < (uint32_t)(range >> 32))
+    {
+        if (__atomic_compare_exchange_n(&queue->range, &range, range + 1, 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            return (uint32_t)range;
+        }
+    }
+
+    return -1;
+}
+
+static inline int queue_steal(tasks_queue_t *queue)
+{
+    uint64_t range = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+
+    while ((uint32_t)range < (uint32_t)(range >> 32))
+    {
+        if (__atomic_compare_exchange_n(&queue->range, &range, range - (1ULL << 32), 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            return (uint32_t)(range >> 32) - 1;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Work on the run until no thread has tiles left.
+ *
+ * @param    tasks   Pool.
+ * @param    index   Thread, 0 for the caller.
+ * @param    fn      Task function of the run.
+ * @param    arg     Its argument.
+ * @param    count   Items in the run.
+ * @param    grain   Items per tile.
+ *
+ * @returns  None
+ */
+static void tasks_work(tasks_t *tasks, int index, tasks_fn_t fn, void *arg, int count, int grain)
+{
+    int victim = index, tile;
+
+    for (;;)
+    {
+        tile = queue_pop(&tasks->queue[index]);
+
+        // Out of tiles, go round the others once for one to steal
+        while (tile < 0)
+        {
+            victim = (victim + 1) % tasks->threads;
+            if (victim == index)
+            {
+                return;
+            }
+            tile = queue_steal(&tasks->queue[victim]);
+        }
+        victim = index;
+
+        int first = tile * grain;
+
+        fn(arg, first, ((count - first) < grain) ? (count - first) : grain, index);
+
+        if (!__atomic_sub_fetch(&tasks->remaining, 1, __ATOMIC_ACQ_REL))
+        {
+            pthread_mutex_lock(&tasks->lock);
+            pthread_cond_broadcast(&tasks->done);
+            pthread_mutex_unlock(&tasks->lock);
+        }
+    }
+}
+
+static void *tasks_thread(void *param)
+{
+    tasks_worker_t *worker = param;
+    tasks_t *tasks = worker->tasks;
+    int index = worker->index;
+    unsigned seen = 0;
+
+    free(worker);
+
+    pthread_mutex_lock(&tasks->lock);
+    for (;;)
+    {
+        while ((tasks->generation == seen) && !tasks->stop)
+        {
+            pthread_cond_wait(&tasks->wake, &tasks->lock);
+        }
+        if (tasks->stop)
+        {
+            break;
+        }
+
+        tasks_fn_t fn = tasks->fn;
+        void *arg = tasks->arg;
+        int count = tasks->count, grain = tasks->grain;
+
+        seen = tasks->generation;
+        tasks->active++;
+        pthread_mutex_unlock(&tasks->lock);
+
+        tasks_work(tasks, index, fn, arg, count, grain);
+
+        pthread_mutex_lock(&tasks->lock);
+        if (!--tasks->active)
+        {
+            pthread_cond_broadcast(&tasks->done);
+        }
+    }
+    pthread_mutex_unlock(&tasks->lock);
+
+    return NULL;
+}
+
+
+/**
+ * Start a pool.
+ *
+ * @param    threads  Threads to work on, the calling thread included, up to
+ *                    TASKS_MAX.  0 for one per online CPU, 1 runs everything
+ *                    on the calling thread.
+ *
+ * @returns  Pool, or NULL on bad arguments or failure to start the threads.
+ */
+tasks_t *tasks_create(int threads)
+{
+    tasks_t *tasks;
+    int i;
+
+    if (!threads)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        threads = (cpus < 1) ? 1 : ((cpus > TASKS_MAX) ? TASKS_MAX : cpus);
+    }
+    if ((threads < 1) || (threads > TASKS_MAX))
+    {
+        return NULL;
+    }
+
+    if (posix_memalign((void **)&tasks, 64, sizeof(*tasks)))
+    {
+        return NULL;
+    }
+
+    *tasks = (tasks_t){ .threads = 1 };
+    pthread_mutex_init(&tasks->lock, NULL);
+    pthread_cond_init(&tasks->wake, NULL);
+    pthread_cond_init(&tasks->done, NULL);
+
+    for (i = 1; i < threads; i++)
+    {
+        tasks_worker_t *worker = malloc(sizeof(*worker));
+
+        if (!worker)
+        {
+            tasks_destroy(tasks);
+            return NULL;
+        }
+        *worker = (tasks_worker_t){ .tasks = tasks, .index = i };
+
+        if (pthread_create(&tasks->thread[i], NULL, tasks_thread, worker))
+        {
+            free(worker);
+            tasks_destroy(tasks);
+            return NULL;
+        }
+        tasks->threads++;
+    }
+
+    return tasks;
+}
+
+/**
+ * Stop the threads of a pool and free it.
+ *
+ * @param    tasks  Pool from tasks_create(), may be NULL.
+ *
+ * @returns  None
+ */
+void tasks_destroy(tasks_t *tasks)
+{
+    int i;
+
+    if (!tasks)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&tasks->lock);
+    tasks->stop = 1;
+    pthread_cond_broadcast(&tasks->wake);
+    pthread_mutex_unlock(&tasks->lock);
+
+    for (i = 1; i < tasks->threads; i++)
+    {
+        pthread_join(tasks->thread[i], NULL);
+    }
+
+    pthread_cond_destroy(&tasks->done);
+    pthread_cond_destroy(&tasks->wake);
+    pthread_mutex_destroy(&tasks->lock);
+    free(tasks);
+}
+
+/**
+ * Threads a pool works on.
+ *
+ * @param    tasks  Pool, may be NULL.
+ *
+ * @returns  Threads including the calling one, 1 without a pool.
+ */
+int tasks_threads(const tasks_t *tasks)
+{
+    return tasks ? tasks->threads : 1;
+}
+
+/**
+ * Items per tile for a size per item, so a tile's working data is about
+ * TASKS_TILE_BYTES.
+ *
+ * @param    item_bytes  Bytes read and written per item.
+ * @param    multiple    Round to a multiple of this, for batched kernels.
+ *
+ * @returns  Items per tile, at least multiple.
+ */
+int tasks_grain(int item_bytes, int multiple)
+{
+    int grain = TASKS_TILE_BYTES / ((item_bytes > 0) ? item_bytes : 1);
+
+    multiple = (multiple > 0) ? multiple : 1;
+    grain -= grain % multiple;
+
+    return (grain > multiple) ? grain : multiple;
+}
+
+/**
+ * Run fn over items 0 to count - 1 in tiles of grain items and wait for all
+ * of them.  Without a pool, or with a single tile, fn runs once over the
+ * whole range on the calling thread.
+ *
+ * @param    tasks  Pool, may be NULL.
+ * @param    fn     Task function.
+ * @param    arg    Argument passed to fn.
+ * @param    count  Items.
+ * @param    grain  Items per tile.
+ *
+ * @returns  None
+ */
+void tasks_run(tasks_t *tasks, tasks_fn_t fn, void *arg, int count, int grain)
+{
+    int tiles, i;
+
+    if (count <= 0)
+    {
+        return;
+    }
+
+    grain = (grain > 0) ? grain : 1;
+    tiles = ((count - 1) / grain) + 1;
+
+    if (!tasks || (tasks->threads == 1) || (tiles == 1))
+    {
+        fn(arg, 0, count, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&tasks->lock);
+    while (tasks->active)
+    {
+        pthread_cond_wait(&tasks->done, &tasks->lock);
+    }
+
+    // Contiguous shares, so neighbouring tiles mostly stay on one core
+    for (i = 0; i < tasks->threads; i++)
+    {
+        uint64_t head = ((int64_t)tiles * i) / tasks->threads;
+        uint64_t tail = ((int64_t)tiles * (i + 1)) / tasks->threads;
+
+        __atomic_store_n(&tasks->queue[i].range, head | (tail << 32), __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&tasks->remaining, tiles, __ATOMIC_RELEASE);
+
+    tasks->fn = fn;
+    tasks->arg = arg;
+    tasks->count = count;
+    tasks->grain = grain;
+    tasks->generation++;
+    pthread_cond_broadcast(&tasks->wake);
+    pthread_mutex_unlock(&tasks->lock);
+
+    tasks_work(tasks, 0, fn, arg, count, grain);
+
+    pthread_mutex_lock(&tasks->lock);
+    while (__atomic_load_n(&tasks->remaining, __ATOMIC_ACQUIRE))
+    {
+        pthread_cond_wait(&tasks->done, &tasks->lock);
+    }
+    pthread_mutex_unlock(&tasks->lock);
+}
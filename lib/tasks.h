@@ -0,0 +1,67 @@
+/*
+ * tasks.h
+ *
+ * Copyright (c) 2026 agent <agent @ local>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ *     1.  Redistributions of source code must retain the above copyright notice, this list of
+ *         conditions and the following disclaimer.
+ *     2.  Redistributions in binary form must reproduce the above copyright notice, this list
+ *         of conditions and the following disclaimer in the documentation and/or other materials
+ *         provided with the distribution.
+ *     3.  Neither the name of the owner nor the names of its contributors may be used to endorse
+ *         or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef __TASKS_H__
+#define __TASKS_H__
+
+
+/*
+ * Small fork-join pool for splitting a frame's per LED work over the CPU
+ * cores.  tasks_run() cuts a range of items into tiles, deals the tiles out
+ * to the workers and the calling thread, and returns once every tile is
+ * done.  A worker that runs out of tiles steals from the far end of another
+ * worker's, so a slow tile or a core busy with something else doesn't hold
+ * up the frame.
+ *
+ * Tiles should be about TASKS_TILE_BYTES of working data, tasks_grain()
+ * gives the items per tile for a size per item.  tasks_run() must only be
+ * called from one thread at a time, and not from within a task.
+ */
+
+#define TASKS_TILE_BYTES                         16384       // Working data per tile, half the L1 of a Pi 3
+#define TASKS_MAX                                16          // Threads per pool, calling thread included
+
+typedef struct tasks tasks_t;
+
+/*
+ * Work on items first to first + count - 1.  worker is 0 for the calling
+ * thread and below tasks_threads() for the others, for per thread scratch.
+ */
+typedef void (*tasks_fn_t)(void *arg, int first, int count, int worker);
+
+
+tasks_t *tasks_create(int threads);
+void tasks_destroy(tasks_t *tasks);
+int tasks_threads(const tasks_t *tasks);
+int tasks_grain(int item_bytes, int multiple);
+void tasks_run(tasks_t *tasks, tasks_fn_t fn, void *arg, int count, int grain);
+
+
+#endif /* __TASKS_H__ */
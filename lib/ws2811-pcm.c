@@ -29,6 +29,7 @@
  */
 
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,6 +40,8 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <signal.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "mailbox.h"
 #include "clk.h"
@@ -46,8 +49,11 @@
 #include "dma.h"
 #include "pcm.h"
 #include "rpihw.h"
-
-#include "gamma.h"
+#include "pmu.h"
+#include "metrics.h"
+#include "latency.h"
+#include "emu.h"
+#include "encode.h"
 
 #include "ws2811-pcm.h"
 
@@ -64,10 +70,12 @@
 // Pad out to the nearest uint32 + 32-bits for idle low/high times the number of channels
 #define PCM_BYTE_COUNT(leds, freq)               ((((LED_BIT_COUNT(leds, freq) >> 3) & ~0x7) + 4) + 4)
 
-#define SYMBOL_HIGH                              0x6  // 1 1 0
-#define SYMBOL_LOW                               0x4  // 1 0 0
+// Time for the PCM to clock out n bytes, 3 symbols per bit
+#define PCM_WIRE_NS(bytes, freq)                 (((bytes) * 8ULL * 1000000000ULL) / ((freq) * 3))
+
+#define PCM_FIFO_BYTES                           (64 * 4)   // 64 entry 32-bit TX FIFO
 
-#define ARRAY_SIZE(stuff)                        (sizeof(stuff) / sizeof(stuff[0]))
+#define CM_PCM_TIMEOUT_US                        10000      // Clock start/stop, normally < 1us
 
 
 // We use the mailbox interface to request memory from the VideoCore.
@@ -94,8 +102,26 @@ typedef struct ws2811_device
     volatile cm_pcm_t *cm_pcm;
     videocore_mbox_t mbox;
     int max_count;
+    pmu_t pmu;
+    pthread_t pmu_thread;                        // Thread the PMU counters count
+    ws2811_stats_t stats;
+    metrics_t *metrics;
+    latency_t *latency;
+    emu_t *emu;
+    encoder_t encoder;
+    encode_fn_t encode;
+    int *power_fit;                              // Brightness fitting each power zone last frame
+    uint64_t wire_ns;                            // Time a frame takes on the wire, reset included
+    uint64_t wire_start_ns;                      // When the last frame's DMA was started
 } ws2811_device_t;
 
+// Point in time between two render stages, used for the render statistics
+typedef struct
+{
+    struct timespec ts;
+    uint64_t pmu[PMU_COUNT];
+} stage_mark_t;
+
 /**
  * Return the channel led count.
  *
@@ -108,6 +134,38 @@ static int max_channel_led_count(ws2811_t *ws2811)
     return ws2811->channel->count;
 }
 
+/**
+ * Let the emulated hardware catch up with register writes and elapsed time.
+ * Must be called from every loop polling a register.  No-op on real hardware.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  None
+ */
+static inline void hw_sync(ws2811_t *ws2811)
+{
+    if (ws2811->device->emu)
+    {
+        emu_update(ws2811->device->emu);
+    }
+}
+
+/**
+ * Count an error in the statistics.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    error   One of the WS2811_ERROR_xxx types.
+ *
+ * @returns  None
+ */
+static void error_account(ws2811_t *ws2811, int error)
+{
+    ws2811_stats_t *stats = &ws2811->device->stats;
+
+    stats->last_error = error;
+    stats->errors[error]++;
+}
+
 /**
  * Map all devices into userspace memory.
  *
@@ -122,6 +180,16 @@ static int map_registers(ws2811_t *ws2811)
     uint32_t base = ws2811->rpi_hw->periph_base;
     uint32_t dma_addr;
 
+    if (device->emu)
+    {
+        device->dma = &device->emu->dma;
+        device->pcm = &device->emu->pcm;
+        device->gpio = &device->emu->gpio;
+        device->cm_pcm = &device->emu->cm_pcm;
+
+        return 0;
+    }
+
     dma_addr = dmanum_to_offset(ws2811->dmanum);
     if (!dma_addr)
     {
@@ -167,6 +235,11 @@ static void unmap_registers(ws2811_t *ws2811)
 {
     ws2811_device_t *device = ws2811->device;
 
+    if (device->emu)
+    {
+        return;
+    }
+
     if (device->dma)
     {
         unmapmem((void *)device->dma, sizeof(dma_t));
@@ -205,14 +278,53 @@ static uint32_t addr_to_bus(ws2811_device_t *device, const volatile void *virt)
     return mbox->bus_addr + offset;
 }
 
+static uint64_t ts_to_ns(const struct timespec *ts)
+{
+    return (ts->tv_sec * 1000000000ULL) + ts->tv_nsec;
+}
+
+/**
+ * Wait for the PCM clock to reach the requested busy state.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    busy    Non-zero to wait for the clock to run, zero for it to stop.
+ *
+ * @returns  0 on success, -1 on timeout.
+ */
+static int cm_pcm_wait(ws2811_t *ws2811, int busy)
+{
+    volatile cm_pcm_t *cm_pcm = ws2811->device->cm_pcm;
+    struct timespec ts;
+    uint64_t deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    deadline = ts_to_ns(&ts) + (CM_PCM_TIMEOUT_US * 1000ULL);
+
+    hw_sync(ws2811);
+    while (!(cm_pcm->ctl & CM_PCM_CTL_BUSY) == !!busy)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        if (ts_to_ns(&ts) > deadline)
+        {
+            error_account(ws2811, WS2811_ERROR_CLK_TIMEOUT);
+            return -1;
+        }
+
+        usleep(1);
+        hw_sync(ws2811);
+    }
+
+    return 0;
+}
+
 /**
  * Stop the PCM controller.
  *
  * @param    ws2811  ws2811 instance pointer.
  *
- * @returns  None
+ * @returns  0 on success, -1 if the clock didn't stop.
  */
-static void stop_pcm(ws2811_t *ws2811)
+static int stop_pcm(ws2811_t *ws2811)
 {
     ws2811_device_t *device = ws2811->device;
     volatile pcm_t *pcm = device->pcm;
@@ -225,37 +337,65 @@ static void stop_pcm(ws2811_t *ws2811)
     // Kill the clock if it was already running
     cm_pcm->ctl = CM_PCM_CTL_PASSWD | CM_PCM_CTL_KILL;
     usleep(10);
-    while (cm_pcm->ctl & CM_PCM_CTL_BUSY)
-        ;
+
+    return cm_pcm_wait(ws2811, 0);
 }
 
 /**
- * Setup the PCM controller with one 32-bit channel in a 32-bit frame using DMA to feed the PCM FIFO.
+ * Initialize the DMA control block to stream the whole PCM buffer to the PCM TX FIFO.
  *
  * @param    ws2811  ws2811 instance pointer.
  *
  * @returns  None
  */
+static void dma_cb_init(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+    volatile dma_cb_t *dma_cb = device->dma_cb;
+    int maxcount = max_channel_led_count(ws2811);
+
+    dma_cb->ti = RPI_DMA_TI_NO_WIDE_BURSTS |  // 32-bit transfers
+                 RPI_DMA_TI_WAIT_RESP |       // wait for write complete
+                 RPI_DMA_TI_DEST_DREQ |       // user peripheral flow control
+                 RPI_DMA_TI_PERMAP(2) |       // PCM TX peripheral
+                 RPI_DMA_TI_SRC_INC;          // Increment src addr
+
+    dma_cb->source_ad = addr_to_bus(device, device->pcm_raw);
+    dma_cb->dest_ad = PCM_PERIPH_PHYS + offsetof(pcm_t, fifo);
+    dma_cb->txfr_len = PCM_BYTE_COUNT(maxcount, ws2811->freq);
+    dma_cb->stride = 0;
+    dma_cb->nextconbk = 0;
+}
+
+/**
+ * Setup the PCM controller with one 32-bit channel in a 32-bit frame using DMA to feed the PCM FIFO.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  0 on success, -1 if the clock didn't start or stop.
+ */
 static int setup_pcm(ws2811_t *ws2811)
 {
     ws2811_device_t *device = ws2811->device;
     volatile dma_t *dma = device->dma;
-    volatile dma_cb_t *dma_cb = device->dma_cb;
     volatile pcm_t *pcm = device->pcm;
     volatile cm_pcm_t *cm_pcm = device->cm_pcm;
-    int maxcount = max_channel_led_count(ws2811);
     uint32_t freq = ws2811->freq;
-    int32_t byte_count;
 
-    stop_pcm(ws2811);
+    if (stop_pcm(ws2811))
+    {
+        return -1;
+    }
 
     // Setup the PCM Clock - Use OSC @ 19.2Mhz w/ 3 clocks/tick
     cm_pcm->div = CM_PCM_DIV_PASSWD | CM_PCM_DIV_DIVI(OSC_FREQ / (3 * freq));
     cm_pcm->ctl = CM_PCM_CTL_PASSWD | CM_PCM_CTL_SRC_OSC;
     cm_pcm->ctl = CM_PCM_CTL_PASSWD | CM_PCM_CTL_SRC_OSC | CM_PCM_CTL_ENAB;
     usleep(10);
-    while (!(cm_pcm->ctl & CM_PCM_CTL_BUSY))
-        ;
+    if (cm_pcm_wait(ws2811, 1))
+    {
+        return -1;
+    }
 
     // Setup the PCM, use delays as the block is rumored to lock up without them.  Make
     // sure to use a high enough priority to avoid any FIFO underruns, especially if
@@ -273,19 +413,7 @@ static int setup_pcm(ws2811_t *ws2811)
     pcm->cs |= RPI_PCM_CS_DMAEN;         // Enable DMA DREQ
     pcm->dreq = (RPI_PCM_DREQ_TX(0x3F) | RPI_PCM_DREQ_TX_PANIC(0x10)); // Set FIFO tresholds
 
-    // Initialize the DMA control block
-    byte_count = PCM_BYTE_COUNT(maxcount, freq);
-    dma_cb->ti = RPI_DMA_TI_NO_WIDE_BURSTS |  // 32-bit transfers
-                 RPI_DMA_TI_WAIT_RESP |       // wait for write complete
-                 RPI_DMA_TI_DEST_DREQ |       // user peripheral flow control
-                 RPI_DMA_TI_PERMAP(2) |       // PCM TX peripheral
-                 RPI_DMA_TI_SRC_INC;          // Increment src addr
-
-    dma_cb->source_ad = addr_to_bus(device, device->pcm_raw);
-    dma_cb->dest_ad = (uint32_t)&((pcm_t *)PCM_PERIPH_PHYS)->fifo;
-    dma_cb->txfr_len = byte_count;
-    dma_cb->stride = 0;
-    dma_cb->nextconbk = 0;
+    dma_cb_init(ws2811);
 
     dma->cs = 0;
     dma->txfr_len = 0;
@@ -293,6 +421,60 @@ static int setup_pcm(ws2811_t *ws2811)
     return 0;
 }
 
+/**
+ * Translate the DMA debug register error bits into an error type.
+ *
+ * @param    debug  DMA debug register value.
+ *
+ * @returns  One of the WS2811_ERROR_xxx DMA error types.
+ */
+static int dma_error_decode(uint32_t debug)
+{
+    if (debug & RPI_DMA_DEBUG_READ_LAST_NOT_SET_ERROR)
+    {
+        return WS2811_ERROR_DMA_READ_LAST;
+    }
+
+    if (debug & RPI_DMA_DEBUG_READ_ERROR)
+    {
+        return WS2811_ERROR_DMA_READ;
+    }
+
+    if (debug & RPI_DMA_DEBUG_FIFO_ERROR)
+    {
+        return WS2811_ERROR_DMA_FIFO;
+    }
+
+    return WS2811_ERROR_GENERIC;
+}
+
+/**
+ * Bring the DMA channel back into a usable state after an error.  Read and FIFO
+ * errors are caused by bus contention and only need the error flags cleared, a
+ * read last not set error means the control block can't be trusted anymore.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    error   One of the WS2811_ERROR_xxx DMA error types.
+ *
+ * @returns  None
+ */
+static void dma_recover(ws2811_t *ws2811, int error)
+{
+    volatile dma_t *dma = ws2811->device->dma;
+
+    dma->cs = RPI_DMA_CS_RESET;
+    usleep(10);
+
+    dma->debug = RPI_DMA_DEBUG_READ_ERROR | RPI_DMA_DEBUG_FIFO_ERROR |
+                 RPI_DMA_DEBUG_READ_LAST_NOT_SET_ERROR;
+    hw_sync(ws2811);
+
+    if (error == WS2811_ERROR_DMA_READ_LAST)
+    {
+        dma_cb_init(ws2811);
+    }
+}
+
 /**
  * Start the DMA feeding the PCM TX FIFO.  This will stream the entire DMA buffer.
  *
@@ -320,7 +502,383 @@ static void dma_start(ws2811_t *ws2811)
               RPI_DMA_CS_PRIORITY(15) |
               RPI_DMA_CS_ACTIVE;
 
-    pcm->cs |= RPI_PCM_CS_TXON;  // Start transmission
+    pcm->cs |= RPI_PCM_CS_TXERR | RPI_PCM_CS_TXON;  // Clear the end of frame underrun, start transmission
+
+    hw_sync(ws2811);
+}
+
+/**
+ * Record the wall clock time and PMU counters at a render stage boundary.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    mark    Stage boundary to fill in.
+ *
+ * @returns  None
+ */
+static void stage_mark(ws2811_t *ws2811, stage_mark_t *mark)
+{
+    pmu_read(&ws2811->device->pmu, mark->pmu);
+    clock_gettime(CLOCK_MONOTONIC, &mark->ts);
+}
+
+/**
+ * Move the PMU counters to the calling thread.  perf_event_open() counts a
+ * single thread, so if rendering moved to another thread than the one that
+ * opened them, they are opened again for this one.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  None
+ */
+static void pmu_follow(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+
+    if (pthread_equal(device->pmu_thread, pthread_self()))
+    {
+        return;
+    }
+
+    pmu_close(&device->pmu);
+    device->stats.pmu = !pmu_open(&device->pmu);
+    device->pmu_thread = pthread_self();
+}
+
+/**
+ * Account the difference between two stage boundaries to a render stage.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    stage   One of the WS2811_STAGE_xxx constants.
+ * @param    start   Boundary at the start of the stage.
+ * @param    end     Boundary at the end of the stage.
+ *
+ * @returns  None
+ */
+static void stage_account(ws2811_t *ws2811, int stage, stage_mark_t *start, stage_mark_t *end)
+{
+    ws2811_stats_t *stats = &ws2811->device->stats;
+    ws2811_stage_stats_t *last = &stats->last[stage];
+    ws2811_stage_stats_t *total = &stats->total[stage];
+
+    last->ns = ((end->ts.tv_sec - start->ts.tv_sec) * 1000000000ULL) +
+               end->ts.tv_nsec - start->ts.tv_nsec;
+    last->cycles = end->pmu[PMU_CYCLES] - start->pmu[PMU_CYCLES];
+    last->instructions = end->pmu[PMU_INSTRUCTIONS] - start->pmu[PMU_INSTRUCTIONS];
+    last->cache_misses = end->pmu[PMU_CACHE_MISSES] - start->pmu[PMU_CACHE_MISSES];
+
+    total->ns += last->ns;
+    total->cycles += last->cycles;
+    total->instructions += last->instructions;
+    total->cache_misses += last->cache_misses;
+}
+
+/**
+ * Account a completed ws2811_render() call in the render time histogram.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    start   Boundary at the start of the render call.
+ * @param    end     Boundary at the end of the render call.
+ *
+ * @returns  None
+ */
+static void render_account(ws2811_t *ws2811, stage_mark_t *start, stage_mark_t *end)
+{
+    ws2811_stats_t *stats = &ws2811->device->stats;
+    uint64_t ns = ((end->ts.tv_sec - start->ts.tv_sec) * 1000000000ULL) +
+                  end->ts.tv_nsec - start->ts.tv_nsec;
+    int bucket = 0;
+
+    while ((bucket < WS2811_HIST_BUCKETS - 1) && (ns > WS2811_HIST_BOUND_NS(bucket)))
+    {
+        bucket++;
+    }
+
+    stats->frames++;
+    stats->render_ns += ns;
+    stats->render_hist[bucket]++;
+}
+
+/**
+ * Complete the latency measurement of the frame that was on the wire.
+ *
+ * @param    ws2811   ws2811 instance pointer.
+ * @param    watched  Non-zero if the DMA END flag was seen being set just now.
+ *
+ * @returns  None
+ */
+static void latency_done(ws2811_t *ws2811, int watched)
+{
+    ws2811_device_t *device = ws2811->device;
+    uint64_t observed = 0;
+
+    // The DMA is done when the last word went into the FIFO, it still has to drain
+    if (watched)
+    {
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        observed = ts_to_ns(&now) + PCM_WIRE_NS(PCM_FIFO_BYTES, ws2811->freq);
+    }
+
+    if (latency_frame_done(device->latency, observed))
+    {
+        latency_percentiles(device->latency, device->stats.latency);
+    }
+    device->stats.latency_frames = device->latency->count;
+}
+
+/**
+ * Make the current statistics visible to the metrics exporter, if running.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  None
+ */
+static void stats_publish(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+
+    if (device->metrics)
+    {
+        metrics_publish(device->metrics, &device->stats);
+    }
+}
+
+/**
+ * Set up the encoder zones for power limiting.  Each channel zone gets an
+ * encoder zone, plus one for the LEDs past the last of them.  Without zones a
+ * single one covers the channel, so a channel limit alone still works.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  0 on success, -1 otherwise.
+ */
+static int power_zones_init(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+    ws2811_channel_t *channel = ws2811->channel;
+    int zones = channel->zones ? channel->zone_count : 0;
+    int end = 0;
+    int z;
+
+    if (zones < 0)
+    {
+        return -1;
+    }
+
+    device->encoder.zone = calloc(zones + 1, sizeof(*device->encoder.zone));
+    device->power_fit = calloc(zones + 1, sizeof(*device->power_fit));
+    if (!device->encoder.zone || !device->power_fit)
+    {
+        return -1;
+    }
+
+    for (z = 0; z < zones; z++)
+    {
+        if (channel->zones[z].count > 0)
+        {
+            end += channel->zones[z].count;
+        }
+        if (end > channel->count)
+        {
+            end = channel->count;
+        }
+
+        encode_zone_init(&device->encoder.zone[z], end);
+        device->power_fit[z] = 255;
+    }
+
+    encode_zone_init(&device->encoder.zone[zones], channel->count);
+    device->power_fit[zones] = 255;
+
+    return 0;
+}
+
+/**
+ * Estimate the current of each zone at the brightness it would be sent with
+ * under a channel wide cap.
+ *
+ * @param    encoder     Encoder holding the zone histograms.
+ * @param    fit         Brightness fitting each zone's own limit.
+ * @param    cap         Channel wide brightness cap.
+ * @param    current_ua  Current of red, green and blue at full scale.
+ *
+ * @returns  Current of all zones in uA, without the idle current.
+ */
+static uint64_t power_zones_ua(const encoder_t *encoder, const int *fit, int cap,
+                               const uint32_t current_ua[3])
+{
+    uint64_t total = 0;
+    int z;
+
+    for (z = 0; z < encoder->zones; z++)
+    {
+        total += encode_current_ua(encoder->zone[z].hist, (fit[z] < cap) ? fit[z] : cap, current_ua,
+                                   encoder->gamma.table);
+    }
+
+    return total;
+}
+
+/**
+ * Encode the LEDs into the PCM buffer, dimmed if needed to keep the estimated
+ * supply current within the zone and channel power limits.
+ *
+ * The color values of each zone are counted while encoding.  Each zone is
+ * encoded at the brightness that fitted it in the previous frame, through its
+ * own symbol table.  The zone histograms then give the highest brightness
+ * within each zone limit, and a cap over all zones keeps the sum within the
+ * channel limit.  If any zone needs less than it was encoded with, the frame
+ * is encoded again, so no limit is ever exceeded.  If a zone could be
+ * brighter, that only takes effect in the next frame.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  None
+ */
+static void encode_frame(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+    ws2811_channel_t *channel = ws2811->channel;
+    ws2811_stats_t *stats = &device->stats;
+    encoder_t *encoder = &device->encoder;
+    uint32_t *out = (uint32_t *)device->pcm_raw;
+    int zones = channel->zones ? channel->zone_count : 0;
+    uint32_t current_ua[3];
+    uint64_t power_ua = 0, demand_ua = 0;
+    int brightness, sent = 0, dimmed = 0, limited = 0;
+    int start, z;
+
+    if ((channel->power_limit_ma <= 0) && !zones)
+    {
+        encoder->zones = 0;
+        device->encode(encoder, channel, out);
+        return;
+    }
+
+    current_ua[0] = channel->current_red_ua ? channel->current_red_ua : WS2811_CURRENT_DEFAULT_UA;
+    current_ua[1] = channel->current_green_ua ? channel->current_green_ua : WS2811_CURRENT_DEFAULT_UA;
+    current_ua[2] = channel->current_blue_ua ? channel->current_blue_ua : WS2811_CURRENT_DEFAULT_UA;
+    brightness = channel->brightness & 0xff;
+
+    encoder->zones = zones + 1;
+    for (z = 0; z < encoder->zones; z++)
+    {
+        encode_zone_t *zone = &encoder->zone[z];
+
+        zone->brightness = (device->power_fit[z] < brightness) ? device->power_fit[z] : brightness;
+        memset(zone->hist, 0, sizeof(zone->hist));
+    }
+
+    encoder->histogram = 1;
+    device->encode(encoder, channel, out);
+    encoder->histogram = 0;
+
+    // Fit each zone within its own limit
+    for (z = 0, start = 0; z < encoder->zones; z++)
+    {
+        int end = encoder->zone[z].end;
+        int limit_ma = (z < zones) ? channel->zones[z].power_limit_ma : 0;
+
+        if (limit_ma > 0)
+        {
+            uint64_t idle_ua = (uint64_t)channel->current_idle_ua * (end - start);
+            uint64_t budget_ua = (uint64_t)limit_ma * 1000;
+
+            budget_ua = (budget_ua > idle_ua) ? (budget_ua - idle_ua) : 0;
+            device->power_fit[z] = encode_power_fit(encoder->zone[z].hist, brightness, current_ua,
+                                                    encoder->gamma.table, budget_ua);
+        }
+        else
+        {
+            device->power_fit[z] = brightness;
+        }
+
+        start = end;
+    }
+
+    // Cap all zones to fit the channel limit, binary search as for a zone
+    if (channel->power_limit_ma > 0)
+    {
+        uint64_t idle_ua = (uint64_t)channel->current_idle_ua * channel->count;
+        uint64_t budget_ua = (uint64_t)channel->power_limit_ma * 1000;
+        int low = 0, high = brightness;
+
+        budget_ua = (budget_ua > idle_ua) ? (budget_ua - idle_ua) : 0;
+        if (power_zones_ua(encoder, device->power_fit, high, current_ua) > budget_ua)
+        {
+            while (high - low > 1)
+            {
+                int mid = (low + high) / 2;
+
+                if (power_zones_ua(encoder, device->power_fit, mid, current_ua) <= budget_ua)
+                {
+                    low = mid;
+                }
+                else
+                {
+                    high = mid;
+                }
+            }
+
+            for (z = 0; z < encoder->zones; z++)
+            {
+                if (device->power_fit[z] > low)
+                {
+                    device->power_fit[z] = low;
+                }
+            }
+        }
+    }
+
+    for (z = 0; z < encoder->zones; z++)
+    {
+        if (device->power_fit[z] < encoder->zone[z].brightness)
+        {
+            encoder->zone[z].brightness = device->power_fit[z];
+            dimmed = 1;
+        }
+    }
+    if (dimmed)
+    {
+        device->encode(encoder, channel, out);
+    }
+
+    for (z = 0, start = 0; z < encoder->zones; z++)
+    {
+        encode_zone_t *zone = &encoder->zone[z];
+        uint64_t idle_ua = (uint64_t)channel->current_idle_ua * (zone->end - start);
+        uint64_t zone_ua = encode_current_ua(zone->hist, zone->brightness, current_ua, encoder->gamma.table) +
+                           idle_ua;
+
+        if (z < zones)
+        {
+            channel->zones[z].power_ma = zone_ua / 1000;
+            channel->zones[z].brightness = zone->brightness;
+        }
+
+        power_ua += zone_ua;
+        demand_ua += encode_current_ua(zone->hist, brightness, current_ua, encoder->gamma.table) +
+                     idle_ua;
+        if ((zone->end > start) && (zone->brightness > sent))
+        {
+            sent = zone->brightness;
+        }
+        if ((zone->end > start) && (zone->brightness < brightness))
+        {
+            limited = 1;
+        }
+        start = zone->end;
+    }
+
+    stats->power_limit_ma = channel->power_limit_ma;
+    stats->power_ma = power_ua / 1000;
+    stats->power_demand_ma = demand_ua / 1000;
+    stats->power_brightness = sent;
+    if (limited)
+    {
+        stats->power_limited++;
+    }
 }
 
 /**
@@ -384,12 +942,35 @@ void ws2811_cleanup(ws2811_t *ws2811)
     }
     ws2811->channel->leds = NULL;
 
+    ws2811_metrics_stop(ws2811);
+    pmu_close(&device->pmu);
+
+    free(device->latency);
+    device->latency = NULL;
+
+    free(device->encoder.zone);
+    device->encoder.zone = NULL;
+    free(device->power_fit);
+    device->power_fit = NULL;
+
+    if (device->emu) {
+        emu_destroy(device->emu);
+        device->emu = NULL;
+    }
+
     if (device->mbox.handle != -1) {
         videocore_mbox_t *mbox = &device->mbox;
 
-        unmapmem(mbox->virt_addr, mbox->size);
-        mem_unlock(mbox->handle, mbox->mem_ref);
-        mem_free(mbox->handle, mbox->mem_ref);
+        // Undo only the steps ws2811_init() got through
+        if (mbox->virt_addr) {
+            unmapmem(mbox->virt_addr, mbox->size);
+        }
+        if (mbox->bus_addr) {
+            mem_unlock(mbox->handle, mbox->mem_ref);
+        }
+        if (mbox->mem_ref) {
+            mem_free(mbox->handle, mbox->mem_ref);
+        }
         mbox_close(mbox->handle);
 
         mbox->handle = -1;
@@ -421,7 +1002,14 @@ int ws2811_init(ws2811_t *ws2811)
     ws2811_device_t *device;
     const rpi_hw_t *rpi_hw;
 
-    ws2811->rpi_hw = rpi_hw_detect();
+    if (ws2811->flags & WS2811_FLAG_EMULATE)
+    {
+        ws2811->rpi_hw = &emu_rpi_hw;
+    }
+    else
+    {
+        ws2811->rpi_hw = rpi_hw_detect();
+    }
     if (!ws2811->rpi_hw)
     {
         return -1;
@@ -434,6 +1022,16 @@ int ws2811_init(ws2811_t *ws2811)
         return -1;
     }
     device = ws2811->device;
+    memset(device, 0, sizeof(*device));
+    device->pmu.leader = -1;
+    memset(device->pmu.fd, -1, sizeof(device->pmu.fd));
+    device->mbox.handle = -1;
+
+    // Initialize all pointers to NULL.  Any non-NULL pointers will be freed on cleanup.
+    ws2811->channel->leds = NULL;
+
+    encoder_init(&device->encoder);
+    device->encode = (ws2811->flags & WS2811_FLAG_REFERENCE) ? encode_ref : encode_lut;
 
     // Determine how much physical memory we need for DMA
     device->mbox.size = PCM_BYTE_COUNT(max_channel_led_count(ws2811), ws2811->freq) +
@@ -441,31 +1039,47 @@ int ws2811_init(ws2811_t *ws2811)
     // Round up to page size multiple
     device->mbox.size = (device->mbox.size + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1);
 
-    device->mbox.handle = mbox_open();
-    if (device->mbox.handle == -1)
+    if (ws2811->flags & WS2811_FLAG_EMULATE)
     {
-        return -1;
-    }
+        // No VideoCore, the emulator provides the DMA memory and registers
+        device->emu = emu_create(device->mbox.size, ws2811->freq,
+                                 ws2811->flags & WS2811_FLAG_WIRE_TIME, ws2811->faults);
+        if (!device->emu)
+        {
+            goto err;
+        }
 
-    device->mbox.mem_ref = mem_alloc(device->mbox.handle, device->mbox.size, PAGE_SIZE,
-                                     rpi_hw->videocore_base == 0x40000000 ? 0xC : 0x4);
-    if (device->mbox.mem_ref == 0)
-    {
-       return -1;
+        device->mbox.bus_addr = device->emu->bus_addr;
+        device->mbox.virt_addr = device->emu->mem;
     }
-
-    device->mbox.bus_addr = mem_lock(device->mbox.handle, device->mbox.mem_ref);
-    if (device->mbox.bus_addr == (uint32_t) ~0UL)
+    else
     {
-       mem_free(device->mbox.handle, device->mbox.size);
-       return -1;
-    }
-    device->mbox.virt_addr = mapmem(BUS_TO_PHYS(device->mbox.bus_addr), device->mbox.size);
+        device->mbox.handle = mbox_open();
+        if (device->mbox.handle == -1)
+        {
+            goto err;
+        }
 
-    // Initialize all pointers to NULL.  Any non-NULL pointers will be freed on cleanup.
-    device->pcm_raw = NULL;
-    device->dma_cb = NULL;
-    ws2811->channel->leds = NULL;
+        device->mbox.mem_ref = mem_alloc(device->mbox.handle, device->mbox.size, PAGE_SIZE,
+                                         rpi_hw->videocore_base == 0x40000000 ? 0xC : 0x4);
+        if (device->mbox.mem_ref == 0)
+        {
+            goto err;
+        }
+
+        device->mbox.bus_addr = mem_lock(device->mbox.handle, device->mbox.mem_ref);
+        if (device->mbox.bus_addr == (uint32_t) ~0UL)
+        {
+            device->mbox.bus_addr = 0;
+            goto err;
+        }
+
+        device->mbox.virt_addr = mapmem(BUS_TO_PHYS(device->mbox.bus_addr), device->mbox.size);
+        if (!device->mbox.virt_addr)
+        {
+            goto err;
+        }
+    }
 
     // Allocate the LED buffer
     ws2811_channel_t *channel = ws2811->channel;
@@ -481,6 +1095,11 @@ int ws2811_init(ws2811_t *ws2811)
       channel->strip_type=WS2811_STRIP_RGB;
     }
 
+    if (power_zones_init(ws2811))
+    {
+        goto err;
+    }
+
     device->dma_cb = (dma_cb_t *)device->mbox.virt_addr;
     device->pcm_raw = (uint8_t *)device->mbox.virt_addr + sizeof(dma_cb_t);
 
@@ -511,6 +1130,27 @@ int ws2811_init(ws2811_t *ws2811)
         goto err;
     }
 
+    // Optional instrumentation, a missing PMU is not fatal and just reads as zero
+    if (ws2811->flags & WS2811_FLAG_PMU)
+    {
+        device->stats.pmu = !pmu_open(&device->pmu);
+        device->pmu_thread = pthread_self();
+    }
+
+    device->wire_ns = PCM_WIRE_NS(PCM_BYTE_COUNT(max_channel_led_count(ws2811), ws2811->freq), ws2811->freq);
+
+    if (ws2811->flags & WS2811_FLAG_LATENCY)
+    {
+        device->latency = calloc(1, sizeof(*device->latency));
+        if (!device->latency)
+        {
+            unmap_registers(ws2811);
+            goto err;
+        }
+
+        device->latency->wire_ns = device->wire_ns;
+    }
+
     return 0;
 
 err:
@@ -531,7 +1171,8 @@ void ws2811_fini(ws2811_t *ws2811)
     volatile pcm_t *pcm = ws2811->device->pcm;
 
     ws2811_wait(ws2811);                     // Wait till DMA is finished
-    while (!(pcm->cs & RPI_PCM_CS_TXE)) ;    // Wait till TX FIFO is empty
+    while (!(pcm->cs & RPI_PCM_CS_TXE))      // Wait till TX FIFO is empty
+        hw_sync(ws2811);
 
     stop_pcm(ws2811);
 
@@ -541,99 +1182,283 @@ void ws2811_fini(ws2811_t *ws2811)
 }
 
 /**
- * Wait for any executing DMA operation to complete before returning.
+ * Wait for any executing DMA operation to complete before returning.  A failed
+ * DMA is decoded, counted and the DMA channel reset, so the next render can
+ * proceed.  PCM FIFO underruns are counted but don't fail the wait.
  *
  * @param    ws2811  ws2811 instance pointer.
  *
- * @returns  0 on success, -1 on DMA competion error
+ * @returns  0 on success, -WS2811_ERROR_xxx on DMA competion error
  */
 int ws2811_wait(ws2811_t *ws2811)
 {
-    volatile dma_t *dma = ws2811->device->dma;
+    ws2811_device_t *device = ws2811->device;
+    volatile dma_t *dma = device->dma;
+    volatile pcm_t *pcm = device->pcm;
+    int waited = 0;
+    uint32_t cs;
 
-    while ((dma->cs & RPI_DMA_CS_ACTIVE) &&
-           !(dma->cs & RPI_DMA_CS_ERROR))
+    while (((cs = dma->cs) & RPI_DMA_CS_ACTIVE) &&
+           !(cs & RPI_DMA_CS_ERROR))
     {
+        waited = 1;
+
+        // The FIFO running empty is only an underrun while the DMA is still feeding
+        // it, after the last word it drains at the end of every frame.
+        if ((pcm->cs & RPI_PCM_CS_TXERR) && (dma->cs & RPI_DMA_CS_ACTIVE))
+        {
+            error_account(ws2811, WS2811_ERROR_PCM_UNDERRUN);
+            pcm->cs |= RPI_PCM_CS_TXERR;     // Write 1 to clear
+        }
+
         usleep(10);
+        hw_sync(ws2811);
     }
 
-    if (dma->cs & RPI_DMA_CS_ERROR)
+    if (cs & RPI_DMA_CS_ERROR)
+    {
+        uint32_t debug = dma->debug;
+        int error = dma_error_decode(debug);
+
+        fprintf(stderr, "DMA Error: %08x (%s)\n", debug, ws2811_error_str(error));
+        error_account(ws2811, error);
+        dma_recover(ws2811, error);
+
+        if (device->latency)
+        {
+            device->latency->pending = 0;
+        }
+
+        return -error;
+    }
+
+    if (device->latency)
+    {
+        latency_done(ws2811, waited && (cs & RPI_DMA_CS_END));
+    }
+
+    return 0;
+}
+
+/**
+ * Return a human readable description of an error type.
+ *
+ * @param    error  One of the WS2811_ERROR_xxx types, optionally negated.
+ *
+ * @returns  Description string.
+ */
+const char *ws2811_error_str(int error)
+{
+    static const char *str[WS2811_ERROR_COUNT] =
+    {
+        [0]                          = "No error",
+        [WS2811_ERROR_GENERIC]       = "DMA error",
+        [WS2811_ERROR_DMA_READ]      = "DMA read error",
+        [WS2811_ERROR_DMA_FIFO]      = "DMA FIFO error",
+        [WS2811_ERROR_DMA_READ_LAST] = "DMA read last not set error",
+        [WS2811_ERROR_PCM_UNDERRUN]  = "PCM FIFO underrun",
+        [WS2811_ERROR_CLK_TIMEOUT]   = "PCM clock timeout",
+    };
+
+    if (error < 0)
+    {
+        error = -error;
+    }
+
+    if (error >= WS2811_ERROR_COUNT)
+    {
+        return "Unknown error";
+    }
+
+    return str[error];
+}
+
+/**
+ * Copy out the render statistics.  Per stage PMU counters are only collected
+ * when the instance was initialized with WS2811_FLAG_PMU, latencies only with
+ * WS2811_FLAG_LATENCY.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    stats   Destination for the statistics.
+ *
+ * @returns  None
+ */
+void ws2811_stats(ws2811_t *ws2811, ws2811_stats_t *stats)
+{
+    ws2811_device_t *device = ws2811->device;
+
+    if (device->latency)
+    {
+        latency_percentiles(device->latency, device->stats.latency);
+    }
+
+    *stats = device->stats;
+}
+
+/**
+ * Time one frame takes on the wire, the reset gap included, which is the
+ * shortest time between renders.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  Nanoseconds.
+ */
+uint64_t ws2811_wire_ns(ws2811_t *ws2811)
+{
+    return ws2811->device->wire_ns;
+}
+
+/**
+ * Predict when a frame rendered now would show on the LEDs.  Encoding takes
+ * about as long as last time, the DMA starts once the previous frame has
+ * left the wire, and the LEDs latch the new colors when the whole frame has
+ * been sent.  Producers timing their content to this show it when it's
+ * meant to.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t ws2811_show_time_ns(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+    uint64_t start, free_ns = device->wire_start_ns + device->wire_ns;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    start = ts_to_ns(&now) + device->stats.last[WS2811_STAGE_ENCODE].ns;
+
+    return ((start > free_ns) ? start : free_ns) + device->wire_ns;
+}
+
+/**
+ * Return the last PCM buffer the emulated hardware sent, when initialized with
+ * WS2811_FLAG_EMULATE.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ * @param    len     Returns the buffer length in bytes.
+ *
+ * @returns  Buffer, NULL if not emulating or nothing was sent yet.
+ */
+const uint8_t *ws2811_emu_output(ws2811_t *ws2811, int *len)
+{
+    emu_t *emu = ws2811->device->emu;
+
+    if (!emu)
+    {
+        return NULL;
+    }
+
+    *len = emu->sink_len;
+
+    return emu->sink;
+}
+
+/**
+ * Start a background thread exporting the statistics in the Prometheus text
+ * format, either served on a UNIX domain socket or written to a file every
+ * interval_ms milliseconds.  The exporter only sees snapshots published at the
+ * end of each ws2811_render() call.  Call from the thread doing the rendering.
+ *
+ * @param    ws2811       ws2811 instance pointer.
+ * @param    mode         WS2811_METRICS_SOCKET or WS2811_METRICS_FILE.
+ * @param    path         Socket path or metrics file path.
+ * @param    interval_ms  File rewrite interval, unused for the socket.
+ *
+ * @returns  0 on success, -1 otherwise.
+ */
+int ws2811_metrics_start(ws2811_t *ws2811, int mode, const char *path, int interval_ms)
+{
+    ws2811_device_t *device = ws2811->device;
+
+    if (device->metrics)
+    {
+        return -1;
+    }
+
+    device->metrics = metrics_start(mode, path, interval_ms);
+    if (!device->metrics)
     {
-        fprintf(stderr, "DMA Error: %08x\n", dma->debug);
         return -1;
     }
 
+    stats_publish(ws2811);
+
     return 0;
 }
 
+/**
+ * Stop the metrics exporter, if running.
+ *
+ * @param    ws2811  ws2811 instance pointer.
+ *
+ * @returns  None
+ */
+void ws2811_metrics_stop(ws2811_t *ws2811)
+{
+    ws2811_device_t *device = ws2811->device;
+
+    if (device->metrics)
+    {
+        metrics_stop(device->metrics);
+        device->metrics = NULL;
+    }
+}
+
 /**
  * Render the PCM DMA buffer from the user supplied LED arrays and start the DMA
  * controller.  This will update all LEDs.
  *
  * @param    ws2811  ws2811 instance pointer.
  *
- * @returns  None
+ * @returns  0 on success, -WS2811_ERROR_xxx if the previous DMA failed
  */
 int ws2811_render(ws2811_t *ws2811)
 {
-    volatile uint8_t *pcm_raw = ws2811->device->pcm_raw;
-    int bitpos = 31;
-    int i, k, l;
-    unsigned j;
+    stage_mark_t mark[WS2811_STAGE_COUNT + 1];
+    int i, ret;
 
-    ws2811_channel_t *channel = ws2811->channel;
-    int wordpos = 0;
-    int scale   = (channel->brightness & 0xff) + 1;
-    int rshift  = (channel->strip_type >> 16) & 0xff;
-    int gshift  = (channel->strip_type >> 8)  & 0xff;
-    int bshift  = (channel->strip_type >> 0)  & 0xff;
-
-    for (i = 0; i < channel->count; i++)                // Led 
-    {   
-        uint8_t color[] = {
-            ws281x_gamma[(((channel->leds[i] >> rshift) & 0xff) * scale) >> 8], // red
-            ws281x_gamma[(((channel->leds[i] >> gshift) & 0xff) * scale) >> 8], // green
-            ws281x_gamma[(((channel->leds[i] >> bshift) & 0xff) * scale) >> 8], // blue
-        };
-
-        for (j = 0; j < ARRAY_SIZE(color); j++)        // Color
-        {
-            for (k = 7; k >= 0; k--)                   // Bit
-            {
-                uint8_t symbol = (channel->invert ? SYMBOL_HIGH : SYMBOL_LOW);
+    if (ws2811->flags & WS2811_FLAG_PMU)
+    {
+        pmu_follow(ws2811);
+    }
 
-                if (color[j] & (1 << k)) {
-                    symbol = (channel ->invert ? SYMBOL_LOW : SYMBOL_HIGH);
-                }
+    stage_mark(ws2811, &mark[WS2811_STAGE_ENCODE]);
 
-                for (l = 2; l >= 0; l--)               // Symbol
-                {
-                    uint32_t *wordptr = &((uint32_t *)pcm_raw)[wordpos];
-
-                    *wordptr &= ~(1 << bitpos);
-                    if (symbol & (1 << l))
-                    {
-                        *wordptr |= (1 << bitpos);
-                    }
-
-                    bitpos--;
-                    if (bitpos < 0) {
-                        wordpos ++;
-                        bitpos = 31;
-                    }
-                }
-            }
-        }
-    }
+    encode_frame(ws2811);
+
+    stage_mark(ws2811, &mark[WS2811_STAGE_WAIT]);
 
     // Wait for any previous DMA operation to complete.
-    if (ws2811_wait(ws2811))
+    ret = ws2811_wait(ws2811);
+    if (ret)
     {
-        return -1;
+        stats_publish(ws2811);
+        return ret;
     }
 
+    stage_mark(ws2811, &mark[WS2811_STAGE_START]);
+
     dma_start(ws2811);
 
+    stage_mark(ws2811, &mark[WS2811_STAGE_COUNT]);
+    ws2811->device->wire_start_ns = ts_to_ns(&mark[WS2811_STAGE_COUNT].ts);
+
+    for (i = 0; i < WS2811_STAGE_COUNT; i++)
+    {
+        stage_account(ws2811, i, &mark[i], &mark[i + 1]);
+    }
+    render_account(ws2811, &mark[0], &mark[WS2811_STAGE_COUNT]);
+
+    if (ws2811->device->latency)
+    {
+        latency_frame_start(ws2811->device->latency, ts_to_ns(&mark[WS2811_STAGE_ENCODE].ts),
+                            ts_to_ns(&mark[WS2811_STAGE_WAIT].ts),
+                            ts_to_ns(&mark[WS2811_STAGE_COUNT].ts));
+    }
+
+    stats_publish(ws2811);
+
     return 0;
 }
 
@@ -49,9 +49,80 @@ extern "C" {
 #define WS2811_STRIP_BRG                         0x001008
 #define WS2811_STRIP_BGR                         0x000810
 
+#define WS2811_GAMMA_DEFAULT                     0          // Built in curve, the same for all colors
+#define WS2811_GAMMA_POWER                       1          // Value to the power of each color's exponent
+#define WS2811_GAMMA_CIE                         2          // CIE 1931 lightness to luminance
+#define WS2811_GAMMA_CUSTOM                      3          // Tables given by the application
+
+#define WS2811_FLAG_PMU                          (1 << 0)   // Sample PMU counters per render stage
+#define WS2811_FLAG_LATENCY                      (1 << 1)   // Measure submit to last bit out latency
+#define WS2811_FLAG_EMULATE                      (1 << 2)   // No hardware, output to an emulated sink
+#define WS2811_FLAG_WIRE_TIME                    (1 << 3)   // Emulated transfers take the wire time
+#define WS2811_FLAG_REFERENCE                    (1 << 4)   // Use the bit by bit reference encoder
+
+#define WS2811_STAGE_ENCODE                      0          // LED buffer to PCM bit pattern
+#define WS2811_STAGE_WAIT                        1          // Waiting for the previous DMA
+#define WS2811_STAGE_START                       2          // DMA and PCM start
+#define WS2811_STAGE_COUNT                       3
+
+#define WS2811_LATENCY_ENCODE                    0          // Render call to encode done
+#define WS2811_LATENCY_QUEUE                     1          // Encode done to DMA start
+#define WS2811_LATENCY_WIRE                      2          // DMA start to last bit out
+#define WS2811_LATENCY_TOTAL                     3          // Render call to last bit out
+#define WS2811_LATENCY_COUNT                     4
+
+#define WS2811_HIST_BUCKETS                      12         // Render time histogram size
+#define WS2811_HIST_BOUND_NS(bucket)             (64000ULL << (bucket))  // Upper bound, last is +Inf
+
+#define WS2811_ERROR_GENERIC                     1          // DMA error without a debug bit set
+#define WS2811_ERROR_DMA_READ                    2          // DMA read error, bus contention
+#define WS2811_ERROR_DMA_FIFO                    3          // DMA FIFO error, bus contention
+#define WS2811_ERROR_DMA_READ_LAST               4          // Read last not set, bad control block
+#define WS2811_ERROR_PCM_UNDERRUN                5          // PCM TX FIFO ran empty mid frame
+#define WS2811_ERROR_CLK_TIMEOUT                 6          // PCM clock didn't start or stop
+#define WS2811_ERROR_COUNT                       7
+
+#define WS2811_FAULT_NONE                        0          // Ends a fault script
+#define WS2811_FAULT_DMA_ERROR                   1          // Raise the RPI_DMA_DEBUG_xxx bits in arg
+#define WS2811_FAULT_CLK_BUSY                    2          // Clock stuck busy for arg ms, 0 for ever
+#define WS2811_FAULT_UNDERRUN                    3          // PCM FIFO underrun during the frame
+#define WS2811_FAULT_ALLOC                       4          // Emulated DMA memory allocation fails
+#define WS2811_FAULT_SLOW                        5          // Frame takes arg us longer
+
+#define WS2811_CURRENT_DEFAULT_UA                20000      // Current of one color at full scale
+
+#define WS2811_METRICS_SOCKET                    0          // Serve metrics on a UNIX socket
+#define WS2811_METRICS_FILE                      1          // Periodically rewrite a metrics file
+
 struct ws2811_device;
+struct lut3d;
 
 typedef uint32_t ws2811_led_t;                   //< 0x00RRGGBB
+
+/*
+ * A run of LEDs with its own power injection point.  Zones follow each other
+ * from the first LED, LEDs past the last zone share the channel limit only.
+ */
+typedef struct
+{
+    int count;                                   //< Number of LEDs in the zone
+    int power_limit_ma;                          //< Zone supply current limit in mA, 0 for no limit
+    uint32_t power_ma;                           //< Estimated zone current of the last frame, set by the driver
+    int brightness;                              //< Brightness the zone was last sent with, set by the driver
+} ws2811_zone_t;
+
+/*
+ * Gamma curve of a channel.  The driver builds red, green and blue tables
+ * from it and only rebuilds them when it changes, so it may be changed
+ * between renders.
+ */
+typedef struct
+{
+    int curve;                                   //< One of the WS2811_GAMMA_xxx constants
+    float exponent[3];                           //< Red, green and blue exponents for WS2811_GAMMA_POWER
+    const uint8_t *table;                        //< Red, green and blue 256 entry tables for WS2811_GAMMA_CUSTOM
+} ws2811_gamma_t;
+
 typedef struct
 {
     int gpionum;                                 //< GPIO Pin with PCM alternate function
@@ -60,8 +131,25 @@ typedef struct
     int brightness;                              //< Brightness value between 0 and 255
     int strip_type;                              //< Strip color layout -- one of WS2811_STRIP_xxx constants
     ws2811_led_t *leds;                          //< LED buffer, allocated by driver based on count
+    int power_limit_ma;                          //< Supply current limit in mA, 0 for no limit
+    int current_red_ua;                          //< Current of one LED's red at full scale in uA, 0 for default
+    int current_green_ua;                        //< Same for green
+    int current_blue_ua;                         //< Same for blue
+    int current_idle_ua;                         //< Current of one LED when dark in uA
+    ws2811_zone_t *zones;                        //< Power zones, NULL for none, fixed after init
+    int zone_count;                              //< Number of power zones
+    const struct lut3d *lut3d;                   //< Color correction applied while encoding, NULL for none
+    const ws2811_led_t *calibration;             //< Per LED gains, 0x00RRGGBB with 255 for unity, NULL for none
+    ws2811_gamma_t gamma;                        //< Gamma curve, all zero for the built in one
 } ws2811_channel_t;
 
+typedef struct
+{
+    int frame;                                   //< Frame the fault hits, counting from 0
+    int fault;                                   //< One of the WS2811_FAULT_xxx constants
+    uint32_t arg;                                //< Fault specific parameter
+} ws2811_fault_t;
+
 typedef struct
 {
     struct ws2811_device *device;                //< Private data for driver use
@@ -69,13 +157,58 @@ typedef struct
     uint32_t freq;                               //< Required output frequency
     int dmanum;                                  //< DMA number _not_ already in use
     ws2811_channel_t *channel;
+    uint32_t flags;                              //< Optional features -- WS2811_FLAG_xxx constants
+    const ws2811_fault_t *faults;                //< Fault script, WS2811_FLAG_EMULATE only
 } ws2811_t;
 
+typedef struct
+{
+    uint64_t ns;                                 //< Wall clock time
+    uint64_t cycles;                             //< CPU cycles spent in user space
+    uint64_t instructions;                       //< Instructions retired
+    uint64_t cache_misses;                       //< Cache misses
+} ws2811_stage_stats_t;
+
+typedef struct
+{
+    uint64_t p50;                                //< Median in nanoseconds
+    uint64_t p95;                                //< 95th percentile in nanoseconds
+    uint64_t p99;                                //< 99th percentile in nanoseconds
+    uint64_t max;                                //< Maximum in nanoseconds
+} ws2811_latency_t;
+
+typedef struct
+{
+    uint64_t frames;                             //< Number of frames rendered
+    int pmu;                                     //< Non-zero if the PMU counters could be opened
+    int last_error;                              //< Last WS2811_ERROR_xxx seen, 0 if none
+    uint64_t errors[WS2811_ERROR_COUNT];         //< Number of errors per WS2811_ERROR_xxx type
+    uint64_t render_ns;                          //< Total time spent in ws2811_render()
+    uint64_t render_hist[WS2811_HIST_BUCKETS];   //< ws2811_render() times, see WS2811_HIST_BOUND_NS()
+    uint64_t latency_frames;                     //< Frames with a latency measurement
+    ws2811_latency_t latency[WS2811_LATENCY_COUNT];  //< Recent latencies, WS2811_FLAG_LATENCY only
+    ws2811_stage_stats_t last[WS2811_STAGE_COUNT];   //< Per stage values of the last frame
+    ws2811_stage_stats_t total[WS2811_STAGE_COUNT];  //< Per stage values summed over all frames
+    uint32_t power_limit_ma;                     //< Supply current limit, 0 if power isn't limited
+    uint32_t power_ma;                           //< Estimated supply current of the last frame
+    uint32_t power_demand_ma;                    //< Same at the channel brightness, without limiting
+    int power_brightness;                        //< Brightness the last frame was sent with, the brightest zone's
+    uint64_t power_limited;                      //< Frames dimmed to stay within the limit
+} ws2811_stats_t;
+
 
 int ws2811_init(ws2811_t *ws2811);               //< Initialize buffers/hardware
 void ws2811_fini(ws2811_t *ws2811);              //< Tear it all down
 int ws2811_render(ws2811_t *ws2811);             //< Send LEDs off to hardware
 int ws2811_wait(ws2811_t *ws2811);               //< Wait for DMA completion
+const char *ws2811_error_str(int error);         //< Describe a WS2811_ERROR_xxx code
+void ws2811_stats(ws2811_t *ws2811, ws2811_stats_t *stats);  //< Copy out render statistics
+uint64_t ws2811_wire_ns(ws2811_t *ws2811);       //< Time a frame takes on the wire
+uint64_t ws2811_show_time_ns(ws2811_t *ws2811);  //< When a frame rendered now would show, CLOCK_MONOTONIC
+const uint8_t *ws2811_emu_output(ws2811_t *ws2811, int *len);  //< Last buffer sent when emulating
+int ws2811_metrics_start(ws2811_t *ws2811, int mode, const char *path, int interval_ms);
+                                                 //< Export statistics in Prometheus format
+void ws2811_metrics_stop(ws2811_t *ws2811);      //< Stop the metrics exporter
 
 #ifdef __cplusplus
 }